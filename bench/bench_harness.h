@@ -0,0 +1,238 @@
+#ifndef BENCH_HARNESS_H
+#define BENCH_HARNESS_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "perf_counters.h"
+
+// Self-contained timing harness for discrete_map_bench. Nothing here knows about any particular map.
+
+struct bench_config {
+    size_t min_size = 10;
+    size_t max_size = 1'000'000;
+    // every workload is repeated until it has done at least this many operations, so small sizes aren't all timer noise.
+    size_t target_ops = 2'000'000;
+    std::string filter;
+    bool csv = false;
+    // read hardware counters around every timed section too (Linux only).
+    bool perf = false;
+};
+
+struct bench_result {
+    std::string workload;
+    std::string map;
+    std::string key;
+    std::string value;
+    size_t size;
+    double ns_per_op;
+    // per operation as well. empty when --perf is off or the counter couldn't be opened.
+    perf_sample counters_per_op;
+};
+
+class bench_reporter {
+    private:
+        bool _csv;
+        bool _perf;
+
+    public:
+        bench_reporter(bool csv, bool perf)
+            : _csv(csv),
+              _perf(perf)
+        {}
+
+        void header() const {
+            if (_csv) {
+                std::printf("workload,map,key,value,size,ns_per_op");
+                if (_perf) {
+                    for (const char* name : perf_event_names) {
+                        std::printf(",%s_per_op", name);
+                    }
+                }
+            }
+            else {
+                std::printf("%-13s %-26s %-8s %-8s %12s %12s", "workload", "map", "key", "value", "size", "ns/op");
+                if (_perf) {
+                    for (const char* name : perf_event_short_names) {
+                        std::printf(" %10s", name);
+                    }
+                }
+            }
+            std::printf("\n");
+        }
+
+        void report(const bench_result& r) const {
+            if (_csv) {
+                std::printf("%s,%s,%s,%s,%zu,%.3f", r.workload.c_str(), r.map.c_str(), r.key.c_str(), r.value.c_str(), r.size, r.ns_per_op);
+                if (_perf) {
+                    for (const std::optional<double>& c : r.counters_per_op) {
+                        // missing counters are left empty rather than written as 0, which would be a real reading.
+                        if (c) {
+                            std::printf(",%.3f", *c);
+                        }
+                        else {
+                            std::printf(",");
+                        }
+                    }
+                }
+            }
+            else {
+                std::printf("%-13s %-26s %-8s %-8s %12zu %12.2f", r.workload.c_str(), r.map.c_str(), r.key.c_str(), r.value.c_str(), r.size, r.ns_per_op);
+                if (_perf) {
+                    for (const std::optional<double>& c : r.counters_per_op) {
+                        if (c) {
+                            std::printf(" %10.2f", *c);
+                        }
+                        else {
+                            std::printf(" %10s", "-");
+                        }
+                    }
+                }
+            }
+            std::printf("\n");
+            std::fflush(stdout);
+        }
+};
+
+// keeps the optimiser from deleting work whose result is otherwise unused.
+template<class T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &value;
+#endif
+}
+
+// times a workload, and reads hardware counters over exactly the same sections when given some.
+class bench_timer {
+    private:
+        using clock = std::chrono::steady_clock;
+
+        const perf_counters* _perf;
+        clock::time_point _start;
+        std::chrono::nanoseconds _elapsed{0};
+
+    public:
+        explicit bench_timer(const perf_counters* perf = nullptr)
+            : _perf(perf)
+        {
+            if (_perf) {
+                _perf->reset();
+            }
+        }
+
+        void start() {
+            if (_perf) {
+                _perf->start();
+            }
+            _start = clock::now();
+        }
+
+        void stop() {
+            _elapsed += clock::now() - _start;
+            if (_perf) {
+                _perf->stop();
+            }
+        }
+
+        double ns() const {
+            return static_cast<double>(_elapsed.count());
+        }
+
+        perf_sample counters_per_op(size_t ops) const {
+            perf_sample sample;
+            if (_perf) {
+                sample = _perf->read();
+                for (std::optional<double>& c : sample) {
+                    if (c) {
+                        *c /= static_cast<double>(ops);
+                    }
+                }
+            }
+            return sample;
+        }
+};
+
+// splitmix64's finaliser. it's a bijection, so distinct inputs give distinct keys without needing a set to check.
+inline std::uint64_t bench_mix(std::uint64_t x) noexcept {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// value big enough that moving it around dominates.
+struct bench_large_value {
+    std::array<std::uint64_t, 32> data{};
+
+    bench_large_value() = default;
+    explicit bench_large_value(std::uint64_t seed) {
+        data.fill(seed);
+    }
+};
+
+template<class T>
+struct bench_type_traits;
+
+template<>
+struct bench_type_traits<std::uint64_t> {
+    static constexpr const char* name = "u64";
+    static std::uint64_t make(std::uint64_t i) {
+        return bench_mix(i);
+    }
+    static std::uint64_t checksum(std::uint64_t v) {
+        return v;
+    }
+};
+
+template<>
+struct bench_type_traits<std::string> {
+    static constexpr const char* name = "string";
+    // long enough to defeat the small-string buffer, like most real identifiers.
+    static std::string make(std::uint64_t i) {
+        return "bench-key-" + std::to_string(bench_mix(i));
+    }
+    static std::uint64_t checksum(const std::string& v) {
+        return v.size();
+    }
+};
+
+template<>
+struct bench_type_traits<bench_large_value> {
+    static constexpr const char* name = "256B";
+    static bench_large_value make(std::uint64_t i) {
+        return bench_large_value(i);
+    }
+    static std::uint64_t checksum(const bench_large_value& v) {
+        return v.data[0];
+    }
+};
+
+// 10, 100, ... up to the configured maximum.
+inline std::vector<size_t> bench_sizes(const bench_config& config) {
+    std::vector<size_t> sizes;
+    for (size_t n = 10; n <= config.max_size; n *= 10) {
+        if (n >= config.min_size) {
+            sizes.push_back(n);
+        }
+        if (n > config.max_size / 10) {
+            break;
+        }
+    }
+    return sizes;
+}
+
+inline size_t bench_repetitions(const bench_config& config, size_t n) {
+    return std::clamp<size_t>(config.target_ops / std::max<size_t>(1, n), 1, 100'000);
+}
+
+#endif
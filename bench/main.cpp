@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BitwiseGrowthPolicy.h"
+#include "cpu_dispatch.h"
+#include "DirectAddressGrowthPolicy.h"
+#include "discrete_map.h"
+#include "index_storage.h"
+#include "linear_prober.h"
+
+#include "bench_harness.h"
+
+// discrete_map_bench: times the same workloads on discrete_map and std::unordered_map.
+//
+// usage: discrete_map_bench [--min-size N] [--max-size N] [--ops N] [--filter SUBSTRING] [--csv] [--perf]
+//
+// --filter matches against "workload/map/key/value", e.g. --filter find_hit/discrete or --filter /string/.
+// --perf adds per-operation hardware counters (cycles, instructions, L1d/LLC/dTLB misses, branch misses). Counters the
+// kernel won't give us are reported on stderr and shown as "-"; on Linux that usually means kernel.perf_event_paranoid is too high.
+
+template<class Key, class T, class Growth, template<class> class Probe, template<class> class IndexStorage = heap_index_storage, class IndexSlots = plain_index_slots>
+using bench_discrete_map = discrete_map<Key, T, std::hash<Key>, std::equal_to<Key>, std::allocator<Key>, std::allocator<T>, Growth, Probe, NullStatsPolicy, IndexStorage, IndexSlots>;
+
+// the policies the benchmark crosses with each other. a new policy goes in its list, with the short name it's labelled by.
+template<class... Growth>
+struct bench_growth_list {};
+
+template<template<class> class... Probe>
+struct bench_probe_list {};
+
+using bench_growth_policies = bench_growth_list<BitwiseGrowthPolicy, DirectAddressGrowthPolicy>;
+using bench_probe_policies = bench_probe_list<linear_prober>;
+
+template<class Growth>
+struct bench_growth_label;
+
+template<>
+struct bench_growth_label<BitwiseGrowthPolicy> {
+    static constexpr const char* value = "bitwise";
+};
+
+template<>
+struct bench_growth_label<DirectAddressGrowthPolicy> {
+    static constexpr const char* value = "direct";
+};
+
+template<template<class> class Probe>
+struct bench_probe_label;
+
+template<>
+struct bench_probe_label<linear_prober> {
+    static constexpr const char* value = "lin";
+};
+
+template<class Key, class T, class Growth, class Callable, template<class> class... Probe>
+void for_each_probe_policy(Callable& run, bench_probe_list<Probe...>) {
+    const auto run_one = [&run]<template<class> class P>() {
+        const std::string label = std::string("discrete/") + bench_growth_label<Growth>::value + "/" + bench_probe_label<P>::value;
+        run.template operator()<bench_discrete_map<Key, T, Growth, P>>(label.c_str());
+    };
+    (run_one.template operator()<Probe>(), ...);
+}
+
+template<class Key, class T, class Callable, class... Growth>
+void for_each_growth_policy(Callable& run, bench_growth_list<Growth...>) {
+    (for_each_probe_policy<Key, T, Growth>(run, bench_probe_policies{}), ...);
+}
+
+// every growth/probe pairing under test, then the index storage and slot variants on the default policies.
+template<class Key, class T, class Callable>
+void for_each_map_type(Callable&& run) {
+    run.template operator()<std::unordered_map<Key, T>>("unordered_map");
+    for_each_growth_policy<Key, T>(run, bench_growth_policies{});
+    run.template operator()<bench_discrete_map<Key, T, BitwiseGrowthPolicy, linear_prober, reserved_index_storage>>("discrete/bitwise/lin/rsv");
+    run.template operator()<bench_discrete_map<Key, T, BitwiseGrowthPolicy, linear_prober, heap_index_storage, keyed_index_slots>>("discrete/bitwise/lin/keyed");
+}
+
+template<class Map>
+std::uint64_t bench_sum_values(const Map& map) {
+    using value_traits = bench_type_traits<typename Map::mapped_type>;
+    std::uint64_t sum = 0;
+    // discrete_map's whole point is the dense value column, so scan that rather than going through pair-producing iterators.
+    if constexpr (requires { map.values(); }) {
+        for (const auto& v : map.values()) {
+            sum += value_traits::checksum(v);
+        }
+    }
+    else {
+        for (const auto& kv : map) {
+            sum += value_traits::checksum(kv.second);
+        }
+    }
+    return sum;
+}
+
+// far enough ahead to cover a cache miss on the index, near enough that the line is still there when find() arrives.
+constexpr size_t bench_prefetch_distance = 8;
+
+template<class Map>
+class bench_workloads {
+    private:
+        using key_type = typename Map::key_type;
+        using mapped_type = typename Map::mapped_type;
+        using value_type = std::pair<const key_type, mapped_type>;
+        using key_traits = bench_type_traits<key_type>;
+        using value_traits = bench_type_traits<mapped_type>;
+
+        const bench_config& _config;
+        const bench_reporter& _reporter;
+        const perf_counters* _perf;
+        const char* _map_name;
+        size_t _n;
+
+        std::vector<key_type> _keys;
+        std::vector<key_type> _lookup_order;
+        std::vector<key_type> _misses;
+        std::vector<mapped_type> _values;
+
+        bool selected(const char* workload) const {
+            if (_config.filter.empty()) {
+                return true;
+            }
+            const std::string id = std::string(workload) + "/" + _map_name + "/" + key_traits::name + "/" + value_traits::name;
+            return id.find(_config.filter) != std::string::npos;
+        }
+
+        void report(const char* workload, const bench_timer& timer, size_t ops) const {
+            _reporter.report({workload, _map_name, key_traits::name, value_traits::name, _n, timer.ns() / static_cast<double>(ops), timer.counters_per_op(ops)});
+        }
+
+        Map build() const {
+            Map map;
+            for (size_t i = 0; i < _n; ++i) {
+                map.insert(value_type(_keys[i], _values[i]));
+            }
+            return map;
+        }
+
+    public:
+        bench_workloads(const bench_config& config, const bench_reporter& reporter, const perf_counters* perf, const char* map_name, size_t n)
+            : _config(config),
+              _reporter(reporter),
+              _perf(perf),
+              _map_name(map_name),
+              _n(n)
+        {
+            _keys.reserve(n);
+            _misses.reserve(n);
+            _values.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                _keys.push_back(key_traits::make(i));
+                _misses.push_back(key_traits::make(i + n));
+                _values.push_back(value_traits::make(i));
+            }
+            // look keys up in a different order than they went in, or the hit path just streams the columns.
+            _lookup_order = _keys;
+            std::shuffle(_lookup_order.begin(), _lookup_order.end(), std::mt19937_64(n));
+        }
+
+        void insert() const {
+            if (!selected("insert")) {
+                return;
+            }
+            const size_t reps = bench_repetitions(_config, _n);
+            bench_timer timer(_perf);
+            for (size_t r = 0; r < reps; ++r) {
+                Map map;
+                timer.start();
+                for (size_t i = 0; i < _n; ++i) {
+                    map.insert(value_type(_keys[i], _values[i]));
+                }
+                timer.stop();
+                do_not_optimize(map.size());
+            }
+            report("insert", timer, reps * _n);
+        }
+
+        void find_hit() const {
+            if (!selected("find_hit")) {
+                return;
+            }
+            Map map = build();
+            const size_t reps = bench_repetitions(_config, _n);
+            size_t found = 0;
+            bench_timer timer(_perf);
+            timer.start();
+            for (size_t r = 0; r < reps; ++r) {
+                for (const key_type& k : _lookup_order) {
+                    found += map.find(k) != map.end() ? 1 : 0;
+                }
+            }
+            timer.stop();
+            do_not_optimize(found);
+            report("find_hit", timer, reps * _n);
+        }
+
+        void find_miss() const {
+            if (!selected("find_miss")) {
+                return;
+            }
+            Map map = build();
+            const size_t reps = bench_repetitions(_config, _n);
+            size_t found = 0;
+            bench_timer timer(_perf);
+            timer.start();
+            for (size_t r = 0; r < reps; ++r) {
+                for (const key_type& k : _misses) {
+                    found += map.find(k) != map.end() ? 1 : 0;
+                }
+            }
+            timer.stop();
+            do_not_optimize(found);
+            report("find_miss", timer, reps * _n);
+        }
+
+        // find_hit, with each lookup's slot prefetched bench_prefetch_distance lookups ahead. only maps that offer prefetch().
+        void find_prefetch() const {
+            if constexpr (requires (const Map& m, const key_type& k) { m.prefetch(k); }) {
+                if (!selected("find_prefetch")) {
+                    return;
+                }
+                Map map = build();
+                const size_t reps = bench_repetitions(_config, _n);
+                size_t found = 0;
+                bench_timer timer(_perf);
+                timer.start();
+                for (size_t r = 0; r < reps; ++r) {
+                    for (size_t i = 0; i < _n; ++i) {
+                        if (i + bench_prefetch_distance < _n) {
+                            map.prefetch(_lookup_order[i + bench_prefetch_distance]);
+                        }
+                        found += map.find(_lookup_order[i]) != map.end() ? 1 : 0;
+                    }
+                }
+                timer.stop();
+                do_not_optimize(found);
+                report("find_prefetch", timer, reps * _n);
+            }
+        }
+
+        // find_hit as one batch through find_many(). only maps that offer it.
+        void find_many() const {
+            if constexpr (requires (const Map& m, std::span<const key_type> k, std::span<typename Map::size_type> p) { m.find_many(k, p); }) {
+                if (!selected("find_many")) {
+                    return;
+                }
+                Map map = build();
+                const size_t reps = bench_repetitions(_config, _n);
+                std::vector<typename Map::size_type> positions(_n);
+                size_t found = 0;
+                bench_timer timer(_perf);
+                timer.start();
+                for (size_t r = 0; r < reps; ++r) {
+                    found += map.find_many(_lookup_order, positions);
+                }
+                timer.stop();
+                do_not_optimize(found);
+                report("find_many", timer, reps * _n);
+            }
+        }
+
+        // counter increments: the first pass inserts every key at 1, the second bumps it. u64 values only.
+        void update() const {
+            if constexpr (std::is_same_v<mapped_type, std::uint64_t>) {
+                if (!selected("update")) {
+                    return;
+                }
+                const size_t reps = bench_repetitions(_config, _n);
+                bench_timer timer(_perf);
+                for (size_t r = 0; r < reps; ++r) {
+                    Map map;
+                    timer.start();
+                    for (size_t pass = 0; pass < 2; ++pass) {
+                        for (const key_type& k : _lookup_order) {
+                            if constexpr (requires { map.upsert(k, []{ return std::uint64_t(1); }, [](std::uint64_t& v){ ++v; }); }) {
+                                map.upsert(k, []{ return std::uint64_t(1); }, [](std::uint64_t& v){ ++v; });
+                            }
+                            else {
+                                ++map[k];
+                            }
+                        }
+                    }
+                    timer.stop();
+                    do_not_optimize(map.size());
+                }
+                report("update", timer, reps * _n * 2);
+            }
+        }
+
+        void erase() const {
+            if (!selected("erase")) {
+                return;
+            }
+            const Map original = build();
+            const size_t reps = bench_repetitions(_config, _n);
+            bench_timer timer(_perf);
+            for (size_t r = 0; r < reps; ++r) {
+                Map map(original);
+                timer.start();
+                for (const key_type& k : _lookup_order) {
+                    map.erase(k);
+                }
+                timer.stop();
+                do_not_optimize(map.size());
+            }
+            report("erase", timer, reps * _n);
+        }
+
+        void iterate() const {
+            if (!selected("iterate")) {
+                return;
+            }
+            const Map map = build();
+            const size_t reps = bench_repetitions(_config, _n);
+            std::uint64_t sum = 0;
+            bench_timer timer(_perf);
+            timer.start();
+            for (size_t r = 0; r < reps; ++r) {
+                sum += bench_sum_values(map);
+            }
+            timer.stop();
+            do_not_optimize(sum);
+            report("iterate", timer, reps * _n);
+        }
+
+        // half hits, a quarter inserts of new keys, a quarter erases, interleaved.
+        void mixed() const {
+            if (!selected("mixed")) {
+                return;
+            }
+            const Map original = build();
+            const size_t reps = bench_repetitions(_config, _n);
+            size_t found = 0;
+            bench_timer timer(_perf);
+            for (size_t r = 0; r < reps; ++r) {
+                Map map(original);
+                timer.start();
+                for (size_t i = 0; i < _n; ++i) {
+                    switch (bench_mix(i) & 3u) {
+                        case 0:
+                        case 1:
+                            found += map.find(_lookup_order[i]) != map.end() ? 1 : 0;
+                            break;
+                        case 2:
+                            map.insert(value_type(_misses[i], _values[i]));
+                            break;
+                        default:
+                            map.erase(_keys[i]);
+                            break;
+                    }
+                }
+                timer.stop();
+                do_not_optimize(map.size());
+            }
+            do_not_optimize(found);
+            report("mixed", timer, reps * _n);
+        }
+
+        void run_all() const {
+            insert();
+            find_hit();
+            find_miss();
+            find_prefetch();
+            find_many();
+            update();
+            erase();
+            iterate();
+            mixed();
+        }
+};
+
+template<class Key, class T>
+void bench_types(const bench_config& config, const bench_reporter& reporter, const perf_counters* perf) {
+    for (const size_t n : bench_sizes(config)) {
+        for_each_map_type<Key, T>([&]<class Map>(const char* map_name) {
+            bench_workloads<Map>(config, reporter, perf, map_name, n).run_all();
+        });
+    }
+}
+
+static void usage(const char* argv0) {
+    std::fprintf(stderr, "usage: %s [--min-size N] [--max-size N] [--ops N] [--filter SUBSTRING] [--csv] [--perf]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    bench_config config;
+
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--min-size") == 0 && has_value) {
+            config.min_size = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--max-size") == 0 && has_value) {
+            config.max_size = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--ops") == 0 && has_value) {
+            config.target_ops = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--filter") == 0 && has_value) {
+            config.filter = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0) {
+            config.csv = true;
+        }
+        else if (std::strcmp(argv[i], "--perf") == 0) {
+            config.perf = true;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // counters are per thread and every workload runs on this one, so one set serves the whole run.
+    std::unique_ptr<perf_counters> perf;
+    if (config.perf) {
+        perf = std::make_unique<perf_counters>();
+    }
+
+    // stderr, so --csv output stays clean; numbers from different machines aren't comparable without it.
+    std::fprintf(stderr, "simd: %s\n", simd_level_name(active_simd_level()));
+
+    const bench_reporter reporter(config.csv, config.perf);
+    reporter.header();
+
+    bench_types<std::uint64_t, std::uint64_t>(config, reporter, perf.get());
+    bench_types<std::string, std::uint64_t>(config, reporter, perf.get());
+    bench_types<std::uint64_t, bench_large_value>(config, reporter, perf.get());
+
+    return 0;
+}
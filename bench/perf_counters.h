@@ -0,0 +1,185 @@
+#ifndef BENCH_PERF_COUNTERS_H
+#define BENCH_PERF_COUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters for discrete_map_bench, read through Linux perf_event_open. Each counter is opened on its own, so one the
+// kernel or PMU refuses (no permission, containers, VMs without a virtual PMU) just reads as missing while the rest still work.
+// Elsewhere, every counter is missing.
+
+enum class perf_event_kind {
+    cycles,
+    instructions,
+    l1d_misses,
+    llc_misses,
+    branch_misses,
+    dtlb_misses,
+};
+
+inline constexpr size_t perf_event_count = 6;
+
+inline constexpr std::array<const char*, perf_event_count> perf_event_names = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "dtlb_misses"
+};
+
+// column headings for the table output, in the same order.
+inline constexpr std::array<const char*, perf_event_count> perf_event_short_names = {
+    "cyc/op", "ins/op", "L1d/op", "LLC/op", "brmis/op", "dTLB/op"
+};
+
+using perf_sample = std::array<std::optional<double>, perf_event_count>;
+
+class perf_counters {
+    private:
+        std::array<int, perf_event_count> _fds;
+
+#ifdef __linux__
+        static perf_event_attr make_attr(perf_event_kind kind) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            // the kernel multiplexes when there are more counters than PMU slots; these let read() scale the count back up.
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            const auto cache_miss = [](std::uint64_t cache) {
+                return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            };
+
+            switch (kind) {
+                case perf_event_kind::cycles:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case perf_event_kind::instructions:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case perf_event_kind::l1d_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+                    break;
+                case perf_event_kind::llc_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+                    break;
+                case perf_event_kind::branch_misses:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                    break;
+                case perf_event_kind::dtlb_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+                    break;
+            }
+            return attr;
+        }
+
+        void for_each_open(unsigned long request) const {
+            for (const int fd : _fds) {
+                if (fd >= 0) {
+                    ioctl(fd, request, 0);
+                }
+            }
+        }
+#endif
+
+    public:
+        // opens every counter for the calling thread, on any CPU. reports the ones that couldn't be opened to stderr.
+        perf_counters() {
+            _fds.fill(-1);
+#ifdef __linux__
+            for (size_t i = 0; i < perf_event_count; ++i) {
+                perf_event_attr attr = make_attr(static_cast<perf_event_kind>(i));
+                _fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                if (_fds[i] < 0) {
+                    std::fprintf(stderr, "perf: %s unavailable: %s\n", perf_event_names[i], std::strerror(errno));
+                }
+            }
+#else
+            std::fprintf(stderr, "perf: hardware counters are only supported on Linux\n");
+#endif
+        }
+
+        perf_counters(const perf_counters&) = delete;
+        perf_counters& operator=(const perf_counters&) = delete;
+
+        ~perf_counters() {
+#ifdef __linux__
+            for (const int fd : _fds) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        bool any_available() const noexcept {
+            for (const int fd : _fds) {
+                if (fd >= 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // counts accumulate across start()/stop() pairs until the next reset(), like bench_timer.
+        void reset() const {
+#ifdef __linux__
+            for_each_open(PERF_EVENT_IOC_RESET);
+#endif
+        }
+
+        void start() const {
+#ifdef __linux__
+            for_each_open(PERF_EVENT_IOC_ENABLE);
+#endif
+        }
+
+        void stop() const {
+#ifdef __linux__
+            for_each_open(PERF_EVENT_IOC_DISABLE);
+#endif
+        }
+
+        // totals since the last reset(), scaled up for any time a counter was multiplexed out. missing counters stay empty.
+        perf_sample read() const {
+            perf_sample sample;
+#ifdef __linux__
+            for (size_t i = 0; i < perf_event_count; ++i) {
+                if (_fds[i] < 0) {
+                    continue;
+                }
+                std::uint64_t values[3] = {0, 0, 0};
+                if (::read(_fds[i], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values))) {
+                    continue;
+                }
+                const std::uint64_t enabled = values[1];
+                const std::uint64_t running = values[2];
+                if (running == 0) {
+                    sample[i] = enabled == 0 ? std::optional<double>(0.0) : std::nullopt;
+                    continue;
+                }
+                sample[i] = static_cast<double>(values[0]) * static_cast<double>(enabled) / static_cast<double>(running);
+            }
+#endif
+            return sample;
+        }
+};
+
+#endif
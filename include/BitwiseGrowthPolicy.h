@@ -1,16 +1,17 @@
 #ifndef BITWISE_POLICY_H
 #define BITWISE_POLICY_H
 
+#include <bit>
 #include <cstddef>
 #include "GrowthPolicy.h"
 
 class BitwiseGrowthPolicy : public GrowthPolicy<BitwiseGrowthPolicy> {
 public:
-    size_type get_index_impl(size_type capacity, size_type raw_hash_val) const noexcept {
+    constexpr size_type get_index_impl(size_type capacity, size_type raw_hash_val) const noexcept {
         return raw_hash_val & (capacity - 1);
     } 
 
-    size_type next_capacity_impl(size_type capacity) const noexcept {
+    constexpr size_type next_capacity_impl(size_type capacity) const noexcept {
         return capacity << 1;
     }
 
@@ -26,6 +27,15 @@ public:
         }
         return value;
     }
+
+    // get_index_impl() masks with capacity - 1, so anything but a power of two leaves slots unreachable.
+    constexpr bool valid_capacity_impl(size_type capacity) const noexcept {
+        return std::has_single_bit(capacity) && capacity >= min_capacity_impl();
+    }
+
+        constexpr const char* name_impl() const noexcept {
+        return "BitwiseGrowthPolicy";
+    }
 };
 
 #endif
@@ -0,0 +1,103 @@
+#ifndef DIRECT_ADDRESS_GROWTH_POLICY_H
+#define DIRECT_ADDRESS_GROWTH_POLICY_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include "GrowthPolicy.h"
+
+/**
+ * growth policy that indexes the table by `hash - base` while the hashes fill a compact range, and masks like BitwiseGrowthPolicy otherwise.
+ *
+ * Meant for integer keys whose std::hash is the key itself (libstdc++ and libc++, not MSVC): enum IDs, shard numbers, row IDs 0..N with a few gaps. In direct mode every element sits in the slot for its own offset, so a hit is a single slot load with no probing. A key outside the range goes to the last slot, which direct mode never fills, and misses there straight away.
+ *
+ * The layout depends on the keys, so discrete_map drives it (see layout_growth_policy). Every time the table is rebuilt, on growth or after a bulk build, the policy is shown the range of hashes and picks direct mode if at least half the range is in use and no two elements share a hash. Inserting a hash outside the range triggers one more rebuild, which either widens the range or, if it's become too sparse, falls back to hashed mode until the next rebuild.
+ */
+class DirectAddressGrowthPolicy : public GrowthPolicy<DirectAddressGrowthPolicy> {
+private:
+    size_type _base = 0;
+    bool _direct = false;
+
+public:
+    // direct mode is only chosen while the range has at most this many hashes per element, so it never costs much more than hashing would.
+    static constexpr size_type max_range_per_element = 2;
+
+    constexpr size_type get_index_impl(size_type capacity, size_type raw_hash_val) const noexcept {
+        if (_direct) {
+            const size_type offset = raw_hash_val - _base;
+            return offset < capacity - 1 ? offset : capacity - 1;
+        }
+        return raw_hash_val & (capacity - 1);
+    }
+
+    constexpr size_type next_capacity_impl(size_type capacity) const noexcept {
+        return capacity << 1;
+    }
+
+    constexpr size_type min_capacity_impl() const noexcept {
+        return 8u;
+    }
+
+    constexpr size_type max_capacity_impl() const noexcept {
+        unsigned int value = min_capacity_impl();
+        unsigned int mask = 1u << (sizeof(unsigned int)*8 - 1);
+        while ((value & mask) == 0) {
+            value <<= 1;
+        }
+        return value;
+    }
+
+    // get_index_impl() masks with capacity - 1, so anything but a power of two leaves slots unreachable.
+    constexpr bool valid_capacity_impl(size_type capacity) const noexcept {
+        return std::has_single_bit(capacity) && capacity >= min_capacity_impl();
+    }
+
+        constexpr const char* name_impl() const noexcept {
+        return "DirectAddressGrowthPolicy";
+    }
+
+    constexpr bool is_direct() const noexcept {
+        return _direct;
+    }
+
+    // whether a table of `capacity` slots can take this hash without a new layout.
+    constexpr bool fits(size_type capacity, size_type raw_hash_val) const noexcept {
+        return !_direct || raw_hash_val - _base < capacity - 1;
+    }
+
+    /**
+     * picks the layout for a table that's about to hold `count` elements with hashes in [lowest, highest], and returns its capacity.
+     *
+     * A direct layout gets half the range again as headroom, split either side, so keys arriving in ascending or descending order don't force a rebuild each.
+     *
+     * @arg distinct false if two of the elements have the same hash, which direct mode can't place
+     * @arg capacity the least the table needs for its load factor. the result is never smaller.
+     */
+    constexpr size_type relayout(size_type lowest, size_type highest, size_type count, bool distinct, size_type capacity) noexcept {
+        // wraps to 0 when the hashes cover the whole of size_type.
+        const size_type range = highest - lowest + 1;
+        _direct = count > 0 && distinct && range != 0 && range <= max_range_per_element * count;
+        if (!_direct) {
+            _base = 0;
+            return capacity;
+        }
+
+        // the last slot stays empty for keys outside the range.
+        capacity = std::max(capacity, std::bit_ceil(range + range / 2 + 1));
+        _base = lowest - (capacity - 1 - range) / 2;
+        return capacity;
+    }
+
+    constexpr std::array<std::uint64_t, 2> state() const noexcept {
+        return {static_cast<std::uint64_t>(_direct), static_cast<std::uint64_t>(_base)};
+    }
+
+    constexpr void restore(const std::array<std::uint64_t, 2>& state) noexcept {
+        _direct = state[0] != 0;
+        _base = static_cast<size_type>(state[1]);
+    }
+};
+
+#endif
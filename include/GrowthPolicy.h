@@ -1,7 +1,10 @@
 #ifndef GROWTH_POLICY_H
 #define GROWTH_POLICY_H
 
+#include <array>
+#include <concepts>
 #include <cstddef>
+#include <cstdint>
 
 template<class Derived>
 class GrowthPolicy {
@@ -18,11 +21,11 @@ public:
      * @arg raw_hash_val output of hash function
      * @arg capacity capacity of some internal vector containing key-value pairs.
      */
-    size_type get_index(size_type capacity, size_type raw_hash_val) const noexcept {
+    constexpr size_type get_index(size_type capacity, size_type raw_hash_val) const noexcept {
         return static_cast<const Derived*>(this)->get_index_impl(capacity, raw_hash_val);
     }
 
-    size_type next_capacity(size_type capacity) const noexcept {
+    constexpr size_type next_capacity(size_type capacity) const noexcept {
         return static_cast<const Derived*>(this)->next_capacity_impl(capacity);
     }
 
@@ -33,6 +36,34 @@ public:
     constexpr size_type max_capacity() const noexcept {
         return static_cast<const Derived*>(this)->max_capacity_impl();
     }
+
+    /**
+     * whether `capacity` is one this policy could have grown a table to, e.g. a power of two for a policy that masks. Used to vet table sizes read from snapshots.
+     */
+    constexpr bool valid_capacity(size_type capacity) const noexcept {
+        return static_cast<const Derived*>(this)->valid_capacity_impl(capacity);
+    }
+
+    /**
+     * stable identifier written into snapshots. Two policies with the same name must map a hash to the same index.
+     */
+    constexpr const char* name() const noexcept {
+        return static_cast<const Derived*>(this)->name_impl();
+    }
+};
+
+/**
+ * a growth policy whose mapping depends on the hashes actually in the table, e.g. DirectAddressGrowthPolicy.
+ *
+ * discrete_map lets it choose a layout (relayout()) whenever it rebuilds the table anyway, and once more before inserting a hash that doesn't fits() the current one. While is_direct() every element sits in its home slot, so erasing needn't re-place the rest of a cluster. state() and restore() carry the layout through snapshots.
+ */
+template<class Policy>
+concept layout_growth_policy = requires(Policy& p, const Policy& cp, size_t n, bool distinct, const std::array<std::uint64_t, 2>& state) {
+    { cp.fits(n, n) } -> std::convertible_to<bool>;
+    { cp.is_direct() } -> std::convertible_to<bool>;
+    { p.relayout(n, n, n, distinct, n) } -> std::convertible_to<size_t>;
+    { cp.state() } -> std::same_as<std::array<std::uint64_t, 2>>;
+    p.restore(state);
 };
 
 #endif
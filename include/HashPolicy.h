@@ -1,31 +1,102 @@
 #ifndef HASH_POLICY_H
 #define HASH_POLICY_H
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <stdexcept>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+#include "StatsPolicy.h"
+
 template<template <class> class Derived,
-         class SizeTraits>
+         class SizeTraits,
+         class Stats = NullStatsPolicy>
 class HashPolicy {
     private:
         using derived = Derived<SizeTraits>;
         using size_type = typename SizeTraits::size_type;
         using indices_type = typename SizeTraits::indices_type;
+        using indices_collection_type = typename SizeTraits::indices_collection_type;
+        using fingerprint_type = typename indices_type::fingerprint_type;
 
         using derived_iterator = typename derived::iterator;
         using derived_const_iterator = typename derived::const_iterator;
 
         derived _derived;
 
-        std::vector<indices_type> _indices;
+        indices_collection_type _indices;
+
+        // probe() is const, so the counters have to be reachable from it.
+        [[no_unique_address]] mutable Stats _stats;
+
+        // this loop represents collision resolution if we try to rehash some element into a non-empty slot.
+        void place(size_type home, indices_type slot) {
+            derived_iterator it = _derived.begin(_indices) + home;
+            while ((*it).has_value()) {
+                ++it;
+            }
+            *it = slot;
+        }
+
+        // indexer(element) gives {home slot, slot to store}.
+        template<class Callable>
+        void place_element(Callable& indexer, size_type element) {
+            const auto [home, slot] = indexer(element);
+            place(home, slot);
+        }
+
+        // longest run of occupied slots, counting a run that wraps past the end as one.
+        size_type max_cluster_length() const noexcept {
+            size_type longest = 0;
+            size_type run = 0;
+            size_type leading = 0;
+            bool in_leading = true;
+            for (const indices_type& slot : _indices) {
+                if (slot.has_value()) {
+                    ++run;
+                }
+                else {
+                    if (in_leading) {
+                        leading = run;
+                        in_leading = false;
+                    }
+                    longest = std::max(longest, run);
+                    run = 0;
+                }
+            }
+            // a completely full table never finds an empty slot, but probing never lets that happen.
+            return in_leading ? run : std::max(longest, run + leading);
+        }
+
+        void record_probe(size_type distance, size_type comparisons) const noexcept {
+            if constexpr (Stats::enabled) {
+                _stats.on_probe(distance, comparisons);
+            }
+        }
+
+        template<class Callable>
+        void timed_rebuild(Callable&& rebuild) {
+            if constexpr (Stats::enabled) {
+                const auto start = std::chrono::steady_clock::now();
+                rebuild();
+                _stats.on_rehash(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start), max_cluster_length());
+            }
+            else {
+                rebuild();
+            }
+        }
 
     public:
 
         HashPolicy(size_type initial_capacity)
-            : _indices(initial_capacity, std::nullopt)
+            : _indices(initial_capacity)
         {}
 
         ~HashPolicy() = default;
@@ -34,9 +105,15 @@ class HashPolicy {
             return _indices.size();
         }
 
+        // what the table occupies, as the index storage counts it.
+        size_type memory_bytes() const noexcept {
+            return _indices.memory_bytes();
+        }
+
         void clear() noexcept {
             //TODO document to be careful about calling this function. you can lead to "dangling pairs".
-            _indices.clear();
+            // keeps the table size; an empty table would leave the indexer nothing to mask against.
+            _indices.assign_empty(_indices.size());
         }
 
         [[nodiscard]] float load_factor(size_type num_elements) const noexcept {
@@ -47,55 +124,142 @@ class HashPolicy {
             return _derived.threshold();
         }
 
+        probe_stats stats() const noexcept {
+            return _stats.snapshot();
+        }
+
+        void reset_stats() noexcept {
+            _stats.reset();
+        }
+
+        const Stats& stats_policy() const noexcept {
+            return _stats;
+        }
+
+        // hint that the slot is about to be probed. a read prefetch: most probes only look.
+        void prefetch(size_type slot) const noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(static_cast<const void*>(_indices.data() + slot), 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+            _mm_prefetch(reinterpret_cast<const char*>(_indices.data() + slot), _MM_HINT_T0);
+#else
+            (void)slot;
+#endif
+        }
+
+        constexpr const char* probe_name() const noexcept {
+            return _derived.name();
+        }
+
+        // raw access to the table for snapshots. A loader sizes it with resize() and then overwrites every slot.
+        const indices_type* data() const noexcept {
+            return _indices.data();
+        }
+
+        indices_type* data() noexcept {
+            return _indices.data();
+        }
+
+        void resize(size_type n) {
+            _indices.assign_empty(n);
+        }
+
+        /**
+         * grows the table to next_size and re-places the element indices [0, count).
+         *
+         * The old table is never read: the elements are exactly [0, count) because the columns are dense, so it is emptied at the new size and refilled from the indexer. That lets storage that can grow in place (reserved_index_storage) do so without a copy.
+         *
+         * @arg count number of elements in the key column
+         * @arg indexer maps an element index to {its home slot in a table of next_size, the slot that points at it}
+         */
         template<class Callable>
-        void rehash(size_type next_size, Callable indexer) {
+        void rehash(size_type next_size, size_type count, Callable indexer) {
 
             // rehashing downwards not supported
             if (next_size <= _indices.size()) {
                 return;
             }
 
-            //define a new array to store the existing indices
-            std::vector<indices_type> the_bigger_probe(next_size, std::nullopt);
-
-            // probe through the existing indices and relocate them according to the hash function.
-            for (derived_const_iterator it = _derived.cbegin(_indices); it != _derived.cend(_indices) + (-1); ++it) {
-
-                const indices_type& deref_index = *it;
-
-                if (deref_index.has_value()) {
+            timed_rebuild([&]{
+                _indices.assign_empty(next_size);
+                for (size_type i = 0; i < count; ++i) {
+                    place_element(indexer, i);
+                }
+            });
+        }
 
-                    // this loop represents collision resolution if we try to hehash some element into a non-empty slot.
-                    for (int offset = 0; true; ++offset) {
+        /**
+         * throws away every slot and re-places the element indices [0, count) at the current size.
+         *
+         * Needed whenever the key column is rearranged in bulk (e.g. compaction) because the stored indices then no longer refer to the right keys.
+         *
+         * @arg count number of elements in the key column
+         * @arg indexer maps an element index to {its home slot, the slot that points at it}
+         */
+        template<class Callable>
+        void reindex(size_type count, Callable indexer) {
+            timed_rebuild([&]{
+                _indices.assign_empty(_indices.size());
+                for (size_type i = 0; i < count; ++i) {
+                    place_element(indexer, i);
+                }
+            });
+        }
 
-                        size_type new_index = indexer(deref_index.value()) + offset;
+        /**
+         * empties `slot` and re-places whatever follows it in the same cluster.
+         *
+         * Simply nulling the slot would cut the probe sequence of any element that collided past it.
+         *
+         * @arg slot a reference previously returned by probe()
+         * @arg indexer maps an element index to {its home slot, the slot that points at it}
+         */
+        template<class Callable>
+        void erase(indices_type& slot, Callable indexer) {
+            slot = std::nullopt;
 
-                        if (!the_bigger_probe[new_index].has_value()) {
-                            the_bigger_probe[new_index] = deref_index.value();
-                            break;
-                        }
-                    }
-                }
+            derived_iterator it = _derived.begin(_indices) + static_cast<size_type>(&slot - _indices.data());
+            for (++it; (*it).has_value(); ++it) {
+                const size_type element = (*it).value();
+                *it = std::nullopt;
+                place_element(indexer, element);
             }
-
-            _indices = the_bigger_probe;
         }
 
+        /**
+         * walks the table from hash_result until stop_condition accepts an element, or (if stop_empty) until an empty slot.
+         *
+         * @arg fingerprint indices_type::fingerprint_of() the key and its hash. stop_condition only sees elements whose slot carries it, and with a slot that matches exactly (keyed_index_slot) it isn't called at all.
+         */
         template<class Callable>
-        const indices_type& probe(const size_type hash_result, Callable&& stop_condition, bool stop_empty=true) const {
+        const indices_type& probe(const size_type hash_result, const fingerprint_type& fingerprint, Callable&& stop_condition, bool stop_empty=true) const {
+            // only read when Stats is enabled; otherwise the compiler drops them.
+            size_type distance = 0;
+            size_type comparisons = 0;
+
             //loop until some condition happens in the callback.
-            for (derived_const_iterator it = _derived.cbegin(_indices) + hash_result; it != _derived.cend(_indices); ++it) {
+            for (derived_const_iterator it = _derived.cbegin(_indices) + hash_result; it != _derived.cend(_indices); ++it, ++distance) {
 
                 const indices_type& index = *it;
 
                 if (index.has_value()) {
-                    if (stop_condition(index.value())) {
-                        return index;
+                    // a different fingerprint is a different key; only a match is worth a trip to the key column.
+                    if (index.may_match(fingerprint)) {
+                        if constexpr (indices_type::exact_match) {
+                            record_probe(distance, comparisons);
+                            return index;
+                        }
+                        ++comparisons;
+                        if (stop_condition(index.value())) {
+                            record_probe(distance, comparisons);
+                            return index;
+                        }
                     }
                     //if false, the callback indicated to continue probing. We don't && the two if statements because we logically want a 'do nothing' branch when A(!B).
                 }
                 else if (stop_empty) {
                     //empty slot. under simple open addressing we stop here.
+                    record_probe(distance, comparisons);
                     return index;
                 }
             }
@@ -104,20 +268,34 @@ class HashPolicy {
 
         //mutable version
         template<class Callable>
-        indices_type& probe(const size_type hash_result, Callable&& stop_condition, bool stop_empty=true) {
+        indices_type& probe(const size_type hash_result, const fingerprint_type& fingerprint, Callable&& stop_condition, bool stop_empty=true) {
+            // only read when Stats is enabled; otherwise the compiler drops them.
+            size_type distance = 0;
+            size_type comparisons = 0;
+
             //loop until some condition happens in the callback.
-            for (derived_iterator it = _derived.begin(_indices) + hash_result; it != _derived.end(_indices); ++it) {
+            for (derived_iterator it = _derived.begin(_indices) + hash_result; it != _derived.end(_indices); ++it, ++distance) {
 
                 indices_type& index = *it;
 
                 if (index.has_value()) {
-                    if (stop_condition(index.value())) {
-                        return index;
+                    // a different fingerprint is a different key; only a match is worth a trip to the key column.
+                    if (index.may_match(fingerprint)) {
+                        if constexpr (indices_type::exact_match) {
+                            record_probe(distance, comparisons);
+                            return index;
+                        }
+                        ++comparisons;
+                        if (stop_condition(index.value())) {
+                            record_probe(distance, comparisons);
+                            return index;
+                        }
                     }
                     //if false, the callback indicated to continue probing. We don't && the two if statements because we logically want a 'do nothing' branch when A(!B).
                 }
                 else if (stop_empty) {
                     //empty slot. under simple open addressing we stop here.
+                    record_probe(distance, comparisons);
                     return index;
                 }
             }
@@ -0,0 +1,327 @@
+#ifndef LATENCY_STATS_POLICY_H
+#define LATENCY_STATS_POLICY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define DISCRETE_MAP_HAS_RDTSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define DISCRETE_MAP_HAS_RDTSC 1
+#endif
+
+#include "StatsPolicy.h"
+
+/**
+ * cheapest timestamp the platform has: the TSC on x86, steady_clock elsewhere.
+ *
+ * Ticks are converted to nanoseconds with a ratio measured once per process, the first time it's needed (a ~2ms spin).
+ */
+struct latency_clock {
+    static std::uint64_t now() noexcept {
+#ifdef DISCRETE_MAP_HAS_RDTSC
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static double ns_per_tick() noexcept {
+#ifdef DISCRETE_MAP_HAS_RDTSC
+        static const double ratio = []{
+            using steady = std::chrono::steady_clock;
+            const steady::time_point wall_start = steady::now();
+            const std::uint64_t tick_start = now();
+            steady::time_point wall_end;
+            do {
+                wall_end = steady::now();
+            } while (wall_end - wall_start < std::chrono::milliseconds(2));
+            const std::uint64_t ticks = now() - tick_start;
+            const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall_end - wall_start).count());
+            return ticks == 0 ? 1.0 : ns / static_cast<double>(ticks);
+        }();
+        return ratio;
+#else
+        return 1.0;
+#endif
+    }
+};
+
+/**
+ * log-linear histogram of nanosecond latencies, laid out like HdrHistogram.
+ *
+ * Values below 2^sub_bucket_bits get a bucket each; above that every power of two is split into 2^sub_bucket_bits equal buckets, so any recorded value is off by at most ~3%. Anything past 2^41 ns (about 36 minutes) lands in the last bucket.
+ */
+struct latency_histogram {
+    static constexpr unsigned sub_bucket_bits = 5;
+    static constexpr unsigned max_magnitude = 40;
+    static constexpr size_t sub_bucket_count = size_t(1) << sub_bucket_bits;
+    static constexpr size_t bucket_count = (max_magnitude - sub_bucket_bits + 2) * sub_bucket_count;
+
+    std::array<std::uint64_t, bucket_count> counts{};
+    std::uint64_t max = 0;
+
+    static constexpr size_t bucket_of(std::uint64_t ns) noexcept {
+        ns = std::min<std::uint64_t>(ns, (std::uint64_t(2) << max_magnitude) - 1);
+        if (ns < sub_bucket_count) {
+            return static_cast<size_t>(ns);
+        }
+        const unsigned magnitude = static_cast<unsigned>(std::bit_width(ns)) - 1;
+        const unsigned shift = magnitude - sub_bucket_bits;
+        return (magnitude - sub_bucket_bits + 1) * sub_bucket_count + static_cast<size_t>((ns >> shift) - sub_bucket_count);
+    }
+
+    // largest value that falls into `bucket`, which is what percentiles report.
+    static constexpr std::uint64_t bucket_upper_bound(size_t bucket) noexcept {
+        if (bucket < sub_bucket_count) {
+            return bucket;
+        }
+        const unsigned shift = static_cast<unsigned>(bucket / sub_bucket_count) - 1;
+        const std::uint64_t lower = (sub_bucket_count + bucket % sub_bucket_count) << shift;
+        return lower + (std::uint64_t(1) << shift) - 1;
+    }
+
+    std::uint64_t count() const noexcept {
+        std::uint64_t total = 0;
+        for (const std::uint64_t c : counts) {
+            total += c;
+        }
+        return total;
+    }
+
+    /**
+     * @arg p in [0, 100], e.g. 99.9
+     * @return nanoseconds at or below which p percent of the recorded operations completed
+     */
+    std::uint64_t percentile(double p) const noexcept {
+        const std::uint64_t total = count();
+        if (total == 0) {
+            return 0;
+        }
+        const double wanted = std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(total);
+        const std::uint64_t rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(wanted + 0.5));
+        std::uint64_t seen = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return std::min(bucket_upper_bound(i), max);
+            }
+        }
+        return max;
+    }
+
+    latency_histogram& operator+=(const latency_histogram& other) noexcept {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            counts[i] += other.counts[i];
+        }
+        max = std::max(max, other.max);
+        return *this;
+    }
+};
+
+struct latency_stats {
+    std::array<latency_histogram, stats_op_count> ops{};
+
+    const latency_histogram& operator[](stats_op op) const noexcept {
+        return ops[static_cast<size_t>(op)];
+    }
+
+    latency_histogram& operator[](stats_op op) noexcept {
+        return ops[static_cast<size_t>(op)];
+    }
+
+    latency_stats& operator+=(const latency_stats& other) noexcept {
+        for (size_t i = 0; i < stats_op_count; ++i) {
+            ops[i] += other.ops[i];
+        }
+        return *this;
+    }
+};
+
+/**
+ * CountingStatsPolicy plus a latency histogram for each of insert, find, erase, rehash and find_many. operator[] counts as an insert; a find_many() batch is one find_many sample.
+ *
+ * Every thread that touches the map records into its own buffer, so the hot path is two timestamps and a few uncontended relaxed stores; latency() takes a lock and adds the buffers up. Buffers are owned by the policy, found by thread id, and outlive the threads that filled them. Each one is about 47KB.
+ *
+ * A thread remembers the last few buffers it used in a small fixed cache, so going back to a map costs no lock. The cache never grows and dies with the thread, and entries for a policy that has since been destroyed simply never match again.
+ *
+ * Timings include everything the operation did, so an insert that had to rehash shows up in the insert tail, not just under rehash.
+ */
+class LatencyStatsPolicy : public CountingStatsPolicy {
+private:
+    struct thread_buffer {
+        std::array<std::array<std::atomic<std::uint64_t>, latency_histogram::bucket_count>, stats_op_count> counts{};
+        std::array<std::atomic<std::uint64_t>, stats_op_count> max{};
+
+        // only the owning thread writes, so a load and a store is enough and cheaper than fetch_add.
+        void record(stats_op op, std::uint64_t ns) noexcept {
+            const size_t o = static_cast<size_t>(op);
+            std::atomic<std::uint64_t>& bucket = counts[o][latency_histogram::bucket_of(ns)];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (ns > max[o].load(std::memory_order_relaxed)) {
+                max[o].store(ns, std::memory_order_relaxed);
+            }
+        }
+
+        void add_to(latency_stats& out) const noexcept {
+            for (size_t o = 0; o < stats_op_count; ++o) {
+                latency_histogram& h = out.ops[o];
+                for (size_t i = 0; i < latency_histogram::bucket_count; ++i) {
+                    h.counts[i] += counts[o][i].load(std::memory_order_relaxed);
+                }
+                h.max = std::max(h.max, max[o].load(std::memory_order_relaxed));
+            }
+        }
+
+        void clear() noexcept {
+            for (size_t o = 0; o < stats_op_count; ++o) {
+                for (std::atomic<std::uint64_t>& c : counts[o]) {
+                    c.store(0, std::memory_order_relaxed);
+                }
+                max[o].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    // the thread-local cache is keyed by this rather than by address, so a new policy at a dead one's address never picks up its buffers.
+    static std::uint64_t next_id() noexcept {
+        static std::atomic<std::uint64_t> ids{0};
+        return ids.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    std::uint64_t _id = next_id();
+
+    mutable std::mutex _buffers_mutex;
+    // a thread id can be reused once its thread has exited, and the new thread then carries on in the old one's buffer. still one writer at a time.
+    mutable std::unordered_map<std::thread::id, std::unique_ptr<thread_buffer>> _buffers;
+
+    // whatever was copied in from another policy; thread buffers only hold what happened here. kept out of line, it's as big as a buffer.
+    std::unique_ptr<latency_stats> _carried;
+
+    static constexpr size_t thread_cache_size = 4;
+
+    thread_buffer& local_buffer() const {
+        struct cache_entry {
+            std::uint64_t id = 0;
+            thread_buffer* buffer = nullptr;
+        };
+        thread_local std::array<cache_entry, thread_cache_size> cache{};
+        thread_local size_t next_victim = 0;
+
+        for (const cache_entry& entry : cache) {
+            if (entry.id == _id) {
+                return *entry.buffer;
+            }
+        }
+
+        thread_buffer* buffer;
+        {
+            std::lock_guard lock(_buffers_mutex);
+            std::unique_ptr<thread_buffer>& owned = _buffers[std::this_thread::get_id()];
+            if (!owned) {
+                owned = std::make_unique<thread_buffer>();
+            }
+            buffer = owned.get();
+        }
+        cache[next_victim] = {_id, buffer};
+        next_victim = (next_victim + 1) % thread_cache_size;
+        return *buffer;
+    }
+
+    static std::uint64_t to_ns(std::uint64_t ticks) noexcept {
+        return static_cast<std::uint64_t>(static_cast<double>(ticks) * latency_clock::ns_per_tick());
+    }
+
+public:
+    class timer {
+    private:
+        const LatencyStatsPolicy* _policy;
+        stats_op _op;
+        std::uint64_t _start;
+
+    public:
+        timer(const LatencyStatsPolicy& policy, stats_op op) noexcept
+            : _policy(&policy),
+              _op(op),
+              _start(latency_clock::now())
+        {}
+
+        timer(const timer&) = delete;
+        timer& operator=(const timer&) = delete;
+
+        ~timer() {
+            _policy->record(_op, to_ns(latency_clock::now() - _start));
+        }
+    };
+
+    LatencyStatsPolicy() = default;
+
+    LatencyStatsPolicy(const LatencyStatsPolicy& other)
+        : CountingStatsPolicy(other),
+          _carried(std::make_unique<latency_stats>(other.latency()))
+    {}
+
+    LatencyStatsPolicy& operator=(const LatencyStatsPolicy& other) {
+        if (this != &other) {
+            CountingStatsPolicy::operator=(other);
+            std::unique_ptr<latency_stats> carried = std::make_unique<latency_stats>(other.latency());
+            std::lock_guard lock(_buffers_mutex);
+            for (const auto& [thread, buffer] : _buffers) {
+                buffer->clear();
+            }
+            _carried = std::move(carried);
+        }
+        return *this;
+    }
+
+    timer time(stats_op op) const noexcept {
+        return timer(*this, op);
+    }
+
+    // operations that run past their own timer (a buffer allocation failing, say) simply go unrecorded.
+    void record(stats_op op, std::uint64_t ns) const noexcept {
+        try {
+            local_buffer().record(op, ns);
+        }
+        catch (...) {}
+    }
+
+    void on_rehash(std::chrono::nanoseconds elapsed, size_t max_cluster_length) noexcept {
+        CountingStatsPolicy::on_rehash(elapsed, max_cluster_length);
+        record(stats_op::rehash, static_cast<std::uint64_t>(elapsed.count()));
+    }
+
+    latency_stats latency() const {
+        latency_stats merged{};
+        std::lock_guard lock(_buffers_mutex);
+        if (_carried) {
+            merged = *_carried;
+        }
+        for (const auto& [thread, buffer] : _buffers) {
+            buffer->add_to(merged);
+        }
+        return merged;
+    }
+
+    void reset() noexcept {
+        CountingStatsPolicy::reset();
+        std::lock_guard lock(_buffers_mutex);
+        for (const auto& [thread, buffer] : _buffers) {
+            buffer->clear();
+        }
+        _carried.reset();
+    }
+};
+
+#endif
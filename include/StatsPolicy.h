@@ -0,0 +1,170 @@
+#ifndef STATS_POLICY_H
+#define STATS_POLICY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// operations a stats policy can time.
+enum class stats_op {
+    insert,
+    find,
+    erase,
+    rehash,
+    // one sample per find_many() call, however many keys it was given.
+    find_many
+};
+
+inline constexpr size_t stats_op_count = 5;
+
+// what time() hands back from policies that don't time anything.
+struct no_stats_timer {};
+
+/**
+ * what a stats policy reports. All counts are since construction or the last reset.
+ */
+struct probe_stats {
+    // probe distances 0 .. size()-2 get their own bucket; the last one collects everything further out.
+    static constexpr size_t histogram_size = 32;
+
+    std::uint64_t lookups = 0;
+    // slots visited across all lookups, including the one that ended the probe.
+    std::uint64_t probes = 0;
+    std::uint64_t key_comparisons = 0;
+    std::uint64_t max_probe_distance = 0;
+    std::array<std::uint64_t, histogram_size> probe_distance_histogram{};
+
+    std::uint64_t rehashes = 0;
+    std::chrono::nanoseconds rehash_time{0};
+    // longest run of occupied slots, measured after the most recent rehash.
+    std::uint64_t max_cluster_length = 0;
+
+    double mean_probes() const noexcept {
+        return lookups == 0 ? 0.0 : static_cast<double>(probes) / static_cast<double>(lookups);
+    }
+};
+
+/**
+ * default stats policy: records nothing.
+ *
+ * HashPolicy checks `enabled` with `if constexpr`, so with this policy not even the counters it would pass in are computed.
+ */
+class NullStatsPolicy {
+public:
+    static constexpr bool enabled = false;
+
+    void on_probe(size_t, size_t) const noexcept {}
+
+    no_stats_timer time(stats_op) const noexcept {
+        return {};
+    }
+
+    void on_rehash(std::chrono::nanoseconds, size_t) noexcept {}
+
+    probe_stats snapshot() const noexcept {
+        return {};
+    }
+
+    void reset() noexcept {}
+};
+
+/**
+ * counts what HashPolicy::probe() and rehash() do.
+ *
+ * Lookups are const and may run concurrently (e.g. under a shared lock), so the counters are relaxed atomics. Each one is exact on its own, but a snapshot taken while lookups are running isn't a single consistent moment.
+ */
+class CountingStatsPolicy {
+private:
+    using counter = std::atomic<std::uint64_t>;
+
+    mutable counter _lookups{0};
+    mutable counter _probes{0};
+    mutable counter _key_comparisons{0};
+    mutable counter _max_probe_distance{0};
+    mutable std::array<counter, probe_stats::histogram_size> _histogram{};
+
+    counter _rehashes{0};
+    counter _rehash_ns{0};
+    counter _max_cluster_length{0};
+
+    static void raise_to(counter& c, std::uint64_t value) noexcept {
+        std::uint64_t seen = c.load(std::memory_order_relaxed);
+        while (seen < value && !c.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+    }
+
+    void copy_from(const CountingStatsPolicy& other) noexcept {
+        const probe_stats s = other.snapshot();
+        _lookups.store(s.lookups, std::memory_order_relaxed);
+        _probes.store(s.probes, std::memory_order_relaxed);
+        _key_comparisons.store(s.key_comparisons, std::memory_order_relaxed);
+        _max_probe_distance.store(s.max_probe_distance, std::memory_order_relaxed);
+        for (size_t i = 0; i < _histogram.size(); ++i) {
+            _histogram[i].store(s.probe_distance_histogram[i], std::memory_order_relaxed);
+        }
+        _rehashes.store(s.rehashes, std::memory_order_relaxed);
+        _rehash_ns.store(static_cast<std::uint64_t>(s.rehash_time.count()), std::memory_order_relaxed);
+        _max_cluster_length.store(s.max_cluster_length, std::memory_order_relaxed);
+    }
+
+public:
+    static constexpr bool enabled = true;
+
+    CountingStatsPolicy() = default;
+
+    CountingStatsPolicy(const CountingStatsPolicy& other) noexcept {
+        copy_from(other);
+    }
+
+    CountingStatsPolicy& operator=(const CountingStatsPolicy& other) noexcept {
+        if (this != &other) {
+            copy_from(other);
+        }
+        return *this;
+    }
+
+    /**
+     * @arg distance slots stepped past the home slot before the probe ended
+     * @arg comparisons key comparisons the probe made
+     */
+    void on_probe(size_t distance, size_t comparisons) const noexcept {
+        _lookups.fetch_add(1, std::memory_order_relaxed);
+        _probes.fetch_add(distance + 1, std::memory_order_relaxed);
+        _key_comparisons.fetch_add(comparisons, std::memory_order_relaxed);
+        _histogram[std::min(distance, probe_stats::histogram_size - 1)].fetch_add(1, std::memory_order_relaxed);
+        raise_to(_max_probe_distance, distance);
+    }
+
+    no_stats_timer time(stats_op) const noexcept {
+        return {};
+    }
+
+    void on_rehash(std::chrono::nanoseconds elapsed, size_t max_cluster_length) noexcept {
+        _rehashes.fetch_add(1, std::memory_order_relaxed);
+        _rehash_ns.fetch_add(static_cast<std::uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        _max_cluster_length.store(max_cluster_length, std::memory_order_relaxed);
+    }
+
+    probe_stats snapshot() const noexcept {
+        probe_stats s;
+        s.lookups = _lookups.load(std::memory_order_relaxed);
+        s.probes = _probes.load(std::memory_order_relaxed);
+        s.key_comparisons = _key_comparisons.load(std::memory_order_relaxed);
+        s.max_probe_distance = _max_probe_distance.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < _histogram.size(); ++i) {
+            s.probe_distance_histogram[i] = _histogram[i].load(std::memory_order_relaxed);
+        }
+        s.rehashes = _rehashes.load(std::memory_order_relaxed);
+        s.rehash_time = std::chrono::nanoseconds(_rehash_ns.load(std::memory_order_relaxed));
+        s.max_cluster_length = _max_cluster_length.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    void reset() noexcept {
+        copy_from(CountingStatsPolicy());
+    }
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef ATOMIC_DISCRETE_MAP_H
+#define ATOMIC_DISCRETE_MAP_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "BitwiseGrowthPolicy.h"
+#include "discrete_map.h"
+#include "linear_prober.h"
+
+/**
+ * discrete_map with a fixed key set whose values are updated atomically, without locks.
+ *
+ * The keys are frozen at construction: nothing can be inserted or erased afterwards, so the index and the key column never change and any number of threads can look keys up at once without synchronising. Every value is then read and written only through std::atomic_ref, which makes the value column a table of atomics that still lives in one contiguous column.
+ *
+ * This is the fixed-set counter table: build it from the keys you'll count, then fetch_add() from as many threads as you like. Contended keys still bounce their cache line between cores, as any shared atomic does.
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class Growth = BitwiseGrowthPolicy,
+         template<class> class Probe = linear_prober>
+class atomic_discrete_map {
+    static_assert(std::is_trivially_copyable_v<T>, "atomic_discrete_map: std::atomic_ref needs a trivially copyable value type.");
+    static_assert(alignof(T) >= std::atomic_ref<T>::required_alignment, "atomic_discrete_map: values aren't aligned enough for std::atomic_ref.");
+
+    public:
+        // types
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<const Key, T>;
+        using hasher = Hash;
+        using key_equal = Pred;
+
+        // what the keys are kept in until, and after, they're frozen.
+        using map_type = discrete_map<Key, T, Hash, Pred, std::allocator<Key>, std::allocator<T>, Growth, Probe>;
+        using size_type = typename map_type::size_type;
+        using key_collection_type = typename map_type::key_collection_type;
+
+    private:
+        map_type _map;
+
+        // the structure is never modified after construction, so looking a key up is safe from any thread; the value itself is only ever reached through atomic_ref.
+        mapped_type& value_of(const key_type& k, const char* out_of_range_message) const {
+            const mapped_type* found = nullptr;
+            _map.visit(k, [&found](const mapped_type& v) {
+                found = &v;
+            });
+            if (!found) {
+                throw std::out_of_range(out_of_range_message);
+            }
+            return const_cast<mapped_type&>(*found);
+        }
+
+    public:
+
+//construct/copy/destroy
+
+        /**
+         * freezes the keys of `source`, taking its columns over. Values start out as they were in source.
+         */
+        explicit atomic_discrete_map(map_type&& source)
+            : _map(std::move(source))
+        {}
+
+        explicit atomic_discrete_map(const map_type& source)
+            : _map(source)
+        {}
+
+        /**
+         * builds from a range of key/value pairs. Later duplicates of a key are ignored, as with insert().
+         */
+        template<std::input_iterator InputIterator>
+        atomic_discrete_map(InputIterator first, InputIterator last)
+            : _map(first, last, 0)
+        {}
+
+        atomic_discrete_map(std::initializer_list<value_type> il)
+            : atomic_discrete_map(il.begin(), il.end())
+        {}
+
+        // copying reads every value non-atomically, so neither copy nor move is offered.
+        atomic_discrete_map(const atomic_discrete_map&) = delete;
+        atomic_discrete_map& operator=(const atomic_discrete_map&) = delete;
+
+//getters
+
+        const key_collection_type& keys() const noexcept {
+            return _map.keys();
+        }
+
+//capacity
+
+        [[nodiscard]] bool empty() const noexcept {
+            return _map.empty();
+        }
+
+        size_type size() const noexcept {
+            return _map.size();
+        }
+
+//observers
+
+        key_equal key_eq() const {
+            return _map.key_eq();
+        }
+
+        hasher hash_function() const {
+            return _map.hash_function();
+        }
+
+//map operations
+
+        bool contains(const key_type& k) const {
+            return _map.contains(k);
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+//element access
+
+        /**
+         * the value stored for k, as an atomic_ref for anything the methods below don't cover.
+         *
+         * @throws std::out_of_range if the key isn't one of the frozen keys
+         */
+        std::atomic_ref<mapped_type> ref(const key_type& k) {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::ref() thrown exception: key out of range."));
+        }
+
+        mapped_type load(const key_type& k, std::memory_order order = std::memory_order_seq_cst) const {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::load() thrown exception: key out of range.")).load(order);
+        }
+
+        void store(const key_type& k, mapped_type desired, std::memory_order order = std::memory_order_seq_cst) {
+            std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::store() thrown exception: key out of range.")).store(desired, order);
+        }
+
+        mapped_type exchange(const key_type& k, mapped_type desired, std::memory_order order = std::memory_order_seq_cst) {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::exchange() thrown exception: key out of range.")).exchange(desired, order);
+        }
+
+        bool compare_exchange_weak(const key_type& k, mapped_type& expected, mapped_type desired, std::memory_order order = std::memory_order_seq_cst) {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::compare_exchange_weak() thrown exception: key out of range.")).compare_exchange_weak(expected, desired, order);
+        }
+
+        bool compare_exchange_strong(const key_type& k, mapped_type& expected, mapped_type desired, std::memory_order order = std::memory_order_seq_cst) {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::compare_exchange_strong() thrown exception: key out of range.")).compare_exchange_strong(expected, desired, order);
+        }
+
+        /**
+         * adds `arg` to the value for k and returns what it was before. Only for the arithmetic types atomic_ref can add to.
+         *
+         * Counters that are only read once the writers are done can pass std::memory_order_relaxed.
+         */
+        mapped_type fetch_add(const key_type& k, mapped_type arg, std::memory_order order = std::memory_order_seq_cst)
+            requires requires (std::atomic_ref<mapped_type> r, mapped_type a) { r.fetch_add(a); }
+        {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::fetch_add() thrown exception: key out of range.")).fetch_add(arg, order);
+        }
+
+        mapped_type fetch_sub(const key_type& k, mapped_type arg, std::memory_order order = std::memory_order_seq_cst)
+            requires requires (std::atomic_ref<mapped_type> r, mapped_type a) { r.fetch_sub(a); }
+        {
+            return std::atomic_ref<mapped_type>(value_of(k, "atomic_discrete_map::fetch_sub() thrown exception: key out of range.")).fetch_sub(arg, order);
+        }
+
+//bulk operations
+
+        /**
+         * calls `f(key, value)` for every element, each value loaded atomically with `order`.
+         *
+         * Each value is read on its own, so while writers are still running the values seen need not all come from the same moment.
+         */
+        template<class Callable>
+        void for_each(Callable&& f, std::memory_order order = std::memory_order_seq_cst) const {
+            const auto& keys = _map.keys();
+            const auto& values = _map.values();
+            for (size_type i = 0; i < keys.size(); ++i) {
+                f(keys[i], std::atomic_ref<mapped_type>(const_cast<mapped_type&>(values[i])).load(order));
+            }
+        }
+};
+
+#endif
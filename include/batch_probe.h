@@ -0,0 +1,124 @@
+#ifndef BATCH_PROBE_H
+#define BATCH_PROBE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "cpu_dispatch.h"
+
+#ifdef DISCRETE_MAP_DISPATCH_X86
+#include <immintrin.h>
+#endif
+
+// vectorised kernels behind discrete_map::find_many(). A kernel settles every key it can from its home slot alone and leaves the rest to the ordinary probe.
+//
+// Every kernel has the signature of batch_probe_kernel and works on a table of keyed_index_slot<size_t, Key> whose home slot is `hash & mask` and whose hash is the identity:
+//   positions gets, per key, the element position, size_t(-1) for a miss, or batch_probe_unresolved
+//   returns how many keys it handled, count rounded down to a whole number of vectors. The rest are the caller's.
+
+// what a kernel writes for a key whose home slot holds some other key. never a real element position: keyed_index_slot::max_elements stops one short of it.
+inline constexpr size_t batch_probe_unresolved = static_cast<size_t>(-2);
+
+// whether std::hash of an integer is just the integer converted to size_t, which lets a kernel hash by widening the keys.
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION)
+inline constexpr bool batch_probe_identity_hash = true;
+#else
+inline constexpr bool batch_probe_identity_hash = false;
+#endif
+
+template<class Slot, class Key>
+using batch_probe_kernel = size_t (*)(const Slot* slots, size_t mask, const Key* keys, size_t count, size_t* positions) noexcept;
+
+#ifdef DISCRETE_MAP_DISPATCH_X86
+// groups of keys to prefetch ahead of the gathers. a gather waits for all of its lines, so the slots needed a few groups from now are requested early, as find_many()'s scalar loop does.
+inline constexpr size_t batch_probe_prefetch_groups = 4;
+
+template<class Slot, class Key>
+constexpr void batch_probe_check_layout() noexcept {
+    static_assert(std::is_integral_v<Key> && (sizeof(Key) == 4 || sizeof(Key) == 8));
+    static_assert(sizeof(size_t) == 8 && sizeof(Slot) == 16 && Slot::key_offset() == 8, "batch_probe: expects a 64-bit element word followed by the key.");
+}
+
+// four keys widened to their hashes. std::hash sign-extends signed keys, so the home slot has to be computed the same way.
+template<class Key>
+DISCRETE_MAP_TARGET_AVX2 inline __m256i batch_probe_hashes_avx2(const Key* keys) noexcept {
+    if constexpr (sizeof(Key) == 8) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys));
+    }
+    else if constexpr (std::is_signed_v<Key>) {
+        return _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)));
+    }
+    else {
+        return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)));
+    }
+}
+
+template<class Key>
+DISCRETE_MAP_TARGET_AVX2 inline void batch_probe_prefetch_avx2(const long long* words, __m256i vmask, const Key* keys) noexcept {
+    alignas(32) long long home[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(home), _mm256_and_si256(batch_probe_hashes_avx2(keys), vmask));
+    for (long long h : home) {
+        _mm_prefetch(reinterpret_cast<const char*>(words + 2 * h), _MM_HINT_T0);
+    }
+}
+
+/**
+ * four keys per iteration with AVX2 gathers.
+ *
+ * Each lane gathers the element word and the key word of its home slot. A matching key is a hit and an empty slot a miss; only a slot holding another key, i.e. a collision, is left as batch_probe_unresolved.
+ */
+template<class Slot, class Key>
+DISCRETE_MAP_TARGET_AVX2 size_t batch_probe_avx2(const Slot* slots, size_t mask, const Key* keys, size_t count, size_t* positions) noexcept {
+    batch_probe_check_layout<Slot, Key>();
+
+    const long long* words = reinterpret_cast<const long long*>(slots);
+    const __m256i vmask = _mm256_set1_epi64x(static_cast<long long>(mask));
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i unresolved = _mm256_set1_epi64x(static_cast<long long>(batch_probe_unresolved));
+    // a 4-byte key shares its word with padding, which is never written and so can be anything.
+    const __m256i key_bits = _mm256_set1_epi64x(sizeof(Key) == 8 ? -1ll : 0xFFFFFFFFll);
+
+    const size_t groups = count / 4;
+    for (size_t group = 0; group < groups && group < batch_probe_prefetch_groups; ++group) {
+        batch_probe_prefetch_avx2(words, vmask, keys + group * 4);
+    }
+
+    for (size_t group = 0; group < groups; ++group) {
+        if (group + batch_probe_prefetch_groups < groups) {
+            batch_probe_prefetch_avx2(words, vmask, keys + (group + batch_probe_prefetch_groups) * 4);
+        }
+
+        const __m256i hash = batch_probe_hashes_avx2(keys + group * 4);
+
+        // slot n is words 2n (element + 1, 0 when empty) and 2n + 1 (the key).
+        const __m256i word = _mm256_slli_epi64(_mm256_and_si256(hash, vmask), 1);
+        const __m256i element = _mm256_i64gather_epi64(words, word, 8);
+        const __m256i stored = _mm256_i64gather_epi64(words + 1, word, 8);
+
+        const __m256i same = _mm256_cmpeq_epi64(_mm256_and_si256(stored, key_bits), _mm256_and_si256(hash, key_bits));
+        const __m256i empty = _mm256_cmpeq_epi64(element, zero);
+
+        // element - 1 is the position on a hit and size_t(-1) on an empty slot, which is exactly what a miss reports.
+        const __m256i settled = _mm256_or_si256(same, empty);
+        const __m256i result = _mm256_blendv_epi8(unresolved, _mm256_sub_epi64(element, one), settled);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(positions + group * 4), result);
+    }
+    return groups * 4;
+}
+#endif
+
+// the kernel for active_simd_level(), or nullptr for the scalar probe. discrete_map asks once per map type and keeps the pointer.
+template<class Slot, class Key>
+batch_probe_kernel<Slot, Key> batch_probe_select() noexcept {
+#ifdef DISCRETE_MAP_DISPATCH_X86
+    // AVX-512 hosts get the AVX2 kernel too: eight-lane gathers measured no faster than four-lane ones, the lookups being bound by the slots' cache lines rather than by lanes.
+    if (active_simd_level() >= simd_level::avx2) {
+        return &batch_probe_avx2<Slot, Key>;
+    }
+#endif
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,480 @@
+#ifndef COLUMN_H
+#define COLUMN_H
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * whether a T can be moved to a new address with memcpy, the old bytes then simply forgotten (no destructor).
+ *
+ * True for trivially copyable types. Also true for most types that own a heap pointer and don't point into themselves, which covers std::unique_ptr, std::shared_ptr and, on the standard libraries where it holds, std::vector and std::string. Specialise it for your own such types:
+ *
+ *   template<> struct is_trivially_relocatable<my_handle> : std::true_type {};
+ *
+ * Getting this wrong for a type that keeps pointers to itself (libstdc++'s std::string, for one) corrupts it.
+ */
+template<class T>
+struct is_trivially_relocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template<class T>
+inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+template<class T, class Deleter>
+struct is_trivially_relocatable<std::unique_ptr<T, Deleter>> : is_trivially_relocatable<Deleter> {};
+
+template<class T>
+struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+
+template<class T>
+struct is_trivially_relocatable<std::weak_ptr<T>> : std::true_type {};
+
+// three pointers and an empty allocator in both. MSVC's debug builds keep a proxy pointing back at the vector, so not there.
+#if defined(__GLIBCXX__) || defined(_LIBCPP_VERSION)
+template<class T>
+struct is_trivially_relocatable<std::vector<T, std::allocator<T>>> : std::true_type {};
+#endif
+
+// libstdc++'s short strings point into their own buffer; libc++'s don't.
+#if defined(_LIBCPP_VERSION)
+template<class CharT, class Traits>
+struct is_trivially_relocatable<std::basic_string<CharT, Traits, std::allocator<CharT>>> : std::true_type {};
+#endif
+
+/**
+ * contiguous storage for one of discrete_map's columns. The subset of std::vector's interface the map needs, plus relocation.
+ *
+ * For trivially relocatable T, growing and erasing move elements with memcpy/memmove instead of a move constructor and destructor per element. If Alloc also has `T* reallocate(T* p, size_type old_capacity, size_type new_capacity)`, growing hands the whole buffer to that instead, which for malloc_allocator is realloc() and may not copy at all.
+ *
+ * Other types get what std::vector would do: move if that can't throw, copy otherwise.
+ */
+template<class T, class Alloc = std::allocator<T>>
+class column {
+    public:
+        using value_type = T;
+        using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using const_reference = const T&;
+        using pointer = T*;
+        using const_pointer = const T*;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+    private:
+        using alloc_traits = std::allocator_traits<allocator_type>;
+
+        static constexpr bool relocatable = is_trivially_relocatable_v<T>;
+        static constexpr bool has_reallocate = requires (allocator_type& a, T* p, size_type n) {
+            { a.reallocate(p, n, n) } -> std::same_as<T*>;
+        };
+
+        [[no_unique_address]] allocator_type _alloc;
+        T* _data = nullptr;
+        size_type _size = 0;
+        size_type _capacity = 0;
+
+        static void relocate(T* to, T* from, size_type n) noexcept {
+            if (n > 0) {
+                // the void casts tell GCC we know T isn't trivially copyable; that's what the trait is for.
+                std::memcpy(static_cast<void*>(to), static_cast<const void*>(from), n * sizeof(T));
+            }
+        }
+
+        void destroy_range(T* first, T* last) noexcept {
+            if constexpr (!std::is_trivially_destructible_v<T>) {
+                for (; first != last; ++first) {
+                    alloc_traits::destroy(_alloc, first);
+                }
+            }
+        }
+
+        void free_storage() noexcept {
+            destroy_range(_data, _data + _size);
+            if (_data) {
+                alloc_traits::deallocate(_alloc, _data, _capacity);
+            }
+            _data = nullptr;
+            _size = 0;
+            _capacity = 0;
+        }
+
+        void take_storage(column& other) noexcept {
+            _data = std::exchange(other._data, nullptr);
+            _size = std::exchange(other._size, 0);
+            _capacity = std::exchange(other._capacity, 0);
+        }
+
+        // moves the elements to a buffer of exactly new_capacity (>= size).
+        void reallocate_storage(size_type new_capacity) {
+            if constexpr (relocatable && has_reallocate) {
+                if (_data) {
+                    _data = _alloc.reallocate(_data, _capacity, new_capacity);
+                    _capacity = new_capacity;
+                    return;
+                }
+            }
+
+            T* fresh = alloc_traits::allocate(_alloc, new_capacity);
+            if constexpr (relocatable) {
+                relocate(fresh, _data, _size);
+            }
+            else {
+                try {
+                    if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>) {
+                        std::uninitialized_move(_data, _data + _size, fresh);
+                    }
+                    else {
+                        std::uninitialized_copy(_data, _data + _size, fresh);
+                    }
+                }
+                catch (...) {
+                    alloc_traits::deallocate(_alloc, fresh, new_capacity);
+                    throw;
+                }
+                destroy_range(_data, _data + _size);
+            }
+
+            if (_data) {
+                alloc_traits::deallocate(_alloc, _data, _capacity);
+            }
+            _data = fresh;
+            _capacity = new_capacity;
+        }
+
+        size_type grown_capacity(size_type at_least) const noexcept {
+            return std::max(at_least, _capacity == 0 ? size_type(1) : _capacity * 2);
+        }
+
+        void copy_from(const column& other) {
+            if (other._size == 0) {
+                return;
+            }
+            _data = alloc_traits::allocate(_alloc, other._size);
+            _capacity = other._size;
+            try {
+                std::uninitialized_copy(other._data, other._data + other._size, _data);
+            }
+            catch (...) {
+                alloc_traits::deallocate(_alloc, _data, _capacity);
+                _data = nullptr;
+                _capacity = 0;
+                throw;
+            }
+            _size = other._size;
+        }
+
+    public:
+//construct/copy/destroy
+
+        column() noexcept(noexcept(allocator_type())) = default;
+
+        explicit column(const allocator_type& alloc) noexcept
+            : _alloc(alloc)
+        {}
+
+        column(const column& other)
+            : _alloc(alloc_traits::select_on_container_copy_construction(other._alloc))
+        {
+            copy_from(other);
+        }
+
+        column(const column& other, const allocator_type& alloc)
+            : _alloc(alloc)
+        {
+            copy_from(other);
+        }
+
+        // the allocator is copied, not moved: a moved-from allocator that shares state (counting_allocator) would be left empty.
+        column(column&& other) noexcept
+            : _alloc(other._alloc)
+        {
+            take_storage(other);
+        }
+
+        column(std::initializer_list<T> il, const allocator_type& alloc = allocator_type())
+            : _alloc(alloc)
+        {
+            reserve(il.size());
+            for (const T& element : il) {
+                push_back(element);
+            }
+        }
+
+        column& operator=(const column& other) {
+            if (this != &other) {
+                column copy(other, alloc_traits::propagate_on_container_copy_assignment::value ? other._alloc : _alloc);
+                free_storage();
+                if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+                    _alloc = other._alloc;
+                }
+                take_storage(copy);
+            }
+            return *this;
+        }
+
+        column& operator=(column&& other) noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) {
+            if (this == &other) {
+                return *this;
+            }
+            if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+                free_storage();
+                _alloc = other._alloc;
+                take_storage(other);
+            }
+            else {
+                if (_alloc == other._alloc) {
+                    free_storage();
+                    take_storage(other);
+                }
+                else {
+                    // different arenas: the buffer can't change hands, only the elements can.
+                    clear();
+                    reserve(other._size);
+                    for (T& element : other) {
+                        push_back(std::move(element));
+                    }
+                    other.clear();
+                }
+            }
+            return *this;
+        }
+
+        ~column() {
+            free_storage();
+        }
+
+        allocator_type get_allocator() const noexcept {
+            return _alloc;
+        }
+
+//iterators
+
+        iterator begin() noexcept {
+            return _data;
+        }
+
+        const_iterator begin() const noexcept {
+            return _data;
+        }
+
+        iterator end() noexcept {
+            return _data + _size;
+        }
+
+        const_iterator end() const noexcept {
+            return _data + _size;
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+
+//capacity
+
+        [[nodiscard]] bool empty() const noexcept {
+            return _size == 0;
+        }
+
+        size_type size() const noexcept {
+            return _size;
+        }
+
+        size_type capacity() const noexcept {
+            return _capacity;
+        }
+
+        size_type max_size() const noexcept {
+            return alloc_traits::max_size(_alloc);
+        }
+
+        void reserve(size_type n) {
+            if (n > _capacity) {
+                reallocate_storage(n);
+            }
+        }
+
+        void shrink_to_fit() {
+            if (_size == 0) {
+                free_storage();
+            }
+            else if (_size < _capacity) {
+                reallocate_storage(_size);
+            }
+        }
+
+        void resize(size_type n) {
+            if (n < _size) {
+                destroy_range(_data + n, _data + _size);
+                _size = n;
+                return;
+            }
+            reserve(n);
+            for (; _size < n; ++_size) {
+                alloc_traits::construct(_alloc, _data + _size);
+            }
+        }
+
+//element access
+
+        reference operator[](size_type i) noexcept {
+            return _data[i];
+        }
+
+        const_reference operator[](size_type i) const noexcept {
+            return _data[i];
+        }
+
+        const_reference at(size_type i) const {
+            if (i >= _size) {
+                throw std::out_of_range("column::at() const thrown exception: index out of range.");
+            }
+            return _data[i];
+        }
+
+        reference at(size_type i) {
+            return const_cast<reference>(std::as_const(*this).at(i));
+        }
+
+        reference front() noexcept {
+            return _data[0];
+        }
+
+        const_reference front() const noexcept {
+            return _data[0];
+        }
+
+        reference back() noexcept {
+            return _data[_size - 1];
+        }
+
+        const_reference back() const noexcept {
+            return _data[_size - 1];
+        }
+
+        T* data() noexcept {
+            return _data;
+        }
+
+        const T* data() const noexcept {
+            return _data;
+        }
+
+//modifiers
+
+        template<class... Args>
+        reference emplace_back(Args&&... args) {
+            if (_size == _capacity) {
+                // the arguments may refer into this column, which growing invalidates. build the element first.
+                T element(std::forward<Args>(args)...);
+                reallocate_storage(grown_capacity(_size + 1));
+                alloc_traits::construct(_alloc, _data + _size, std::move(element));
+            }
+            else {
+                alloc_traits::construct(_alloc, _data + _size, std::forward<Args>(args)...);
+            }
+            return _data[_size++];
+        }
+
+        void push_back(const T& value) {
+            emplace_back(value);
+        }
+
+        void push_back(T&& value) {
+            emplace_back(std::move(value));
+        }
+
+        void pop_back() noexcept {
+            --_size;
+            destroy_range(_data + _size, _data + _size + 1);
+        }
+
+        iterator erase(const_iterator first, const_iterator last) {
+            T* const from = _data + (first - _data);
+            T* const to = _data + (last - _data);
+            if (from == to) {
+                return from;
+            }
+
+            T* const old_end = end();
+            if constexpr (relocatable) {
+                destroy_range(from, to);
+                if (to != old_end) {
+                    std::memmove(static_cast<void*>(from), static_cast<const void*>(to), static_cast<size_type>(old_end - to) * sizeof(T));
+                }
+            }
+            else {
+                T* const new_end = std::move(to, old_end, from);
+                destroy_range(new_end, old_end);
+            }
+            _size -= static_cast<size_type>(to - from);
+            return from;
+        }
+
+        iterator erase(const_iterator position) {
+            return erase(position, position + 1);
+        }
+
+        /**
+         * removes element i by moving the last element into its place. Doesn't keep order, but never shifts more than one element.
+         */
+        void erase_by_swap(size_type i) noexcept(relocatable || std::is_nothrow_move_assignable_v<T>) {
+            const size_type last = _size - 1;
+            if constexpr (relocatable) {
+                destroy_range(_data + i, _data + i + 1);
+                if (i != last) {
+                    relocate(_data + i, _data + last, 1);
+                }
+                --_size;
+            }
+            else {
+                if (i != last) {
+                    _data[i] = std::move(_data[last]);
+                }
+                pop_back();
+            }
+        }
+
+        void clear() noexcept {
+            destroy_range(_data, _data + _size);
+            _size = 0;
+        }
+
+        void swap(column& other) noexcept {
+            if constexpr (alloc_traits::propagate_on_container_swap::value) {
+                using std::swap;
+                swap(_alloc, other._alloc);
+            }
+            std::swap(_data, other._data);
+            std::swap(_size, other._size);
+            std::swap(_capacity, other._capacity);
+        }
+
+        friend bool operator==(const column& lhs, const column& rhs) {
+            return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+        }
+};
+
+/**
+ * which collection discrete_map keeps a value column of T in. A column<T> unless specialised; columns.h makes columns<Ts...> a column_group.
+ */
+template<class T, class Alloc>
+struct value_storage {
+    using type = column<T, Alloc>;
+};
+
+#endif
@@ -0,0 +1,450 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "column.h"
+#include "memory_usage.h"
+
+template<bool is_const, class... Ts>
+class columns_row;
+
+/**
+ * a value type with several fields, for discrete_map<Key, columns<A, B, C>>.
+ *
+ * As a value it's a std::tuple, so inserting one or reading one back out works like any other value. What changes is the storage: the map keeps one dense column per field (see column_group), so a scan over one field touches only that field's memory. Lookups hand out a columns_row, a proxy onto the element's fields in each column.
+ *
+ * Read and write fields with get<I>(), on the value or on a row.
+ */
+template<class... Ts>
+struct columns : std::tuple<Ts...> {
+    static_assert(sizeof...(Ts) > 0, "columns: at least one field.");
+
+    using std::tuple<Ts...>::tuple;
+
+    constexpr columns() = default;
+
+    template<bool is_const>
+    constexpr columns(const columns_row<is_const, Ts...>& row)
+        : std::tuple<Ts...>(row.copy_out())
+    {}
+
+    constexpr columns(const std::tuple<Ts...>& fields)
+        : std::tuple<Ts...>(fields)
+    {}
+};
+
+template<class... Ts>
+struct std::tuple_size<columns<Ts...>> : std::integral_constant<size_t, sizeof...(Ts)> {};
+
+template<size_t I, class... Ts>
+struct std::tuple_element<I, columns<Ts...>> : std::tuple_element<I, std::tuple<Ts...>> {};
+
+/**
+ * one element of a column_group: a reference to its field in each column.
+ *
+ * Assigning to a row writes through to the columns, field by field; assigning one row to another copies the fields, it never rebinds. columns<Ts...> converts from a row when a copy of the whole value is wanted.
+ */
+template<bool is_const, class... Ts>
+class columns_row {
+    private:
+        template<class T>
+        using field_ref = std::conditional_t<is_const, const T&, T&>;
+
+        std::tuple<field_ref<Ts>...> _fields;
+
+        template<class Tuple, size_t... I>
+        void assign(Tuple&& from, std::index_sequence<I...>) const {
+            ((std::get<I>(_fields) = std::get<I>(std::forward<Tuple>(from))), ...);
+        }
+
+    public:
+        explicit columns_row(field_ref<Ts>... fields) noexcept
+            : _fields(fields...)
+        {}
+
+        // a mutable row passes for a read-only one.
+        template<bool other_const>
+            requires (is_const && !other_const)
+        columns_row(const columns_row<other_const, Ts...>& other) noexcept
+            : _fields(std::apply([](auto&... fields) { return std::tuple<field_ref<Ts>...>(fields...); }, other._fields))
+        {}
+
+        columns_row(const columns_row&) noexcept = default;
+
+        template<size_t I>
+        decltype(auto) get() const noexcept {
+            return std::get<I>(_fields);
+        }
+
+        // fills every field from a whole value.
+        const columns_row& operator=(const columns<Ts...>& value) const
+            requires (!is_const)
+        {
+            assign(static_cast<const std::tuple<Ts...>&>(value), std::index_sequence_for<Ts...>());
+            return *this;
+        }
+
+        const columns_row& operator=(columns<Ts...>&& value) const
+            requires (!is_const)
+        {
+            assign(static_cast<std::tuple<Ts...>&&>(value), std::index_sequence_for<Ts...>());
+            return *this;
+        }
+
+        // copies the other row's fields. other may be this very row, which is then a no-op.
+        const columns_row& operator=(const columns_row& other) const
+            requires (!is_const)
+        {
+            assign(other._fields, std::index_sequence_for<Ts...>());
+            return *this;
+        }
+
+        std::tuple<Ts...> copy_out() const {
+            return std::apply([](const auto&... fields) { return std::tuple<Ts...>(fields...); }, _fields);
+        }
+
+        template<bool, class...>
+        friend class columns_row;
+};
+
+template<size_t I, bool is_const, class... Ts>
+decltype(auto) get(const columns_row<is_const, Ts...>& row) noexcept {
+    return row.template get<I>();
+}
+
+template<bool is_const, class... Ts>
+struct std::tuple_size<columns_row<is_const, Ts...>> : std::integral_constant<size_t, sizeof...(Ts)> {};
+
+template<size_t I, bool is_const, class... Ts>
+struct std::tuple_element<I, columns_row<is_const, Ts...>> {
+    using type = std::conditional_t<is_const,
+        const std::tuple_element_t<I, std::tuple<Ts...>>&,
+        std::tuple_element_t<I, std::tuple<Ts...>>&
+    >;
+};
+
+/**
+ * discrete_map's value storage for columns<Ts...>: one column per field, all the same length.
+ *
+ * Offers the part of column's interface the map uses, with columns_row standing in for T&. field<I>() is the column of one field, for scans and bulk kernels that only need that field.
+ */
+template<class Alloc, class... Ts>
+class column_group {
+    public:
+        using value_type = columns<Ts...>;
+        using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = columns_row<false, Ts...>;
+        using const_reference = columns_row<true, Ts...>;
+
+        template<class T>
+        using field_column_type = column<T, typename std::allocator_traits<Alloc>::template rebind_alloc<T>>;
+
+    private:
+        using index_sequence = std::index_sequence_for<Ts...>;
+
+        std::tuple<field_column_type<Ts>...> _columns;
+
+        template<class Callable>
+        void each_column(Callable&& f) {
+            std::apply([&f](auto&... c) { (f(c), ...); }, _columns);
+        }
+
+        template<size_t... I>
+        reference row(size_type i, std::index_sequence<I...>) noexcept {
+            return reference(std::get<I>(_columns)[i]...);
+        }
+
+        template<size_t... I>
+        const_reference row(size_type i, std::index_sequence<I...>) const noexcept {
+            return const_reference(std::get<I>(_columns)[i]...);
+        }
+
+        // appends every field, or none: a field that throws takes the ones before it back off.
+        template<class Tuple, size_t... I>
+        void append(Tuple&& value, std::index_sequence<I...>) {
+            size_type pushed = 0;
+            try {
+                ((std::get<I>(_columns).emplace_back(std::get<I>(std::forward<Tuple>(value))), ++pushed), ...);
+            }
+            catch (...) {
+                size_type column_index = 0;
+                each_column([&](auto& c) {
+                    if (column_index++ < pushed) {
+                        c.pop_back();
+                    }
+                });
+                throw;
+            }
+        }
+
+        template<bool is_const>
+        class row_iterator {
+            private:
+                using group_type = std::conditional_t<is_const, const column_group, column_group>;
+
+                group_type* _group = nullptr;
+                size_type _index = 0;
+
+            public:
+                using iterator_category = std::random_access_iterator_tag;
+                using value_type = columns<Ts...>;
+                using difference_type = std::ptrdiff_t;
+                using reference = std::conditional_t<is_const, const_reference, typename column_group::reference>;
+
+                row_iterator() = default;
+
+                row_iterator(group_type& group, size_type i) noexcept
+                    : _group(&group),
+                      _index(i)
+                {}
+
+                operator row_iterator<true>() const noexcept {
+                    return row_iterator<true>(*_group, _index);
+                }
+
+                reference operator*() const noexcept {
+                    return (*_group)[_index];
+                }
+
+                size_type index() const noexcept {
+                    return _index;
+                }
+
+                row_iterator& operator++() noexcept {
+                    ++_index;
+                    return *this;
+                }
+
+                row_iterator operator++(int) noexcept {
+                    row_iterator temp = *this;
+                    ++_index;
+                    return temp;
+                }
+
+                row_iterator& operator--() noexcept {
+                    --_index;
+                    return *this;
+                }
+
+                row_iterator operator--(int) noexcept {
+                    row_iterator temp = *this;
+                    --_index;
+                    return temp;
+                }
+
+                row_iterator operator+(difference_type n) const noexcept {
+                    return row_iterator(*_group, static_cast<size_type>(static_cast<difference_type>(_index) + n));
+                }
+
+                row_iterator operator-(difference_type n) const noexcept {
+                    return *this + (-n);
+                }
+
+                difference_type operator-(const row_iterator& other) const noexcept {
+                    return static_cast<difference_type>(_index) - static_cast<difference_type>(other._index);
+                }
+
+                bool operator==(const row_iterator& other) const noexcept {
+                    return _index == other._index;
+                }
+
+                auto operator<=>(const row_iterator& other) const noexcept {
+                    return _index <=> other._index;
+                }
+        };
+
+    public:
+        using iterator = row_iterator<false>;
+        using const_iterator = row_iterator<true>;
+
+//construct/copy/destroy
+
+        column_group() = default;
+
+        explicit column_group(const allocator_type& alloc)
+            : _columns(field_column_type<Ts>(typename field_column_type<Ts>::allocator_type(alloc))...)
+        {}
+
+        allocator_type get_allocator() const noexcept {
+            return allocator_type(std::get<0>(_columns).get_allocator());
+        }
+
+//getters
+
+        template<size_t I>
+        const auto& field() const noexcept {
+            return std::get<I>(_columns);
+        }
+
+        template<size_t I>
+        std::span<std::tuple_element_t<I, std::tuple<Ts...>>> field_span() noexcept {
+            return {std::get<I>(_columns).data(), size()};
+        }
+
+        template<size_t I>
+        std::span<const std::tuple_element_t<I, std::tuple<Ts...>>> field_span() const noexcept {
+            return {std::get<I>(_columns).data(), size()};
+        }
+
+//iterators
+
+        iterator begin() noexcept {
+            return iterator(*this, 0);
+        }
+
+        const_iterator begin() const noexcept {
+            return const_iterator(*this, 0);
+        }
+
+        iterator end() noexcept {
+            return iterator(*this, size());
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(*this, size());
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+
+//capacity
+
+        [[nodiscard]] bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type size() const noexcept {
+            return std::get<0>(_columns).size();
+        }
+
+        // all the columns grow together, so any one of them has the group's capacity.
+        size_type capacity() const noexcept {
+            return std::get<0>(_columns).capacity();
+        }
+
+        void reserve(size_type n) {
+            each_column([n](auto& c) { c.reserve(n); });
+        }
+
+        // bytes one element takes across all the columns. less than sizeof(columns<Ts...>), which pads between fields.
+        static constexpr size_type element_bytes = (sizeof(Ts) + ...);
+
+        // what the fields own out of line, walking only the columns whose type owns anything.
+        size_type heap_bytes() const noexcept {
+            size_type bytes = 0;
+            std::apply([&bytes](const auto&... c) {
+                ([&bytes](const auto& col) {
+                    using field_type = typename std::remove_cvref_t<decltype(col)>::value_type;
+                    if constexpr (!heap_usage<field_type>::is_trivial) {
+                        for (const field_type& f : col) {
+                            bytes += heap_usage<field_type>::bytes(f);
+                        }
+                    }
+                }(c), ...);
+            }, _columns);
+            return bytes;
+        }
+
+//element access
+
+        reference operator[](size_type i) noexcept {
+            return row(i, index_sequence());
+        }
+
+        const_reference operator[](size_type i) const noexcept {
+            return row(i, index_sequence());
+        }
+
+        const_reference at(size_type i) const {
+            if (i >= size()) {
+                throw std::out_of_range("column_group::at() const thrown exception: index out of range.");
+            }
+            return (*this)[i];
+        }
+
+        reference at(size_type i) {
+            if (i >= size()) {
+                throw std::out_of_range("column_group::at() thrown exception: index out of range.");
+            }
+            return (*this)[i];
+        }
+
+        reference back() noexcept {
+            return (*this)[size() - 1];
+        }
+
+        const_reference back() const noexcept {
+            return (*this)[size() - 1];
+        }
+
+//modifiers
+
+        reference emplace_back(const value_type& value) {
+            append(static_cast<const std::tuple<Ts...>&>(value), index_sequence());
+            return back();
+        }
+
+        reference emplace_back(value_type&& value) {
+            append(static_cast<std::tuple<Ts...>&&>(value), index_sequence());
+            return back();
+        }
+
+        void push_back(const value_type& value) {
+            emplace_back(value);
+        }
+
+        void push_back(value_type&& value) {
+            emplace_back(std::move(value));
+        }
+
+        void pop_back() noexcept {
+            each_column([](auto& c) { c.pop_back(); });
+        }
+
+        iterator erase(const_iterator first, const_iterator last) {
+            each_column([&first, &last](auto& c) {
+                c.erase(c.begin() + first.index(), c.begin() + last.index());
+            });
+            return begin() + static_cast<difference_type>(first.index());
+        }
+
+        void erase_by_swap(size_type i) {
+            each_column([i](auto& c) { c.erase_by_swap(i); });
+        }
+
+        void clear() noexcept {
+            each_column([](auto& c) { c.clear(); });
+        }
+
+        void swap(column_group& other) noexcept {
+            std::apply([&other](auto&... c) {
+                std::apply([&c...](auto&... o) { (c.swap(o), ...); }, other._columns);
+            }, _columns);
+        }
+
+        friend bool operator==(const column_group& lhs, const column_group& rhs) {
+            return lhs._columns == rhs._columns;
+        }
+};
+
+template<class Alloc, class... Ts>
+struct value_storage<columns<Ts...>, Alloc> {
+    using type = column_group<Alloc, Ts...>;
+};
+
+#endif
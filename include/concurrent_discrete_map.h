@@ -0,0 +1,344 @@
+#ifndef CONCURRENT_DISCRETE_MAP_H
+#define CONCURRENT_DISCRETE_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "discrete_map.h"
+
+/**
+ * picks a shard from the raw output of a hash function.
+ *
+ * The shards' own GrowthPolicy masks off the low bits of the same hash, so the shard has to come from the high bits of a multiplicative mix. Otherwise every key in a shard would share its low bits and pile up in a fraction of that shard's table.
+ *
+ * @arg raw_hash_val output of hash function
+ * @arg shard_bits log2 of the number of shards
+ */
+inline size_t shard_index(size_t raw_hash_val, unsigned shard_bits) noexcept {
+    if (shard_bits == 0) {
+        return 0;
+    }
+    const std::uint64_t mixed = static_cast<std::uint64_t>(raw_hash_val) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(mixed >> (64 - shard_bits));
+}
+
+/**
+ * discrete_map split into independently locked shards.
+ *
+ * Every key belongs to exactly one shard, each of which is a plain discrete_map behind its own reader-writer lock. Lookups never hand out references into a shard (they'd outlive the lock), so reads return copies and in-place updates go through visit().
+ *
+ * The range overloads group their input by shard first so each shard's lock is taken once per call rather than once per key.
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class KeyAllocator = std::allocator<Key>,
+         class ValueAllocator = std::allocator<T>,
+         class Growth = BitwiseGrowthPolicy,
+         template<class> class Probe = linear_prober>
+class concurrent_discrete_map {
+    public:
+        using map_type = discrete_map<Key, T, Hash, Pred, KeyAllocator, ValueAllocator, Growth, Probe>;
+
+        using key_type = typename map_type::key_type;
+        using mapped_type = typename map_type::mapped_type;
+        using value_type = typename map_type::value_type;
+        using hasher = typename map_type::hasher;
+        using key_equal = typename map_type::key_equal;
+        using size_type = typename map_type::size_type;
+
+    private:
+        // one cache line per shard so neighbouring locks don't false-share.
+        struct alignas(64) shard {
+            mutable std::shared_mutex mutex;
+            map_type map;
+        };
+
+        std::unique_ptr<shard[]> _shards;
+        size_type _shard_count;
+        unsigned _shard_bits;
+
+        static size_type default_shard_count() noexcept {
+            size_type n = 1;
+            const size_type threads = std::max(1u, std::thread::hardware_concurrency());
+            // a few more shards than threads keeps the odds of two writers meeting low.
+            while (n < threads * 4) {
+                n <<= 1;
+            }
+            return n;
+        }
+
+        size_type shard_of(const key_type& k) const {
+            return shard_index(hasher()(k), _shard_bits);
+        }
+
+        /**
+         * stable counting sort of [0, n) by shard.
+         *
+         * @return positions ordered by shard, and _shard_count + 1 offsets delimiting each shard's run
+         */
+        template<class ShardOf>
+        std::pair<std::vector<size_type>, std::vector<size_type>> group_by_shard(size_type n, ShardOf&& shard_of_position) const {
+            std::vector<size_type> shards(n);
+            std::vector<size_type> offsets(_shard_count + 1, 0);
+
+            for (size_type i = 0; i < n; ++i) {
+                shards[i] = shard_of_position(i);
+                ++offsets[shards[i] + 1];
+            }
+            for (size_type s = 0; s < _shard_count; ++s) {
+                offsets[s + 1] += offsets[s];
+            }
+
+            std::vector<size_type> order(n);
+            std::vector<size_type> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_type i = 0; i < n; ++i) {
+                order[cursor[shards[i]]++] = i;
+            }
+
+            return {std::move(order), std::move(offsets)};
+        }
+
+    public:
+//construct/copy/destroy
+
+        /**
+         * @arg shard_count number of shards. Must be a power of two; defaults to a few per hardware thread.
+         */
+        explicit concurrent_discrete_map(size_type shard_count = default_shard_count())
+            : _shards(),
+              _shard_count(shard_count),
+              _shard_bits(0)
+        {
+            if (shard_count == 0 || (shard_count & (shard_count - 1)) != 0) {
+                throw std::invalid_argument("concurrent_discrete_map: shard count must be a non-zero power of two.");
+            }
+            while ((size_type{1} << _shard_bits) < shard_count) {
+                ++_shard_bits;
+            }
+            _shards.reset(new shard[shard_count]);
+        }
+
+        // locks can't be copied or moved, and a copy of a concurrently mutated map wouldn't mean much anyway.
+        concurrent_discrete_map(const concurrent_discrete_map&) = delete;
+        concurrent_discrete_map& operator=(const concurrent_discrete_map&) = delete;
+
+        ~concurrent_discrete_map() = default;
+
+//capacity
+
+        size_type shard_count() const noexcept {
+            return _shard_count;
+        }
+
+        /**
+         * sum of the shard sizes. Shards are read one after the other, so this isn't a snapshot if writers are active.
+         */
+        size_type size() const {
+            size_type total = 0;
+            for (size_type s = 0; s < _shard_count; ++s) {
+                std::shared_lock lock(_shards[s].mutex);
+                total += _shards[s].map.size();
+            }
+            return total;
+        }
+
+        [[nodiscard]] bool empty() const {
+            return size() == 0;
+        }
+
+//modifiers
+
+        bool insert(const value_type& obj) {
+            shard& sh = _shards[shard_of(obj.first)];
+            std::unique_lock lock(sh.mutex);
+            return sh.map.insert(obj).second;
+        }
+
+        /**
+         * @return true if the key was newly inserted, false if an existing value was overwritten.
+         */
+        template<class M>
+        bool insert_or_assign(const key_type& k, M&& obj) {
+            shard& sh = _shards[shard_of(k)];
+            std::unique_lock lock(sh.mutex);
+            // only one of the two runs, so forwarding obj into both is fine.
+            return sh.map.upsert(k,
+                [&obj]{ return mapped_type(std::forward<M>(obj)); },
+                [&obj](mapped_type& v){ v = std::forward<M>(obj); }
+            );
+        }
+
+        /**
+         * discrete_map::upsert() under the shard's exclusive lock.
+         *
+         * @return true if the key was inserted, false if the existing value was updated.
+         */
+        template<class MakeValue, class UpdateValue>
+        bool upsert(const key_type& k, MakeValue&& make_value, UpdateValue&& update_value) {
+            shard& sh = _shards[shard_of(k)];
+            std::unique_lock lock(sh.mutex);
+            return sh.map.upsert(k, std::forward<MakeValue>(make_value), std::forward<UpdateValue>(update_value));
+        }
+
+        bool erase(const key_type& k) {
+            shard& sh = _shards[shard_of(k)];
+            std::unique_lock lock(sh.mutex);
+            return sh.map.erase(k);
+        }
+
+        void clear() {
+            for (size_type s = 0; s < _shard_count; ++s) {
+                std::unique_lock lock(_shards[s].mutex);
+                _shards[s].map.clear();
+            }
+        }
+
+        /**
+         * inserts every pair in [first, last), taking each shard's lock once.
+         *
+         * @return number of pairs actually inserted
+         */
+        template<class InputIterator>
+        size_type insert(InputIterator first, InputIterator last) {
+            const std::vector<value_type> batch(first, last);
+
+            const auto [order, offsets] = group_by_shard(batch.size(), [this, &batch](size_type i) {
+                return shard_of(batch[i].first);
+            });
+
+            size_type inserted = 0;
+            for (size_type s = 0; s < _shard_count; ++s) {
+                if (offsets[s] == offsets[s + 1]) {
+                    continue;
+                }
+                std::unique_lock lock(_shards[s].mutex);
+                for (size_type j = offsets[s]; j < offsets[s + 1]; ++j) {
+                    inserted += _shards[s].map.insert(batch[order[j]]).second ? 1 : 0;
+                }
+            }
+            return inserted;
+        }
+
+        /**
+         * erases every key in [first, last), taking each shard's lock once.
+         *
+         * @return number of keys actually erased
+         */
+        template<class InputIterator>
+        size_type erase(InputIterator first, InputIterator last) {
+            const std::vector<key_type> batch(first, last);
+
+            const auto [order, offsets] = group_by_shard(batch.size(), [this, &batch](size_type i) {
+                return shard_of(batch[i]);
+            });
+
+            size_type erased = 0;
+            for (size_type s = 0; s < _shard_count; ++s) {
+                if (offsets[s] == offsets[s + 1]) {
+                    continue;
+                }
+                std::unique_lock lock(_shards[s].mutex);
+                for (size_type j = offsets[s]; j < offsets[s + 1]; ++j) {
+                    erased += _shards[s].map.erase(batch[order[j]]) ? 1 : 0;
+                }
+            }
+            return erased;
+        }
+
+//map operations
+
+        std::optional<mapped_type> find(const key_type& k) const {
+            const shard& sh = _shards[shard_of(k)];
+            std::shared_lock lock(sh.mutex);
+            const map_type& map = sh.map;
+            const auto it = map.find(k);
+            if (it == map.end()) {
+                return std::nullopt;
+            }
+            return (*it).second;
+        }
+
+        bool contains(const key_type& k) const {
+            const shard& sh = _shards[shard_of(k)];
+            std::shared_lock lock(sh.mutex);
+            return sh.map.contains(k);
+        }
+
+        /**
+         * looks up every key in [first, last) and writes one std::optional<mapped_type> per key to `out`, in input order.
+         */
+        template<class InputIterator, class OutputIterator>
+        OutputIterator find(InputIterator first, InputIterator last, OutputIterator out) const {
+            const std::vector<key_type> batch(first, last);
+            std::vector<std::optional<mapped_type>> results(batch.size());
+
+            const auto [order, offsets] = group_by_shard(batch.size(), [this, &batch](size_type i) {
+                return shard_of(batch[i]);
+            });
+
+            for (size_type s = 0; s < _shard_count; ++s) {
+                if (offsets[s] == offsets[s + 1]) {
+                    continue;
+                }
+                std::shared_lock lock(_shards[s].mutex);
+                const map_type& map = _shards[s].map;
+                for (size_type j = offsets[s]; j < offsets[s + 1]; ++j) {
+                    const auto it = map.find(batch[order[j]]);
+                    if (it != map.end()) {
+                        results[order[j]] = (*it).second;
+                    }
+                }
+            }
+
+            return std::move(results.begin(), results.end(), out);
+        }
+
+        /**
+         * runs `f(value)` on the element for `k` under the shard's exclusive lock.
+         *
+         * @return false if the key isn't present, in which case `f` isn't called.
+         */
+        template<class Callable>
+        bool visit(const key_type& k, Callable&& f) {
+            shard& sh = _shards[shard_of(k)];
+            std::unique_lock lock(sh.mutex);
+            return sh.map.visit(k, std::forward<Callable>(f));
+        }
+
+        // read-only visit under the shard's shared lock.
+        template<class Callable>
+        bool visit(const key_type& k, Callable&& f) const {
+            const shard& sh = _shards[shard_of(k)];
+            std::shared_lock lock(sh.mutex);
+            return sh.map.visit(k, std::forward<Callable>(f));
+        }
+
+        /**
+         * calls `f(key, value)` for every element, one shard at a time under that shard's shared lock.
+         */
+        template<class Callable>
+        void for_each(Callable&& f) const {
+            for (size_type s = 0; s < _shard_count; ++s) {
+                std::shared_lock lock(_shards[s].mutex);
+                const map_type& map = _shards[s].map;
+                for (size_type i = 0; i < map.size(); ++i) {
+                    f(map.keys()[i], map.values()[i]);
+                }
+            }
+        }
+};
+
+#endif
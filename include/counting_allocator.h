@@ -0,0 +1,103 @@
+#ifndef COUNTING_ALLOCATOR_H
+#define COUNTING_ALLOCATOR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/**
+ * running totals shared by every copy (and rebind) of one counting_allocator.
+ */
+struct allocation_counters {
+    std::atomic<size_t> live_bytes{0};
+    std::atomic<size_t> peak_bytes{0};
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> deallocations{0};
+
+    void on_allocate(size_t bytes) noexcept {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        const size_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peak_bytes.load(std::memory_order_relaxed);
+        while (peak < live && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    void on_deallocate(size_t bytes) noexcept {
+        deallocations.fetch_add(1, std::memory_order_relaxed);
+        live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * allocator adapter that forwards to Base and keeps count in a shared allocation_counters.
+ *
+ * Use it as KeyAllocator and/or ValueAllocator. Hand the same counters to both to get the map's total, or separate ones for a per-column split:
+ *
+ *   auto counters = std::make_shared<allocation_counters>();
+ *   discrete_map<K, V, std::hash<K>, std::equal_to<K>, counting_allocator<K>, counting_allocator<V>> map(0, {}, {}, counting_allocator<K>(counters), counting_allocator<V>(counters));
+ *
+ * A default-constructed one starts its own counters, reachable through counters().
+ */
+template<class T, class Base = std::allocator<T>>
+class counting_allocator {
+    private:
+        using base_traits = std::allocator_traits<Base>;
+
+        template<class, class>
+        friend class counting_allocator;
+
+        [[no_unique_address]] Base _base;
+        std::shared_ptr<allocation_counters> _counters;
+
+    public:
+        using value_type = T;
+        using size_type = typename base_traits::size_type;
+        using difference_type = typename base_traits::difference_type;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        template<class U>
+        struct rebind {
+            using other = counting_allocator<U, typename base_traits::template rebind_alloc<U>>;
+        };
+
+        counting_allocator()
+            : _base(),
+              _counters(std::make_shared<allocation_counters>())
+        {}
+
+        explicit counting_allocator(std::shared_ptr<allocation_counters> counters, const Base& base = Base())
+            : _base(base),
+              _counters(std::move(counters))
+        {}
+
+        template<class U, class OtherBase>
+        counting_allocator(const counting_allocator<U, OtherBase>& other)
+            : _base(other._base),
+              _counters(other._counters)
+        {}
+
+        T* allocate(size_type n) {
+            T* p = base_traits::allocate(_base, n);
+            _counters->on_allocate(n * sizeof(T));
+            return p;
+        }
+
+        void deallocate(T* p, size_type n) noexcept {
+            _counters->on_deallocate(n * sizeof(T));
+            base_traits::deallocate(_base, p, n);
+        }
+
+        const std::shared_ptr<allocation_counters>& counters() const noexcept {
+            return _counters;
+        }
+
+        template<class U, class OtherBase>
+        bool operator==(const counting_allocator<U, OtherBase>& other) const noexcept {
+            return _counters == other._counters && _base == other._base;
+        }
+};
+
+#endif
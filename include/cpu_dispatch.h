@@ -0,0 +1,120 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+/**
+ * which SIMD kernels discrete_map and friends may use, detected from the CPU once per process.
+ *
+ * SSE2 is part of x86-64, so the kernels that need nothing more are compiled in directly (DISCRETE_MAP_HAS_SSE2). Wider kernels are compiled for their own target whatever the build flags (DISCRETE_MAP_TARGET_AVX2), and the caller picks one through active_simd_level() and keeps it in a function pointer. One binary then runs the best kernel each host has. AVX-512 is detected too, so a kernel can tell it apart, but nothing needs more than AVX2 so far.
+ *
+ * DISCRETE_MAP_SIMD_LEVEL caps the level, e.g. to test the scalar or AVX2 paths on a host that has AVX-512. CMake sets it from the option of the same name; it's a cap, so asking for more than the CPU has gets what the CPU has.
+ */
+enum class simd_level : int {
+    scalar = 0,
+    sse2 = 1,
+    avx2 = 2,
+    avx512 = 3,
+};
+
+#ifndef DISCRETE_MAP_SIMD_LEVEL
+#define DISCRETE_MAP_SIMD_LEVEL 3
+#endif
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && DISCRETE_MAP_SIMD_LEVEL >= 1
+#define DISCRETE_MAP_HAS_SSE2 1
+#endif
+
+// the dispatched kernels assume 64-bit x86 and a compiler that can target an instruction set per function.
+#if (defined(__x86_64__) || defined(_M_X64)) && DISCRETE_MAP_SIMD_LEVEL >= 2
+#define DISCRETE_MAP_DISPATCH_X86 1
+#if defined(__GNUC__) || defined(__clang__)
+#define DISCRETE_MAP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+// MSVC emits any intrinsic without being asked.
+#define DISCRETE_MAP_TARGET_AVX2
+#endif
+#endif
+
+constexpr const char* simd_level_name(simd_level level) noexcept {
+    switch (level) {
+        case simd_level::sse2:
+            return "sse2";
+        case simd_level::avx2:
+            return "avx2";
+        case simd_level::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+// what the CPU and the OS together support, ignoring DISCRETE_MAP_SIMD_LEVEL.
+inline simd_level detect_simd_level() noexcept {
+#if defined(__x86_64__) || defined(_M_X64)
+    unsigned int regs[4] = {0, 0, 0, 0};
+    const auto cpuid = [&regs](unsigned int leaf) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int out[4];
+        __cpuidex(out, static_cast<int>(leaf), 0);
+        for (int i = 0; i < 4; ++i) {
+            regs[i] = static_cast<unsigned int>(out[i]);
+        }
+#else
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    };
+    // register state the OS saves on a context switch. a CPU with AVX is no use if its upper halves get lost.
+    const auto enabled_state = []() -> unsigned long long {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return _xgetbv(0);
+#else
+        unsigned int lo = 0;
+        unsigned int hi = 0;
+        __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    };
+
+    cpuid(0);
+    const unsigned int max_leaf = regs[0];
+
+    cpuid(1);
+    const bool osxsave = (regs[2] & (1u << 27)) != 0;
+    const bool avx = (regs[2] & (1u << 28)) != 0;
+    simd_level level = simd_level::sse2;
+    if (!osxsave || !avx || max_leaf < 7) {
+        return level;
+    }
+
+    const unsigned long long state = enabled_state();
+    cpuid(7);
+    // XMM and YMM state.
+    if ((state & 0x6) == 0x6 && (regs[1] & (1u << 5)) != 0) {
+        level = simd_level::avx2;
+        // opmask and both halves of ZMM state, and AVX512F.
+        if ((state & 0xE6) == 0xE6 && (regs[1] & (1u << 16)) != 0) {
+            level = simd_level::avx512;
+        }
+    }
+    return level;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+// the level kernels should use: what detect_simd_level() found, capped by DISCRETE_MAP_SIMD_LEVEL. detected on first call.
+inline simd_level active_simd_level() noexcept {
+    static const simd_level level = std::min(detect_simd_level(), static_cast<simd_level>(DISCRETE_MAP_SIMD_LEVEL));
+    return level;
+}
+
+#endif
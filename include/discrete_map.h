@@ -4,6 +4,7 @@
 //see https://www.open-std.org/jtc1/sc22/wg21/docs/papers/2023/n4950.pdf
 //§ 24.5.4.1
 
+#include <algorithm>
 #include <stdexcept>
 #include <string>
 #include <type_traits>
@@ -14,33 +15,55 @@
 #include <utility>
 #include <vector>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <optional>
 #include <expected>
 #include <memory>
+#include <span>
 #include <functional>
+#include <istream>
+#include <limits>
+#include <ostream>
 
+#include "batch_probe.h"
 #include "BitwiseGrowthPolicy.h"
+#include "column.h"
+#include "columns.h"
 #include "GrowthPolicy.h"
 #include "HashPolicy.h"
+#include "index_storage.h"
 #include "linear_prober.h"
+#include "memory_usage.h"
+#include "snapshot.h"
+#include "StatsPolicy.h"
+#include "thread_pool.h"
 
 #define __STATIC_CAST_K_TO_REAL(k) static_cast<const key_type&>(k)
 #define __IGNORE_CONST_QUALIF(type, method, ...) const_cast<type>(static_cast<const this_type&>(*this).method(__VA_ARGS__))
 
+template<class, class, class, class, class, class, class, template<class> class>
+class optimistic_discrete_map;
+
 template<class Key,
          class T,
          class Hash = std::hash<Key>,
          class Pred = std::equal_to<Key>,
-         class KeyAllocator = std::allocator<const Key>,
+         class KeyAllocator = std::allocator<Key>,
          class ValueAllocator = std::allocator<T>,
          class Growth = BitwiseGrowthPolicy,
-         template<class> class Probe = linear_prober>
+         template<class> class Probe = linear_prober,
+         class Stats = NullStatsPolicy,
+         template<class> class IndexStorage = heap_index_storage,
+         class IndexSlots = plain_index_slots>
 class discrete_map {
     private:
         template<class Size>
         struct SizeTraits {
             using size_type = Size;
-            using indices_type = std::optional<size_type>;
+            // keyed_index_slots copies small integer-like keys into the slots, so a probe never has to visit the key column.
+            using indices_type = typename IndexSlots::template slot<size_type, Key, Pred>;
+            using indices_collection_type = IndexStorage<indices_type>;
         };
         using size_traits = SizeTraits<size_t>;
 
@@ -64,8 +87,17 @@ class discrete_map {
         //using const_reference = const value_type&;
         using size_type = typename size_traits::size_type;
 
-        using key_collection_type = std::vector<key_type, key_allocator_type>;
-        using value_collection_type = std::vector<mapped_type, value_allocator_type>;
+        // what find_many() reports for a key that isn't in the map.
+        static constexpr size_type npos = static_cast<size_type>(-1);
+
+        // relocates trivially relocatable keys and values with memcpy rather than element by element. see column.h.
+        using key_collection_type = column<key_type, key_allocator_type>;
+        // columns<A, B, C> values get a column per field instead; see columns.h.
+        using value_collection_type = typename value_storage<mapped_type, value_allocator_type>::type;
+
+        // what element access hands out: mapped_type& normally, a columns_row proxy for columns<...> values.
+        using mapped_reference = typename value_collection_type::reference;
+        using const_mapped_reference = typename value_collection_type::const_reference;
 
         using key_iterator = typename key_collection_type::iterator;
         using key_const_iterator = typename key_collection_type::const_iterator;
@@ -73,31 +105,170 @@ class discrete_map {
     private:
         using indices_type = typename size_traits::indices_type;
 
+        // bytes a value takes in its column(s). a column_group leaves out the padding sizeof(columns<...>) would count.
+        static constexpr size_type value_bytes = [] {
+            if constexpr (requires { value_collection_type::element_bytes; }) {
+                return value_collection_type::element_bytes;
+            }
+            else {
+                return sizeof(mapped_type);
+            }
+        }();
+
+        // snapshots write one value column; a column_group would need a section per field.
+        static constexpr bool single_value_column = std::is_same_v<value_collection_type, column<mapped_type, value_allocator_type>>;
+
+    public:
+        // one slot of the index table, exactly as save() writes it. whoever reads a snapshot in place needs the same layout.
+        using index_slot_type = indices_type;
+
+    private:
         using growth_policy_type = Growth;
-        using hash_policy_type = HashPolicy<Probe, size_traits>;
+        using hash_policy_type = HashPolicy<Probe, size_traits, Stats>;
+
+        // find_many() hands groups of keys to a batch_probe.h kernel only when the slots, the hash and the indexing are exactly what it assumes.
+        static constexpr bool batch_probe_simd =
+#ifdef DISCRETE_MAP_DISPATCH_X86
+            std::is_integral_v<key_type> && (sizeof(key_type) == 4 || sizeof(key_type) == 8)
+            && std::is_same_v<hasher, std::hash<key_type>> && batch_probe_identity_hash
+            && std::is_same_v<growth_policy_type, BitwiseGrowthPolicy>
+            && std::is_same_v<hash_policy_type, HashPolicy<linear_prober, size_traits, Stats>>
+            // the keys have to be in the slots for the gather to reach them, i.e. keyed_index_slots.
+            && std::is_same_v<indices_type, keyed_index_slot<size_type, key_type>>
+            && sizeof(size_type) == 8
+            // the kernel doesn't record probes.
+            && !Stats::enabled;
+#else
+            false;
+#endif
 
-        using this_type = discrete_map<key_type, mapped_type, hasher, key_equal, key_allocator_type, value_allocator_type, growth_policy_type, Probe>;
+        using this_type = discrete_map<key_type, mapped_type, hasher, key_equal, key_allocator_type, value_allocator_type, growth_policy_type, Probe, Stats, IndexStorage, IndexSlots>;
 
         key_collection_type _keys;
         value_collection_type _values;
 
-        GrowthPolicy<growth_policy_type> _growth_pol;
+        // the policy itself, not its CRTP base: a layout_growth_policy carries state that slicing would lose.
+        growth_policy_type _growth_pol;
         hash_policy_type _hash_pol;
 
+        // its readers run probe_find() directly against a table that a writer may be changing underneath them.
+        template<class, class, class, class, class, class, class, template<class> class>
+        friend class optimistic_discrete_map;
+
         //methods
+
+        // where element `existing_key_index` belongs in a table of `capacity` slots, and the slot that points at it.
+        std::pair<size_type, indices_type> placement(size_type capacity, size_type existing_key_index) const {
+            const size_t hash = hash_function()(_keys[existing_key_index]);
+            return {
+                _growth_pol.get_index(capacity, hash),
+                indices_type(existing_key_index, indices_type::fingerprint_of(_keys[existing_key_index], hash))
+            };
+        }
+
+        // true while the growth policy puts every element in its home slot (DirectAddressGrowthPolicy), so nothing is ever displaced.
+        bool direct_addressed() const noexcept {
+            if constexpr (layout_growth_policy<growth_policy_type>) {
+                return _growth_pol.is_direct();
+            }
+            else {
+                return false;
+            }
+        }
+
+        /**
+         * lets a layout_growth_policy choose its layout for the keys in the map, plus one more hash if given, and rebuilds the index to match. Never shrinks the table.
+         */
+        void relayout(const size_t* incoming = nullptr) requires layout_growth_policy<growth_policy_type> {
+            const hasher hf = hash_function();
+
+            size_type count = size();
+            size_type lowest = std::numeric_limits<size_type>::max();
+            size_type highest = 0;
+            if (incoming) {
+                lowest = highest = *incoming;
+                ++count;
+            }
+            for (const key_type& k : _keys) {
+                const size_type h = hf(k);
+                lowest = std::min(lowest, h);
+                highest = std::max(highest, h);
+            }
+
+            // what the load factor alone would need.
+            size_type needed = _hash_pol.size();
+            while (static_cast<float>(count) / static_cast<float>(needed) >= _hash_pol.threshold()) {
+                needed = _growth_pol.next_capacity(needed);
+            }
+
+            size_type capacity = _growth_pol.relayout(lowest, highest, count, true, needed);
+            if (_growth_pol.is_direct()) {
+                // a direct slot holds exactly one hash. keys that share one need hashed mode after all.
+                std::vector<bool> seen(highest - lowest + 1, false);
+                bool distinct = true;
+                const auto mark = [&](size_type h) {
+                    distinct = distinct && !seen[h - lowest];
+                    seen[h - lowest] = true;
+                };
+                if (incoming) {
+                    mark(*incoming);
+                }
+                for (size_type i = 0; i < size() && distinct; ++i) {
+                    mark(hf(_keys[i]));
+                }
+                if (!distinct) {
+                    capacity = _growth_pol.relayout(lowest, highest, count, false, needed);
+                }
+            }
+
+            if (capacity > _hash_pol.size()) {
+                rehash(capacity);
+            }
+            else {
+                reindex();
+            }
+        }
+
+        // rebuilds every slot of the index from the key column as it stands now.
+        void reindex() {
+            const size_type capacity = _hash_pol.size();
+            _hash_pol.reindex(size(), [this, capacity](size_type existing_key_index){
+                return placement(capacity, existing_key_index);
+            });
+        }
         
-        const indices_type& probe_find(const key_type& k, bool stop_empty=true) const {
+        // hash must be hash_function()(k). callers that already have it skip hashing twice.
+        const indices_type& probe_find_hashed(const key_type& k, size_t hash, bool stop_empty=true) const {
 
-            const auto does_key_match = [this, k](size_type current_kv_index) {
+            const auto does_key_match = [this, &k](size_type current_kv_index) {
                 return key_eq()(k, _keys[current_kv_index]);
             };
 
             const size_type key_to_index = _growth_pol.get_index(
                 _hash_pol.size(),
-                hash_function()(k)
+                hash
             );
 
-            return _hash_pol.probe(key_to_index, does_key_match, stop_empty);
+            const auto fingerprint = indices_type::fingerprint_of(k, hash);
+
+            // skipped when collecting stats, which only the full probe records.
+            if (!Stats::enabled && direct_addressed() && stop_empty) {
+                // k can only be in its home slot. anything else there means k's hash collides with a stored key's, and the full probe finds the slot for append() to reject.
+                const indices_type& home = _hash_pol.data()[key_to_index];
+                if (!home.has_value() || (home.may_match(fingerprint) && (indices_type::exact_match || does_key_match(home.value())))) {
+                    return home;
+                }
+            }
+
+            return _hash_pol.probe(key_to_index, fingerprint, does_key_match, stop_empty);
+        }
+
+        indices_type& probe_find_hashed(const key_type& k, size_t hash, bool stop_empty=true) {
+            return __IGNORE_CONST_QUALIF(indices_type&, probe_find_hashed, k, hash, stop_empty);
+        }
+
+        const indices_type& probe_find(const key_type& k, bool stop_empty=true) const {
+            return probe_find_hashed(k, hash_function()(k), stop_empty);
         } 
 
         const indices_type& probe_find(key_type&& k, bool stop_empty=true) const {
@@ -112,12 +283,57 @@ class discrete_map {
             return __IGNORE_CONST_QUALIF(indices_type&, probe_find, std::move(k), stop_empty);
         }
 
+        /**
+         * adds k as a new element, with the value make_value() returns, and points the index at it.
+         *
+         * @arg slot the empty slot probe_find_hashed(k, hash) just returned. re-probed here if the table has to grow first.
+         */
+        template<class MakeValue>
+        void append(indices_type* slot, const key_type& k, size_t hash, MakeValue&& make_value) {
+            if (size() >= indices_type::max_elements) {
+                throw std::length_error("discrete_map::insert() thrown exception: index slots can't address any more elements.");
+            }
+
+            // can't use the public interface load_factor() because we're forward looking, which that function isn't.
+            const bool crowded = _hash_pol.load_factor(this->size() + 1) >= _hash_pol.threshold();
+
+            if constexpr (layout_growth_policy<growth_policy_type>) {
+                // growing is a chance to pick the layout again. a hash the layout can't place, out of range or landing away from home, needs a new one anyway.
+                const bool misplaced = !_growth_pol.fits(_hash_pol.size(), hash)
+                    || (direct_addressed() && slot != _hash_pol.data() + _growth_pol.get_index(_hash_pol.size(), hash));
+                if (crowded || misplaced) {
+                    relayout(&hash);
+                    slot = &probe_find_hashed(k, hash);
+                }
+            }
+            else if (crowded) {
+                rehash(
+                    // I want to avoid `+ 1` in case the growth policy is based on primes or power2
+                    _growth_pol.next_capacity(_hash_pol.size())
+                );
+                // the slot we found lived in the old table. probe again in the bigger one.
+                slot = &probe_find_hashed(k, hash);
+            }
+
+            _keys.push_back(k);
+            try {
+                _values.emplace_back(std::forward<MakeValue>(make_value)());
+            }
+            catch (...) {
+                _keys.pop_back();
+                throw;
+            }
+            // only once both columns have the element, so a throw above leaves the index as it was.
+            *slot = indices_type(size() - 1, indices_type::fingerprint_of(k, hash));
+        }
+
         template<bool is_const=true>
         class iterator_impl {
             private:
                 // local polymorphism
                 friend iterator_impl<true>;
                 friend iterator_impl<false>;
+                friend discrete_map;
 
                 using keys_constness_type = typename std::conditional<is_const,
                     const key_collection_type,
@@ -234,58 +450,66 @@ class discrete_map {
         explicit discrete_map
             (
                 size_type n,
-                const hasher& hfn = hasher(),
-                const key_equal& eql = key_equal(),
+                [[maybe_unused]] const hasher& hfn = hasher(),
+                [[maybe_unused]] const key_equal& eql = key_equal(),
                 const key_allocator_type& a1 = key_allocator_type(),
                 const value_allocator_type& a2 = value_allocator_type()
             )
-            : _keys(n, a1),
-              _values(n, a2),
+            : _keys(a1),
+              _values(a2),
               _hash_pol(
                   _growth_pol.min_capacity()
               )
-        {}
+        {
+            // n is how many elements to make room for, not how many to create.
+            reserve(n);
+        }
 
-        template <class InputIterator>
+        template<std::input_iterator InputIterator>
         discrete_map
             (
                 InputIterator first,
                 InputIterator last,
                 size_type n,
-                const hasher& hf = hasher(),
-                const key_equal& eq = key_equal(),
+                [[maybe_unused]] const hasher& hf = hasher(),
+                [[maybe_unused]] const key_equal& eq = key_equal(),
                 const key_allocator_type& a1 = key_allocator_type(),
                 const value_allocator_type& a2 = value_allocator_type()
             )
-            :  _keys(n, a1),
-              _values(n, a2),
+            :  _keys(a1),
+              _values(a2),
               _hash_pol(
                   _growth_pol.min_capacity()
               )
         {
+            reserve(n);
             for (auto it = first; it != last; ++it) {
                 const auto pair = *it;
                 insert(pair);
             }
+            // the layout chosen at the last growth saw only part of the keys.
+            if constexpr (layout_growth_policy<growth_policy_type>) {
+                relayout();
+            }
         }
 
         // Copy constructor
         discrete_map(const discrete_map& other)
-              : _growth_pol(other._growth_pol),
-                _hash_pol(_growth_pol.min_capacity()),
-                _keys(other._keys),
-                _values(other._values)
+              : _keys(other._keys),
+                _values(other._values),
+                _growth_pol(other._growth_pol),
+                _hash_pol(other._hash_pol)
         {}
 
         // Move constructor
         discrete_map(discrete_map&& other)
-              : _growth_pol(std::move(other._growth_pol)),
-                _hash_pol(std::move(_growth_pol.min_capacity())),
-                _keys(std::move(other._keys)),
-                _values(std::move(other._values))
+              : _keys(std::move(other._keys)),
+                _values(std::move(other._values)),
+                _growth_pol(std::move(other._growth_pol)),
+                _hash_pol(std::move(other._hash_pol))
         {}
 
-        explicit discrete_map(const KeyAllocator& a1, const KeyAllocator& a2)
+        explicit discrete_map(const KeyAllocator& a1, const ValueAllocator& a2)
             : discrete_map(0, hasher(), key_equal(), a1, a2)
         {}
 
@@ -302,17 +526,17 @@ class discrete_map {
         {}
 
         discrete_map(size_type n, const hasher& hf, const key_allocator_type& a1, const value_allocator_type& a2)
-            : discrete_map(n, hf(), key_equal(), a1, a2)
+            : discrete_map(n, hf, key_equal(), a1, a2)
         {}
 
-        template<class InputIterator>
+        template<std::input_iterator InputIterator>
         discrete_map(InputIterator f, InputIterator l, size_type n, const key_allocator_type& a1, const value_allocator_type& a2)
             : discrete_map(f, l, n, hasher(), key_equal(), a1, a2)
         {}
 
-        template<class InputIterator>
+        template<std::input_iterator InputIterator>
         discrete_map(InputIterator f, InputIterator l, size_type n, const hasher& hf, const key_allocator_type& a1, const value_allocator_type& a2)
-            : discrete_map(f, l, n, hf, a1, a2)
+            : discrete_map(f, l, n, hf, key_equal(), a1, a2)
         {}
 
         //template<container-compatible-range <value_type> R>
@@ -328,15 +552,9 @@ class discrete_map {
             : discrete_map(il, n, hf, key_equal(), a1, a2)
         {}
 
-        discrete_map& operator=(const discrete_map& other) {
-            discrete_map(std::forward<const discrete_map&>(other));
-            return *this;
-        }
+        discrete_map& operator=(const discrete_map& other) = default;
 
-        discrete_map& operator=(discrete_map&& other) {
-            discrete_map(std::forward<discrete_map&&>(other));
-            return *this;
-        }
+        discrete_map& operator=(discrete_map&& other) = default;
 
         ~discrete_map() = default; // <---------------------- DESTRUCTOR HERE
 
@@ -353,12 +571,31 @@ class discrete_map {
             return _values;
         }
 
+        /**
+         * field I of every value, for maps with columns<...> values. Dense and in the same order as keys().
+         *
+         * The span's elements may be modified in place; the map's structure may not change while it's held.
+         */
+        template<size_t I>
+        auto value_column() noexcept
+            requires requires (value_collection_type& v) { v.template field_span<I>(); }
+        {
+            return _values.template field_span<I>();
+        }
+
+        template<size_t I>
+        auto value_column() const noexcept
+            requires requires (const value_collection_type& v) { v.template field_span<I>(); }
+        {
+            return _values.template field_span<I>();
+        }
+
         key_allocator_type get_key_allocator() const noexcept {
-            return key_allocator_type();
+            return _keys.get_allocator();
         }
 
         value_allocator_type get_value_allocator() const noexcept {
-            return value_allocator_type();
+            return _values.get_allocator();
         }
 
 //capacity
@@ -373,7 +610,36 @@ class discrete_map {
         }
 
         size_type max_size() const noexcept {
-            return static_cast<size_type>(_growth_pol.max_capacity() * _hash_pol.threshold());
+            // the index slots also have to be able to name every element.
+            return std::min<size_type>(static_cast<size_type>(_growth_pol.max_capacity() * _hash_pol.threshold()), indices_type::max_elements);
+        }
+
+        /**
+         * bytes held by each column, the index table and whatever the elements own out of line.
+         *
+         * Constant time unless Key or T specialises heap_usage (std::string does), in which case that column is walked.
+         */
+        memory_usage_report memory_usage() const noexcept {
+            memory_usage_report report;
+            report.keys = _keys.capacity() * sizeof(key_type);
+            report.values = _values.capacity() * value_bytes;
+            report.indices = _hash_pol.memory_bytes();
+            report.slack = (_keys.capacity() - _keys.size()) * sizeof(key_type) + (_values.capacity() - _values.size()) * value_bytes;
+
+            if constexpr (!heap_usage<key_type>::is_trivial) {
+                for (const key_type& k : _keys) {
+                    report.key_heap += heap_usage<key_type>::bytes(k);
+                }
+            }
+            if constexpr (requires { _values.heap_bytes(); }) {
+                report.value_heap = _values.heap_bytes();
+            }
+            else if constexpr (!heap_usage<mapped_type>::is_trivial) {
+                for (const mapped_type& v : _values) {
+                    report.value_heap += heap_usage<mapped_type>::bytes(v);
+                }
+            }
+            return report;
         }
 
 //modifiers
@@ -386,29 +652,28 @@ class discrete_map {
        }
 
        std::pair<iterator, bool> insert(const value_type& obj) {
+           return insert(obj, hash_function()(obj.first));
+       }
+
+       /**
+        * insert with the key's hash already computed, e.g. by an earlier find(k, hash) for the same key.
+        *
+        * @arg hash must be hash_function()(obj.first); anything else files the element where lookups won't find it.
+        */
+       std::pair<iterator, bool> insert(const value_type& obj, size_t hash) {
+           [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::insert);
 
-           indices_type& maybe_index = probe_find(obj.first);
+           indices_type* maybe_index = &probe_find_hashed(obj.first, hash);
 
            // probe_find stops either if the keys match or there was no key. therefore we just check for presence of key, as it's implied to be the key we're searching for.
-           if (maybe_index.has_value()) {
+           if (maybe_index->has_value()) {
                //according to STL this version doesn't update existing keys.
-               return std::make_pair(begin() + maybe_index.value(), false);
+               return std::make_pair(begin() + maybe_index->value(), false);
            }
 
            //handling of where the probe found empty slot. Here we actually do an insert.
+           append(maybe_index, obj.first, hash, [&obj]() -> const mapped_type& { return obj.second; });
 
-           // can't use the public interface load_factor() because we're forward looking, which that function isn't.
-           if (_hash_pol.load_factor(this->size() + 1) >= _hash_pol.threshold()) {
-               rehash(
-                   // I want to avoid `+ 1` in case the growth policy is based on primes or power2
-                   _growth_pol.next_capacity(_hash_pol.size())
-               );
-           }
-
-           maybe_index = size();
-           _keys.push_back(obj.first);
-           _values.push_back(obj.second);
-           
            return {end()-1, true};
        }
 
@@ -417,8 +682,9 @@ class discrete_map {
        //}
 
        template<class P>
+           requires (std::constructible_from<value_type, P&&> && !std::same_as<std::remove_cvref_t<P>, value_type>)
        std::pair<iterator, bool> insert(P&& obj) {
-           return insert(std::forward<P>(obj));
+           return insert(value_type(std::forward<P>(obj)));
        }
 
        iterator insert(const_iterator hint, const value_type& obj) {
@@ -468,14 +734,9 @@ class discrete_map {
 
            value_type kv_pair = *position;
 
-           indices_type& maybe_index = probe_find(kv_pair.first, false);
-
-           // Now do the erasing.
-           // Normally you'd check for empty optional but in this context it's always the value we want.
-           _keys.erase(_keys.begin() + maybe_index.value());
-           _values.erase(_values.begin() + maybe_index.value());
-           maybe_index = std::nullopt;
+           erase(kv_pair.first);
 
+           // the last element was moved into the hole, so the same position is the next one to visit.
            return position;
        }
 
@@ -485,36 +746,59 @@ class discrete_map {
            );
        }
 
-       bool erase(const key_type& k) noexcept {
+       bool erase(const key_type& k) {
+           [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::erase);
 
-           indices_type maybe_index = probe_find(k.first);
+           indices_type& maybe_index = probe_find(k);
 
            //if the probe found that keys match...
-           if (maybe_index.has_value()) {
-               // erasey timey
-               _keys.erase(_keys.begin() + maybe_index.value());
-               _values.erase(_values.begin() + maybe_index.value());
+           if (!maybe_index.has_value()) {
+               return false;
+           }
+
+           const size_type hole = maybe_index.value();
+           const size_type last = size() - 1;
+
+           if (direct_addressed()) {
+               // nothing was displaced past this slot, so there's no cluster to repair.
                maybe_index = std::nullopt;
-               return true;
            }
+           else {
+               // the rest of the cluster has to be re-placed, otherwise lookups would stop early at the freed slot.
+               const size_type capacity = _hash_pol.size();
+               _hash_pol.erase(maybe_index, [this, capacity](size_type existing_key_index){
+                   return placement(capacity, existing_key_index);
+               });
+           }
+
+           // erasey timey. swap the last element into the hole so the columns stay dense without shifting.
+           if (hole != last) {
+               probe_find(_keys[last]).relink(hole);
+           }
+           _keys.erase_by_swap(hole);
+           _values.erase_by_swap(hole);
 
-           return false;
+           return true;
        }
 
        iterator erase(const_iterator first, const_iterator last) {
 
-           //erase until the two iterators are identical.
-           //this works because erase() deletes at the current position and shifts everything beyond the deleted element into its place.
-           //this logic assumes that first doesn't change in erase().
            iterator mut_first = iterator(first);
            iterator mut_last = iterator(last);
 
-           while (mut_first != mut_last) {
-                erase(mut_first);
-               mut_first++;
+           if (mut_first == mut_last) {
+               return mut_first;
            }
-           return mut_first;
 
+           // erasing one by one would keep swapping the tail into the range. shift the columns once and rebuild the index instead.
+           const size_type offset = mut_first._index;
+           const size_type count = mut_last._index - mut_first._index;
+
+           _keys.erase(_keys.begin() + offset, _keys.begin() + offset + count);
+           _values.erase(_values.begin() + offset, _values.begin() + offset + count);
+           reindex();
+
+           return begin() + offset;
        }
 
        value_type extract(const_iterator position) {
@@ -552,7 +836,15 @@ class discrete_map {
 //map operations
 
         iterator find(const key_type& k) {
-            indices_type result = probe_find(k);
+            return find(k, hash_function()(k));
+        }
+
+        /**
+         * @arg hash must be hash_function()(k). Hash once, then find and (if missing) insert with the same value.
+         */
+        iterator find(const key_type& k, size_t hash) {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
+            indices_type result = probe_find_hashed(k, hash);
             if (result.has_value()) {
                 return begin() + result.value();
             }
@@ -568,7 +860,12 @@ class discrete_map {
         }
 
         const_iterator find(const key_type& k) const {
-            indices_type result = probe_find(k);
+            return find(k, hash_function()(k));
+        }
+
+        const_iterator find(const key_type& k, size_t hash) const {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
+            indices_type result = probe_find_hashed(k, hash);
             if (result.has_value()) {
                 return cbegin() + result.value();
             }
@@ -583,24 +880,24 @@ class discrete_map {
             return find(__STATIC_CAST_K_TO_REAL(k));
         }
 
-        size_type count(const key_type& k) {
+        size_type count(const key_type& k) const {
             return contains(k) ? 1 : 0;
         }
 
         template<class K,
                  typename = std::enable_if_t<std::is_convertible<K, key_type>::value>>
-        size_type count(const K& k) {
+        size_type count(const K& k) const {
             return count(__STATIC_CAST_K_TO_REAL(k));
         }
 
-        bool contains(const key_type& k) {
-            iterator result = find(k);
-            return result.has_value();
+        bool contains(const key_type& k) const {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
+            return probe_find(k).has_value();
         }
 
         template<class K,
                  typename = std::enable_if_t<std::is_convertible<K, key_type>::value>>
-        bool contains(const K& k) {
+        bool contains(const K& k) const {
             return contains(__STATIC_CAST_K_TO_REAL(k));
         }
 
@@ -624,27 +921,156 @@ class discrete_map {
             return equal_range(__STATIC_CAST_K_TO_REAL(k));
         }
 
+        /**
+         * starts pulling k's home slot of the index into cache without waiting for it.
+         *
+         * Issue it a few keys ahead of the find() or insert() that will need the slot, so the memory access overlaps whatever work comes in between. Purely a hint; it never changes the map.
+         */
+        void prefetch(const key_type& k) const noexcept {
+            prefetch_hash(hash_function()(k));
+        }
+
+        // same, for a hash already computed with hash_function().
+        void prefetch_hash(size_t hash) const noexcept {
+            _hash_pol.prefetch(_growth_pol.get_index(_hash_pol.size(), hash));
+        }
+
+        /**
+         * looks up every key in `keys` and writes where each one is to `positions`: an index into keys() and values(), or npos if it isn't in the map.
+         *
+         * For batches, e.g. the probe side of a join. Each key's home slot is prefetched a few keys ahead so the cache misses overlap. On x86-64 hosts with AVX2, detected at run time (see cpu_dispatch.h), maps of 32- or 64-bit integer keys with keyed_index_slots, the default hash, BitwiseGrowthPolicy and linear_prober send them through batch_probe_avx2() four at a time, and only the keys whose home slot holds another key are probed one by one.
+         *
+         * @arg positions at least as long as keys; std::length_error if it's shorter
+         * @return how many of the keys were found
+         */
+        size_type find_many(std::span<const key_type> keys, std::span<size_type> positions) const {
+            if (positions.size() < keys.size()) {
+                throw std::length_error("discrete_map::find_many() thrown exception: positions is shorter than keys.");
+            }
+
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find_many);
+
+            const size_type count = keys.size();
+            size_type first_scalar = 0;
+
+            size_type found = 0;
+            if constexpr (batch_probe_simd) {
+                // picked for this CPU on first use; nullptr leaves everything to the scalar loop below.
+                static const batch_probe_kernel<indices_type, key_type> kernel = batch_probe_select<indices_type, key_type>();
+
+                // in blocks, so a collided key's cluster is probed while the kernel's gather still has it in cache.
+                constexpr size_type block = 64;
+                while (kernel && first_scalar < count) {
+                    const size_type handled = kernel(_hash_pol.data(), _hash_pol.size() - 1, keys.data() + first_scalar, std::min(block, count - first_scalar), positions.data() + first_scalar);
+                    for (size_type i = first_scalar; i < first_scalar + handled; ++i) {
+                        if (positions[i] == batch_probe_unresolved) {
+                            const indices_type& result = probe_find(keys[i]);
+                            positions[i] = result.has_value() ? result.value() : npos;
+                        }
+                        found += positions[i] != npos ? 1 : 0;
+                    }
+                    first_scalar += handled;
+                    if (handled < block) {
+                        break;
+                    }
+                }
+            }
+
+            // far enough ahead to cover a miss on the index, as in the bench's find_prefetch.
+            constexpr size_type prefetch_distance = 8;
+            const hasher hf = hash_function();
+            size_t hashes[prefetch_distance];
+            const size_type warm_up = std::min(count - first_scalar, prefetch_distance);
+            for (size_type j = 0; j < warm_up; ++j) {
+                hashes[(first_scalar + j) % prefetch_distance] = hf(keys[first_scalar + j]);
+                prefetch_hash(hashes[(first_scalar + j) % prefetch_distance]);
+            }
+            for (size_type i = first_scalar; i < count; ++i) {
+                const size_t hash = hashes[i % prefetch_distance];
+                if (i + prefetch_distance < count) {
+                    hashes[i % prefetch_distance] = hf(keys[i + prefetch_distance]);
+                    prefetch_hash(hashes[i % prefetch_distance]);
+                }
+                const indices_type& result = probe_find_hashed(keys[i], hash);
+                positions[i] = result.has_value() ? result.value() : npos;
+                found += result.has_value() ? 1 : 0;
+            }
+            return found;
+        }
+
 //element access
 
-        mapped_type& operator[](const key_type& k) {
-            indices_type& result = probe_find(k);
+        /**
+         * calls `f(value)` on the value stored for k, in place. One probe, and no iterator or pair is built on the way.
+         *
+         * @return false if the key isn't present, in which case `f` isn't called.
+         */
+        template<class Callable>
+        bool visit(const key_type& k, Callable&& f) {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
+            const indices_type& result = probe_find(k);
+            if (!result.has_value()) {
+                return false;
+            }
+            std::forward<Callable>(f)(_values[result.value()]);
+            return true;
+        }
+
+        template<class Callable>
+        bool visit(const key_type& k, Callable&& f) const {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
+            const indices_type& result = probe_find(k);
+            if (!result.has_value()) {
+                return false;
+            }
+            std::forward<Callable>(f)(std::as_const(_values)[result.value()]);
+            return true;
+        }
+
+        /**
+         * inserts k with the value `make_value()` returns if it's missing, otherwise calls `update_value(value)` on the one already there.
+         *
+         * Both cases come out of the same probe, so a counter update (`upsert(k, []{ return 1; }, [](int& n){ ++n; })`) costs one lookup rather than the two of a contains() followed by an insert or an at().
+         *
+         * @return true if the key was inserted, false if the existing value was updated.
+         */
+        template<class MakeValue, class UpdateValue>
+        bool upsert(const key_type& k, MakeValue&& make_value, UpdateValue&& update_value) {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::insert);
+
+            const size_t hash = hash_function()(k);
+            indices_type& result = probe_find_hashed(k, hash);
+
+            if (result.has_value()) {
+                std::forward<UpdateValue>(update_value)(_values[result.value()]);
+                return false;
+            }
+
+            append(&result, k, hash, std::forward<MakeValue>(make_value));
+            return true;
+        }
+
+        mapped_reference operator[](const key_type& k) {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::insert);
+
+            const size_t hash = hash_function()(k);
+            indices_type& result = probe_find_hashed(k, hash);
 
             if (result.has_value()) {
                 return _values[result.value()];
             }
 
-            result = size();
-            _keys.emplace_back(k);
-            _values.emplace_back(T{});
+            append(&result, k, hash, []{ return mapped_type{}; });
 
             return _values.back();
         }
 
-        mapped_type& operator[](const key_type&& k) {
+        mapped_reference operator[](const key_type&& k) {
             return operator[](std::forward<const key_type&>(k));
         }
         
-        const mapped_type& at(const Key& k) const {
+        const_mapped_reference at(const Key& k) const {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
             const indices_type& result = probe_find(k);
             if (result.has_value()) {
                 return _values[result.value()];
@@ -652,8 +1078,102 @@ class discrete_map {
             throw std::out_of_range("discrete_map::at() const thrown exception: key out of range.");
         }
 
-        mapped_type& at(const Key& k) {
-            return __IGNORE_CONST_QUALIF(mapped_type&, at, k);
+        mapped_reference at(const Key& k) {
+            [[maybe_unused]] const auto timing = _hash_pol.stats_policy().time(stats_op::find);
+            const indices_type& result = probe_find(k);
+            if (result.has_value()) {
+                return _values[result.value()];
+            }
+            throw std::out_of_range("discrete_map::at() thrown exception: key out of range.");
+        }
+
+//bulk operations
+
+        /**
+         * calls `f(key, value)` for every element, splitting the columns into contiguous chunks that run on `executor`.
+         *
+         * `f` may modify the value in place but must not touch the map's structure. Chunks run concurrently, so `f` has to be safe to call from several threads at once.
+         *
+         * @arg executor anything with `execute(Callable)`; see thread_pool.h
+         * @arg f callable taking (const key_type&, mapped_type&)
+         */
+        template<class Executor, class Callable>
+        void for_each(Executor& executor, Callable f) {
+            parallel_chunks(executor, size(), [this, &f](size_type first, size_type last) {
+                for (size_type i = first; i < last; ++i) {
+                    f(std::as_const(_keys[i]), _values[i]);
+                }
+            });
+        }
+
+        template<class Callable>
+        void for_each(Callable f) {
+            for_each(default_thread_pool(), std::move(f));
+        }
+
+        /**
+         * replaces every value with `f(key, value)` in parallel. Same threading rules as for_each().
+         */
+        template<class Executor, class Callable>
+        void transform_values(Executor& executor, Callable f) {
+            parallel_chunks(executor, size(), [this, &f](size_type first, size_type last) {
+                for (size_type i = first; i < last; ++i) {
+                    _values[i] = f(std::as_const(_keys[i]), std::as_const(_values)[i]);
+                }
+            });
+        }
+
+        template<class Callable>
+        void transform_values(Callable f) {
+            transform_values(default_thread_pool(), std::move(f));
+        }
+
+        /**
+         * erases every element for which `pred(key, value)` is true.
+         *
+         * Only the scan runs in parallel. Compaction of the columns is a single sequential pass that keeps the surviving elements in order, and the index is then rebuilt once rather than patched per element.
+         *
+         * @return number of elements erased
+         */
+        template<class Executor, class Predicate>
+        size_type erase_if(Executor& executor, Predicate pred) {
+
+            // not std::vector<bool>: neighbouring chunks would race on the same word.
+            std::vector<unsigned char> doomed(size(), 0);
+
+            parallel_chunks(executor, size(), [this, &pred, &doomed](size_type first, size_type last) {
+                for (size_type i = first; i < last; ++i) {
+                    doomed[i] = pred(std::as_const(_keys[i]), std::as_const(_values)[i]) ? 1 : 0;
+                }
+            });
+
+            size_type kept = 0;
+            for (size_type i = 0; i < size(); ++i) {
+                if (doomed[i]) {
+                    continue;
+                }
+                if (kept != i) {
+                    _keys[kept] = std::move(_keys[i]);
+                    _values[kept] = std::move(_values[i]);
+                }
+                ++kept;
+            }
+
+            const size_type erased = size() - kept;
+            if (erased == 0) {
+                return 0;
+            }
+
+            _keys.erase(_keys.begin() + kept, _keys.end());
+            _values.erase(_values.begin() + kept, _values.end());
+            reindex();
+
+            return erased;
+        }
+
+        template<class Predicate>
+        size_type erase_if(Predicate pred) {
+            return erase_if(default_thread_pool(), std::move(pred));
         }
 
 //hash policy
@@ -665,17 +1185,280 @@ class discrete_map {
         void reserve(size_type n) {
             _keys.reserve(n);
             _values.reserve(n);
-            //TODO reserving the index probe?
+
+            // grow the index too, so that inserting up to n elements never triggers a rehash.
+            size_type capacity = _hash_pol.size();
+            while (static_cast<float>(n) / static_cast<float>(capacity) >= _hash_pol.threshold()) {
+                capacity = _growth_pol.next_capacity(capacity);
+            }
+            rehash(capacity);
         }
 
         void rehash(size_type next) {
-            _hash_pol.rehash(next, [this, next](size_type existing_key_index){
-                return _growth_pol.get_index(
-                    next,
-                    hash_function()(_keys[existing_key_index])
-                );
+            _hash_pol.rehash(next, size(), [this, next](size_type existing_key_index){
+                return placement(next, existing_key_index);
             });
         }
+
+        /**
+         * probe and rehash counters collected by the Stats policy. With the default NullStatsPolicy nothing is collected and this is all zeroes.
+         *
+         * e.g. `discrete_map<K, V, std::hash<K>, std::equal_to<K>, std::allocator<K>, std::allocator<V>, BitwiseGrowthPolicy, linear_prober, CountingStatsPolicy>`
+         */
+        probe_stats stats() const noexcept {
+            return _hash_pol.stats();
+        }
+
+        void reset_stats() noexcept {
+            _hash_pol.reset_stats();
+        }
+
+        /**
+         * per-operation latency histograms, for Stats policies that keep them (LatencyStatsPolicy).
+         */
+        auto latency() const
+            requires requires (const Stats& s) { s.latency(); }
+        {
+            return _hash_pol.stats_policy().latency();
+        }
+
+//serialization
+
+    private:
+        static constexpr bool raw_keys = std::is_trivially_copyable_v<key_type>;
+        static constexpr bool raw_values = std::is_trivially_copyable_v<mapped_type>;
+
+        static std::uint64_t hash_seed() {
+            if constexpr (requires(const hasher& h) { h.seed(); }) {
+                return static_cast<std::uint64_t>(hasher().seed());
+            }
+            return 0;
+        }
+
+        template<bool raw, class Collection>
+        static void write_column(snapshot_writer& out, const Collection& column) {
+            if constexpr (raw) {
+                if (!column.empty()) {
+                    out.write_raw(std::addressof(column[0]), column.size() * sizeof(column[0]));
+                }
+            }
+            else {
+                for (const auto& element : column) {
+                    out.write_element(element);
+                }
+            }
+        }
+
+        template<bool raw, class Element, class Collection>
+        static void read_column(snapshot_reader& in, Collection& column, size_type n) {
+            if constexpr (raw) {
+                column.resize(n);
+                if (n > 0) {
+                    in.read_raw(std::addressof(column[0]), n * sizeof(Element));
+                }
+            }
+            else {
+                column.reserve(n);
+                for (size_type i = 0; i < n && in.good(); ++i) {
+                    column.push_back(in.template read_element<Element>());
+                }
+            }
+        }
+
+        snapshot_header make_snapshot_header() const {
+            snapshot_header header{};
+            std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+            header.version = snapshot_version;
+            header.byte_order = snapshot_byte_order;
+            header.flags = (raw_keys ? snapshot_raw_keys : 0u) | (raw_values ? snapshot_raw_values : 0u);
+
+            header.key_size = sizeof(key_type);
+            header.value_size = sizeof(mapped_type);
+            header.slot_size = sizeof(indices_type);
+
+            header.element_count = size();
+            header.index_capacity = _hash_pol.size();
+
+            header.hash_seed = hash_seed();
+            header.hash_check = empty() ? 0 : static_cast<std::uint64_t>(hash_function()(_keys[0]));
+
+            snapshot_set_name(header.growth_policy, _growth_pol.name());
+            if constexpr (layout_growth_policy<growth_policy_type>) {
+                const auto state = _growth_pol.state();
+                std::copy(state.begin(), state.end(), header.growth_state);
+            }
+            snapshot_set_name(header.probe_policy, _hash_pol.probe_name());
+
+            // raw sections start on an aligned boundary so a reader can map them in place. after a codec section nothing can be placed up front.
+            header.keys_offset = snapshot_align(sizeof(snapshot_header));
+            header.values_offset = raw_keys
+                ? snapshot_align(header.keys_offset + size() * sizeof(key_type))
+                : 0;
+            header.indices_offset = raw_keys && raw_values
+                ? snapshot_align(header.values_offset + size() * sizeof(mapped_type))
+                : 0;
+
+            return header;
+        }
+
+        // whether the stored table can be adopted as-is or has to be rebuilt from the columns.
+        bool snapshot_index_usable(const snapshot_header& header) const {
+            return header.slot_size == sizeof(indices_type)
+                && header.hash_seed == hash_seed()
+                && snapshot_name_equals(header.growth_policy, _growth_pol.name())
+                && snapshot_name_equals(header.probe_policy, _hash_pol.probe_name())
+                && header.index_capacity <= std::numeric_limits<size_type>::max()
+                && _growth_pol.valid_capacity(static_cast<size_type>(header.index_capacity))
+                && (empty() || header.hash_check == static_cast<std::uint64_t>(hash_function()(_keys[0])));
+        }
+
+        // whether an index read from a snapshot can be trusted: every element sits in exactly one slot, and some slot is empty so a probe for a missing key stops.
+        bool snapshot_index_consistent() const {
+            const size_type n = size();
+            const indices_type* slots = _hash_pol.data();
+            std::vector<bool> seen(n, false);
+            size_type engaged = 0;
+
+            for (size_type i = 0; i < _hash_pol.size(); ++i) {
+                if (!slots[i].has_value()) {
+                    continue;
+                }
+                const size_type element = slots[i].value();
+                if (element >= n || seen[element]) {
+                    return false;
+                }
+                seen[element] = true;
+                ++engaged;
+            }
+            return engaged == n && engaged < _hash_pol.size();
+        }
+
+    public:
+
+        /**
+         * writes the columns and the index table to `os`.
+         *
+         * Trivially copyable keys/values are dumped as contiguous blocks; anything else goes through snapshot_codec. See snapshot.h for the layout.
+         */
+        void save(std::ostream& os) const {
+            static_assert(single_value_column, "discrete_map::save(): maps with columns<...> values can't be snapshotted.");
+            const snapshot_header header = make_snapshot_header();
+
+            static_assert(std::has_unique_object_representations_v<indices_type>, "discrete_map::save(): index slots are written out raw, so they can't have padding bytes.");
+
+            snapshot_writer out(os);
+            out.write_raw(&header, sizeof(header));
+
+            out.pad_to(header.keys_offset);
+            write_column<raw_keys>(out, _keys);
+
+            out.pad_to(header.values_offset);
+            write_column<raw_values>(out, _values);
+
+            out.pad_to(header.indices_offset);
+            out.write_raw(_hash_pol.data(), _hash_pol.size() * sizeof(indices_type));
+
+            if (!out.good()) {
+                throw std::runtime_error("discrete_map::save() thrown exception: stream failed while writing snapshot.");
+            }
+        }
+
+        /**
+         * replaces the contents of the map with a snapshot written by save().
+         *
+         * If the snapshot was written with a different growth/probe policy or hasher, or its index doesn't check out against the columns, the columns are still used but the index is rebuilt from them. The map is left untouched if anything throws.
+         */
+        void load(std::istream& is) {
+            static_assert(single_value_column, "discrete_map::load(): maps with columns<...> values can't be snapshotted.");
+            snapshot_reader in(is);
+
+            snapshot_header header;
+            in.read_raw(&header, sizeof(header));
+
+            if (!in.good() || std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0) {
+                throw std::runtime_error("discrete_map::load() thrown exception: not a discrete_map snapshot.");
+            }
+            if (header.version != snapshot_version) {
+                throw std::runtime_error("discrete_map::load() thrown exception: unsupported snapshot version.");
+            }
+            if (header.byte_order != snapshot_byte_order) {
+                throw std::runtime_error("discrete_map::load() thrown exception: snapshot was written with a different byte order.");
+            }
+            const std::uint32_t expected_flags = (raw_keys ? snapshot_raw_keys : 0u) | (raw_values ? snapshot_raw_values : 0u);
+            if (header.flags != expected_flags || header.key_size != sizeof(key_type) || header.value_size != sizeof(mapped_type)) {
+                throw std::runtime_error("discrete_map::load() thrown exception: snapshot key/value types don't match this map.");
+            }
+
+            discrete_map loaded;
+            const size_type n = static_cast<size_type>(header.element_count);
+
+            in.skip_to(header.keys_offset);
+            read_column<raw_keys, key_type>(in, loaded._keys, n);
+
+            in.skip_to(header.values_offset);
+            read_column<raw_values, mapped_type>(in, loaded._values, n);
+
+            bool adopted = false;
+            if (loaded.snapshot_index_usable(header)) {
+                if constexpr (layout_growth_policy<growth_policy_type>) {
+                    loaded._growth_pol.restore({header.growth_state[0], header.growth_state[1]});
+                }
+                in.skip_to(header.indices_offset);
+                loaded._hash_pol.resize(static_cast<size_type>(header.index_capacity));
+                in.read_raw(loaded._hash_pol.data(), header.index_capacity * sizeof(indices_type));
+
+                // a damaged table would send lookups past the columns or round the table forever.
+                adopted = in.good() && loaded.snapshot_index_consistent();
+            }
+            else {
+                // still consume the table so the stream ends up just past the snapshot.
+                in.skip_to(header.indices_offset);
+                in.skip(header.index_capacity * header.slot_size);
+            }
+
+            if (!adopted) {
+                if constexpr (layout_growth_policy<growth_policy_type>) {
+                    loaded.relayout();
+                }
+                else {
+                    loaded.reserve(n);
+                    loaded.reindex();
+                }
+            }
+
+            if (!in.good()) {
+                throw std::runtime_error("discrete_map::load() thrown exception: snapshot is truncated.");
+            }
+
+            *this = std::move(loaded);
+        }
+
+#if defined(__unix__) || defined(__APPLE__)
+        // same as save(std::ostream&) but straight to a file descriptor. the descriptor is left open.
+        void save(int fd) const {
+            fd_streambuf buffer(fd);
+            std::ostream os(&buffer);
+            save(os);
+            if (buffer.pubsync() != 0 || buffer.error() != 0) {
+                throw std::system_error(buffer.error(), std::generic_category(), "discrete_map::save() thrown exception");
+            }
+        }
+
+        void load(int fd) {
+            fd_streambuf buffer(fd);
+            std::istream is(&buffer);
+            try {
+                load(is);
+            }
+            catch (const std::runtime_error&) {
+                // a failed read() looks like a truncated stream from in here. report the errno instead if there was one.
+                if (buffer.error() != 0) {
+                    throw std::system_error(buffer.error(), std::generic_category(), "discrete_map::load() thrown exception");
+                }
+                throw;
+            }
+        }
+#endif
 };
 
 #endif
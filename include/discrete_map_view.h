@@ -0,0 +1,392 @@
+#ifndef DISCRETE_MAP_VIEW_H
+#define DISCRETE_MAP_VIEW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "BitwiseGrowthPolicy.h"
+#include "discrete_map.h"
+#include "index_storage.h"
+#include "linear_prober.h"
+#include "snapshot.h"
+#include "StatsPolicy.h"
+
+/**
+ * read-only discrete_map over a snapshot that stays where it is.
+ *
+ * The key column, value column and index table are used in place, straight out of the mapping: opening a view is an mmap plus a header check, and lookups allocate nothing and never rehash. Processes that map the same file share one page-cache copy of it.
+ *
+ * Only snapshots written by a discrete_map with the same key/value types, hasher, policies and IndexSlots can be viewed, and both types must be trivially copyable (nothing else is stored raw).
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class Growth = BitwiseGrowthPolicy,
+         template<class> class Probe = linear_prober,
+         class IndexSlots = plain_index_slots>
+class discrete_map_view {
+    static_assert(std::is_trivially_copyable_v<Key>, "discrete_map_view: keys are read in place, so Key must be trivially copyable.");
+    static_assert(std::is_trivially_copyable_v<T>, "discrete_map_view: values are read in place, so T must be trivially copyable.");
+    static_assert(alignof(Key) <= snapshot_alignment && alignof(T) <= snapshot_alignment, "discrete_map_view: snapshot sections are only aligned to snapshot_alignment.");
+
+    private:
+        using producer_type = discrete_map<Key, T, Hash, Pred, std::allocator<Key>, std::allocator<T>, Growth, Probe, NullStatsPolicy, heap_index_storage, IndexSlots>;
+
+    public:
+        // types
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<const Key&, const T&>;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = typename producer_type::size_type;
+
+    private:
+        using indices_type = typename producer_type::index_slot_type;
+
+        struct size_traits {
+            using size_type = typename producer_type::size_type;
+            using indices_type = typename producer_type::index_slot_type;
+            using indices_collection_type = std::span<const indices_type>;
+        };
+
+        using prober_type = Probe<size_traits>;
+
+        const void* _mapping = nullptr;
+        size_type _mapping_length = 0;
+        bool _owns_mapping = false;
+
+        std::span<const key_type> _keys;
+        std::span<const mapped_type> _values;
+        std::span<const indices_type> _indices;
+
+        Growth _growth_pol;
+        prober_type _prober;
+
+        static std::uint64_t hash_seed() {
+            if constexpr (requires(const hasher& h) { h.seed(); }) {
+                return static_cast<std::uint64_t>(hasher().seed());
+            }
+            return 0;
+        }
+
+        template<class Element>
+        std::span<const Element> section(std::uint64_t offset, std::uint64_t count) const {
+            // divides rather than multiplies, so a hostile count can't wrap the bounds check round.
+            if (offset == 0 || offset % snapshot_alignment != 0 || offset > _mapping_length || count > (_mapping_length - offset) / sizeof(Element)) {
+                throw std::runtime_error("discrete_map_view thrown exception: snapshot section is out of bounds or unaligned.");
+            }
+            return {reinterpret_cast<const Element*>(static_cast<const char*>(_mapping) + offset), static_cast<size_type>(count)};
+        }
+
+        void attach() {
+            if (_mapping_length < sizeof(snapshot_header)) {
+                throw std::runtime_error("discrete_map_view thrown exception: not a discrete_map snapshot.");
+            }
+            // sections are aligned relative to the start of the snapshot, so they're only aligned in memory if the start is.
+            if (reinterpret_cast<std::uintptr_t>(_mapping) % snapshot_alignment != 0) {
+                throw std::runtime_error("discrete_map_view thrown exception: snapshot memory isn't aligned to snapshot_alignment.");
+            }
+
+            snapshot_header header;
+            std::memcpy(&header, _mapping, sizeof(header));
+
+            if (std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0) {
+                throw std::runtime_error("discrete_map_view thrown exception: not a discrete_map snapshot.");
+            }
+            if (header.version != snapshot_version || header.byte_order != snapshot_byte_order) {
+                throw std::runtime_error("discrete_map_view thrown exception: unsupported snapshot version or byte order.");
+            }
+            if (header.flags != (snapshot_raw_keys | snapshot_raw_values)
+                    || header.key_size != sizeof(key_type)
+                    || header.value_size != sizeof(mapped_type)
+                    || header.slot_size != sizeof(indices_type)) {
+                throw std::runtime_error("discrete_map_view thrown exception: snapshot key/value types don't match this view.");
+            }
+            // there's nowhere to rebuild an index into, so anything that would change where a key lives is fatal here.
+            if (!snapshot_name_equals(header.growth_policy, _growth_pol.name())
+                    || !snapshot_name_equals(header.probe_policy, _prober.name())
+                    || header.hash_seed != hash_seed()
+                    || header.index_capacity > std::numeric_limits<size_type>::max()
+                    || !_growth_pol.valid_capacity(static_cast<size_type>(header.index_capacity))) {
+                throw std::runtime_error("discrete_map_view thrown exception: snapshot was written with a different hasher or policy.");
+            }
+
+            if constexpr (layout_growth_policy<Growth>) {
+                _growth_pol.restore({header.growth_state[0], header.growth_state[1]});
+            }
+
+            _keys = section<key_type>(header.keys_offset, header.element_count);
+            _values = section<mapped_type>(header.values_offset, header.element_count);
+            _indices = section<indices_type>(header.indices_offset, header.index_capacity);
+
+            if (!_keys.empty() && header.hash_check != static_cast<std::uint64_t>(hash_function()(_keys[0]))) {
+                throw std::runtime_error("discrete_map_view thrown exception: snapshot was written with a different hasher or policy.");
+            }
+        }
+
+        const indices_type* probe_find(const key_type& k) const {
+            const size_t hash = hash_function()(k);
+            const size_type home = _growth_pol.get_index(_indices.size(), hash);
+            const auto fingerprint = indices_type::fingerprint_of(k, hash);
+
+            // the prober wraps round, and a damaged table need not have an empty slot to stop at.
+            auto it = _prober.cbegin(_indices) + home;
+            for (size_type step = 0; step < _indices.size(); ++step, ++it) {
+                const indices_type& index = *it;
+                if (!index.has_value()) {
+                    return nullptr;
+                }
+                // the table is never scanned up front (that would fault in all of it), so a slot past the columns is caught as it's reached.
+                if (index.value() >= _keys.size()) {
+                    throw std::runtime_error("discrete_map_view thrown exception: snapshot index points past the columns.");
+                }
+                if (index.may_match(fingerprint) && (indices_type::exact_match || key_eq()(k, _keys[index.value()]))) {
+                    return &index;
+                }
+            }
+            return nullptr;
+        }
+
+        void release() noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+            if (_owns_mapping && _mapping != nullptr) {
+                ::munmap(const_cast<void*>(_mapping), _mapping_length);
+            }
+#endif
+            _mapping = nullptr;
+            _mapping_length = 0;
+            _owns_mapping = false;
+        }
+
+        class const_iterator {
+            private:
+                size_type _index;
+                const discrete_map_view* _view;
+
+            public:
+                const_iterator(size_type i, const discrete_map_view& view)
+                    : _index(i),
+                      _view(&view)
+                {}
+                value_type operator*() const {
+                    return {_view->_keys[_index], _view->_values[_index]};
+                }
+                const_iterator& operator++() {
+                    _index++;
+                    return *this;
+                }
+                const_iterator& operator--() {
+                    _index--;
+                    return *this;
+                }
+                const_iterator operator++(int) {
+                    const_iterator temp = *this;
+                    ++(*this);
+                    return temp;
+                }
+                const_iterator operator--(int) {
+                    const_iterator temp = *this;
+                    --(*this);
+                    return temp;
+                }
+                const_iterator operator+(size_type n) const {
+                    return const_iterator(_index + n, *_view);
+                }
+                bool operator==(const const_iterator& other) const {
+                    return _index == other._index;
+                }
+                bool operator!=(const const_iterator& other) const {
+                    return !(*this == other);
+                }
+        };
+
+    public:
+        using iterator = const_iterator;
+
+//construct/copy/destroy
+
+        /**
+         * views a snapshot already in memory. The memory isn't owned and has to outlive the view, and has to start on a snapshot_alignment boundary.
+         */
+        discrete_map_view(const void* data, size_type length)
+            : _mapping(data),
+              _mapping_length(length),
+              _owns_mapping(false)
+        {
+            attach();
+        }
+
+#if defined(__unix__) || defined(__APPLE__)
+        /**
+         * maps the snapshot at `path` read-only and shared.
+         */
+        explicit discrete_map_view(const char* path) {
+            const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "discrete_map_view thrown exception: open");
+            }
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0) {
+                const int error = errno;
+                ::close(fd);
+                throw std::system_error(error, std::generic_category(), "discrete_map_view thrown exception: fstat");
+            }
+
+            _mapping_length = static_cast<size_type>(info.st_size);
+            void* mapping = _mapping_length == 0
+                ? MAP_FAILED
+                : ::mmap(nullptr, _mapping_length, PROT_READ, MAP_SHARED, fd, 0);
+            const int error = errno;
+            // the mapping keeps the file alive on its own.
+            ::close(fd);
+
+            if (mapping == MAP_FAILED) {
+                throw std::system_error(_mapping_length == 0 ? EINVAL : error, std::generic_category(), "discrete_map_view thrown exception: mmap");
+            }
+            _mapping = mapping;
+            _owns_mapping = true;
+
+            try {
+                attach();
+            }
+            catch (...) {
+                release();
+                throw;
+            }
+        }
+
+        explicit discrete_map_view(const std::string& path)
+            : discrete_map_view(path.c_str())
+        {}
+#endif
+
+        discrete_map_view(const discrete_map_view&) = delete;
+        discrete_map_view& operator=(const discrete_map_view&) = delete;
+
+        discrete_map_view(discrete_map_view&& other) noexcept
+            : _mapping(std::exchange(other._mapping, nullptr)),
+              _mapping_length(std::exchange(other._mapping_length, 0)),
+              _owns_mapping(std::exchange(other._owns_mapping, false)),
+              _keys(std::exchange(other._keys, {})),
+              _values(std::exchange(other._values, {})),
+              _indices(std::exchange(other._indices, {})),
+              _growth_pol(std::move(other._growth_pol)),
+              _prober(std::move(other._prober))
+        {}
+
+        discrete_map_view& operator=(discrete_map_view&& other) noexcept {
+            if (this != &other) {
+                release();
+                _mapping = std::exchange(other._mapping, nullptr);
+                _mapping_length = std::exchange(other._mapping_length, 0);
+                _owns_mapping = std::exchange(other._owns_mapping, false);
+                _keys = std::exchange(other._keys, {});
+                _values = std::exchange(other._values, {});
+                _indices = std::exchange(other._indices, {});
+                // a layout_growth_policy carries the state restore() gave it, and lookups need it to find the home slot.
+                _growth_pol = std::move(other._growth_pol);
+                _prober = std::move(other._prober);
+            }
+            return *this;
+        }
+
+        ~discrete_map_view() {
+            release();
+        }
+
+//iterators
+
+        const_iterator begin() const noexcept {
+            return const_iterator(0, *this);
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(size(), *this);
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+
+//getters
+
+        std::span<const key_type> keys() const noexcept {
+            return _keys;
+        }
+
+        std::span<const mapped_type> values() const noexcept {
+            return _values;
+        }
+
+//capacity
+
+        [[nodiscard]] bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type size() const noexcept {
+            return _keys.size();
+        }
+
+//observers
+
+        key_equal key_eq() const {
+            return Pred();
+        }
+
+        hasher hash_function() const {
+            return hasher();
+        }
+
+//map operations
+
+        const_iterator find(const key_type& k) const {
+            const indices_type* result = probe_find(k);
+            return result != nullptr ? begin() + result->value() : end();
+        }
+
+        bool contains(const key_type& k) const {
+            return probe_find(k) != nullptr;
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+//element access
+
+        const mapped_type& at(const key_type& k) const {
+            const indices_type* result = probe_find(k);
+            if (result != nullptr) {
+                return _values[result->value()];
+            }
+            throw std::out_of_range("discrete_map_view::at() const thrown exception: key out of range.");
+        }
+};
+
+#endif
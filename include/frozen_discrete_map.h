@@ -0,0 +1,368 @@
+#ifndef FROZEN_DISCRETE_MAP_H
+#define FROZEN_DISCRETE_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "discrete_map.h"
+
+/**
+ * immutable discrete_map whose index is a minimal perfect hash function instead of a probe table.
+ *
+ * The columns are permuted at construction so that the MPHF sends every key straight to its own position: a lookup is one hash, one pilot load, one key comparison, and never probes. This follows PTHash: keys are split into buckets of about four, and each bucket is given the smallest 16-bit "pilot" that scatters its keys onto free positions of a table slightly larger than n. The few keys that land past n are remapped into the holes below it, which makes the function minimal.
+ *
+ * The index costs about four bits per key for the pilots plus a small remap table, instead of a slot per bucket.
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class Pred = std::equal_to<Key>>
+class frozen_discrete_map {
+    public:
+        // types
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<const Key, T>;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = size_t;
+
+        using key_collection_type = std::vector<key_type>;
+        using value_collection_type = std::vector<mapped_type>;
+
+    private:
+        using pilot_type = std::uint16_t;
+
+        // average keys per bucket. larger means fewer pilots but longer searches.
+        static constexpr size_type bucket_load = 4;
+        // table positions per key, as a percentage. the slack is what lets the last buckets find room quickly.
+        static constexpr size_type table_percent = 101;
+        static constexpr unsigned max_seed_attempts = 64;
+
+        key_collection_type _keys;
+        value_collection_type _values;
+
+        std::vector<pilot_type> _pilots;
+        std::vector<std::uint32_t> _remap;
+
+        std::uint64_t _seed = 0;
+        size_type _table_size = 0;
+
+        // murmur3's finaliser. the user's hasher may be the identity, and every bit of the output gets used below.
+        static constexpr std::uint64_t mix(std::uint64_t h) noexcept {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        // maps a 32-bit value onto [0, n) without a division.
+        static constexpr size_type fast_range(std::uint32_t x, size_type n) noexcept {
+            return static_cast<size_type>((static_cast<std::uint64_t>(x) * n) >> 32);
+        }
+
+        std::uint64_t key_hash(const key_type& k) const {
+            return mix(static_cast<std::uint64_t>(hasher()(k)) ^ _seed);
+        }
+
+        size_type bucket_of(std::uint64_t h) const noexcept {
+            return fast_range(static_cast<std::uint32_t>(h >> 32), _pilots.size());
+        }
+
+        size_type table_position(std::uint64_t h, pilot_type pilot) const noexcept {
+            return fast_range(static_cast<std::uint32_t>(mix(h ^ mix(pilot + 1))), _table_size);
+        }
+
+        size_type position_of(const key_type& k) const {
+            const std::uint64_t h = key_hash(k);
+            const size_type pos = table_position(h, _pilots[bucket_of(h)]);
+            return pos < _keys.size() ? pos : _remap[pos - _keys.size()];
+        }
+
+        /**
+         * tries to find pilots for every bucket under the current seed.
+         *
+         * @arg hashes key hashes in source order
+         * @arg positions output: table position of each source key
+         * @return false if some bucket exhausted every pilot
+         */
+        bool try_build(const std::vector<std::uint64_t>& hashes, std::vector<size_type>& positions) {
+            const size_type n = hashes.size();
+            const size_type buckets = _pilots.size();
+
+            // counting sort of keys into buckets.
+            std::vector<size_type> offsets(buckets + 1, 0);
+            for (size_type i = 0; i < n; ++i) {
+                ++offsets[bucket_of(hashes[i]) + 1];
+            }
+            for (size_type b = 0; b < buckets; ++b) {
+                offsets[b + 1] += offsets[b];
+            }
+            std::vector<size_type> members(n);
+            std::vector<size_type> cursor(offsets.begin(), offsets.end() - 1);
+            for (size_type i = 0; i < n; ++i) {
+                members[cursor[bucket_of(hashes[i])]++] = i;
+            }
+
+            // biggest buckets first, while the table is still empty enough for them.
+            std::vector<size_type> order(buckets);
+            for (size_type b = 0; b < buckets; ++b) {
+                order[b] = b;
+            }
+            std::stable_sort(order.begin(), order.end(), [&offsets](size_type a, size_type b) {
+                return offsets[a + 1] - offsets[a] > offsets[b + 1] - offsets[b];
+            });
+
+            std::vector<bool> taken(_table_size, false);
+            std::vector<size_type> candidate;
+
+            for (const size_type b : order) {
+                const size_type first = offsets[b];
+                const size_type last = offsets[b + 1];
+                if (first == last) {
+                    continue;
+                }
+
+                bool placed = false;
+                for (std::uint32_t pilot = 0; pilot <= std::numeric_limits<pilot_type>::max() && !placed; ++pilot) {
+                    candidate.clear();
+                    for (size_type j = first; j < last; ++j) {
+                        const size_type pos = table_position(hashes[members[j]], static_cast<pilot_type>(pilot));
+                        if (taken[pos] || std::find(candidate.begin(), candidate.end(), pos) != candidate.end()) {
+                            break;
+                        }
+                        candidate.push_back(pos);
+                    }
+                    if (candidate.size() != last - first) {
+                        continue;
+                    }
+
+                    _pilots[b] = static_cast<pilot_type>(pilot);
+                    for (size_type j = first; j < last; ++j) {
+                        taken[candidate[j - first]] = true;
+                        positions[members[j]] = candidate[j - first];
+                    }
+                    placed = true;
+                }
+
+                if (!placed) {
+                    return false;
+                }
+            }
+
+            // make it minimal: every position past n is redirected to one of the holes left below n.
+            _remap.assign(_table_size - n, 0);
+            size_type hole = 0;
+            for (size_type pos = n; pos < _table_size; ++pos) {
+                if (!taken[pos]) {
+                    continue;
+                }
+                while (taken[hole]) {
+                    ++hole;
+                }
+                _remap[pos - n] = static_cast<std::uint32_t>(hole);
+                taken[hole] = true;
+            }
+            for (size_type i = 0; i < n; ++i) {
+                if (positions[i] >= n) {
+                    positions[i] = _remap[positions[i] - n];
+                }
+            }
+
+            return true;
+        }
+
+        template<class KeyCollection, class ValueCollection>
+        void build(const KeyCollection& keys, const ValueCollection& values) {
+            const size_type n = keys.size();
+            if (n > std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("frozen_discrete_map thrown exception: too many keys.");
+            }
+
+            _table_size = std::max<size_type>(1, n * table_percent / 100 + 1);
+            _pilots.assign(std::max<size_type>(1, (n + bucket_load - 1) / bucket_load), 0);
+
+            std::vector<std::uint64_t> hashes(n);
+            std::vector<size_type> positions(n);
+
+            bool built = false;
+            for (unsigned attempt = 0; attempt < max_seed_attempts && !built; ++attempt) {
+                _seed = mix(attempt + 0x9E3779B97F4A7C15ull);
+                for (size_type i = 0; i < n; ++i) {
+                    hashes[i] = key_hash(keys[i]);
+                }
+                std::fill(_pilots.begin(), _pilots.end(), pilot_type{0});
+                built = try_build(hashes, positions);
+            }
+            if (!built) {
+                // practically only reachable if the hasher maps distinct keys to the same value.
+                throw std::runtime_error("frozen_discrete_map thrown exception: could not build a perfect hash for these keys.");
+            }
+
+            // lay the columns out in MPHF order.
+            std::vector<size_type> source_of(n);
+            for (size_type i = 0; i < n; ++i) {
+                source_of[positions[i]] = i;
+            }
+            _keys.reserve(n);
+            _values.reserve(n);
+            for (size_type pos = 0; pos < n; ++pos) {
+                _keys.push_back(keys[source_of[pos]]);
+                _values.push_back(values[source_of[pos]]);
+            }
+        }
+
+        class const_iterator {
+            private:
+                size_type _index;
+                const frozen_discrete_map* _map;
+
+            public:
+                const_iterator(size_type i, const frozen_discrete_map& map)
+                    : _index(i),
+                      _map(&map)
+                {}
+                // dereference
+                const value_type operator*() const {
+                    return {_map->_keys[_index], _map->_values[_index]};
+                }
+                const_iterator& operator++() {
+                    _index++;
+                    return *this;
+                }
+                const_iterator operator++(int) {
+                    const_iterator temp = *this;
+                    ++(*this);
+                    return temp;
+                }
+                const_iterator operator+(size_type n) const {
+                    return const_iterator(_index + n, *_map);
+                }
+                bool operator==(const const_iterator& other) const {
+                    return _index == other._index;
+                }
+                bool operator!=(const const_iterator& other) const {
+                    return !(*this == other);
+                }
+        };
+
+    public:
+        using iterator = const_iterator;
+
+//construct/copy/destroy
+
+        /**
+         * freezes the contents of an existing map. The source is left as it is.
+         */
+        template<class KeyAllocator, class ValueAllocator, class Growth, template<class> class Probe, class Stats, template<class> class IndexStorage, class IndexSlots>
+        explicit frozen_discrete_map(const discrete_map<Key, T, Hash, Pred, KeyAllocator, ValueAllocator, Growth, Probe, Stats, IndexStorage, IndexSlots>& source) {
+            build(source.keys(), source.values());
+        }
+
+        /**
+         * builds from a range of key/value pairs. Later duplicates of a key are ignored, as with insert().
+         */
+        template<class InputIterator>
+        frozen_discrete_map(InputIterator first, InputIterator last)
+            : frozen_discrete_map(discrete_map<Key, T, Hash, Pred>(first, last, 0))
+        {}
+
+        frozen_discrete_map(std::initializer_list<value_type> il)
+            : frozen_discrete_map(il.begin(), il.end())
+        {}
+
+//iterators
+
+        const_iterator begin() const noexcept {
+            return const_iterator(0, *this);
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(size(), *this);
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+
+//getters
+
+        const key_collection_type& keys() const noexcept {
+            return _keys;
+        }
+
+        const value_collection_type& values() const noexcept {
+            return _values;
+        }
+
+//capacity
+
+        [[nodiscard]] bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type size() const noexcept {
+            return _keys.size();
+        }
+
+        // bytes spent on the perfect hash itself, i.e. everything but the two columns.
+        size_type index_bytes() const noexcept {
+            return _pilots.size() * sizeof(pilot_type) + _remap.size() * sizeof(std::uint32_t);
+        }
+
+//observers
+
+        key_equal key_eq() const {
+            return Pred();
+        }
+
+        hasher hash_function() const {
+            return hasher();
+        }
+
+//map operations
+
+        const_iterator find(const key_type& k) const {
+            if (empty()) {
+                return end();
+            }
+            // an MPHF sends unknown keys somewhere too, hence the comparison.
+            const size_type pos = position_of(k);
+            return key_eq()(k, _keys[pos]) ? begin() + pos : end();
+        }
+
+        bool contains(const key_type& k) const {
+            return find(k) != end();
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+//element access
+
+        const mapped_type& at(const key_type& k) const {
+            if (!empty()) {
+                const size_type pos = position_of(k);
+                if (key_eq()(k, _keys[pos])) {
+                    return _values[pos];
+                }
+            }
+            throw std::out_of_range("frozen_discrete_map::at() const thrown exception: key out of range.");
+        }
+};
+
+#endif
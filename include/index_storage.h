@@ -0,0 +1,492 @@
+#ifndef INDEX_STORAGE_H
+#define INDEX_STORAGE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * one slot of the index table: an element index and a fingerprint of its key's hash, or empty.
+ *
+ * The element is stored as element + 1 in the low bits, so an all-zero slot is empty. That is what lets reserved_index_storage treat untouched zero pages as an empty table.
+ *
+ * The top fingerprint_bits bits hold a few bits of the key's hash. A 64-bit index never needs all of its width (at 2^48 elements the index alone would be 2PB), so a probe can compare fingerprints first and skip the key column for almost every slot that belongs to some other key. A narrower Size can't spare the bits: there fingerprint_bits is 0, the slot keeps its full width and every occupied slot is a key comparison, as before.
+ */
+template<class Size>
+class index_slot {
+    public:
+        static constexpr unsigned fingerprint_bits = std::numeric_limits<Size>::digits >= 64 ? 16 : 0;
+
+        // what probe() compares a slot against before going to the key column. only a hint here, so a match still needs the keys compared.
+        using fingerprint_type = Size;
+        static constexpr bool exact_match = false;
+
+        // the largest number of elements a table of these slots can address.
+        static constexpr Size max_elements = (std::numeric_limits<Size>::max() >> fingerprint_bits) - 1;
+
+    private:
+        static constexpr unsigned element_bits = std::numeric_limits<Size>::digits - fingerprint_bits;
+        static constexpr Size element_mask = std::numeric_limits<Size>::max() >> fingerprint_bits;
+
+        Size _encoded = 0;
+
+    public:
+        constexpr index_slot() noexcept = default;
+
+        constexpr index_slot(std::nullopt_t) noexcept {}
+
+        // fingerprint comes from fingerprint_of().
+        constexpr index_slot(Size element, Size fingerprint) noexcept
+            : _encoded((element + 1) | fingerprint)
+        {}
+
+        /**
+         * the fingerprint bits of a slot for a key with this hash, already in position.
+         *
+         * The hash is multiplied through first: the home slot comes from the low bits, and identity hashes of small integers have nothing in the high ones.
+         */
+        static constexpr Size fingerprint_of(size_t hash) noexcept {
+            if constexpr (fingerprint_bits == 0) {
+                return 0;
+            }
+            else {
+                const std::uint64_t mixed = static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+                return static_cast<Size>(mixed >> (64 - fingerprint_bits)) << element_bits;
+            }
+        }
+
+        // the same, for callers that don't know which kind of slot they have. keyed_index_slot wants the key instead.
+        template<class Key>
+        static constexpr Size fingerprint_of(const Key&, size_t hash) noexcept {
+            return fingerprint_of(hash);
+        }
+
+        constexpr bool has_value() const noexcept {
+            return _encoded != 0;
+        }
+
+        // unchecked, unlike std::optional::value(). callers test has_value() first.
+        constexpr Size value() const noexcept {
+            return (_encoded & element_mask) - 1;
+        }
+
+        constexpr Size fingerprint() const noexcept {
+            return _encoded & ~element_mask;
+        }
+
+        // false means the slot certainly holds some other key; true means compare the keys.
+        constexpr bool may_match(Size fingerprint) const noexcept {
+            return (_encoded & ~element_mask) == fingerprint;
+        }
+
+        // points the slot at another element holding the same key, e.g. after the element moved within the columns.
+        constexpr void relink(Size element) noexcept {
+            _encoded = (element + 1) | fingerprint();
+        }
+
+        constexpr index_slot& operator=(std::nullopt_t) noexcept {
+            _encoded = 0;
+            return *this;
+        }
+
+        friend constexpr bool operator==(const index_slot&, const index_slot&) = default;
+};
+
+/**
+ * whether keyed_index_slots can keep copies of a key in the index table, in keyed_index_slot.
+ *
+ * Only for keys of at most 8 bytes that are equal exactly when their bytes are: integers, enums and pointers compared with std::equal_to. Anything else compares against the key column as before.
+ */
+template<class Key, class Pred>
+inline constexpr bool key_fits_in_slot = (std::is_integral_v<Key> || std::is_enum_v<Key> || std::is_pointer_v<Key>)
+    && sizeof(Key) <= sizeof(std::uint64_t)
+    && (std::is_same_v<Pred, std::equal_to<Key>> || std::is_same_v<Pred, std::equal_to<>>);
+
+/**
+ * an index slot that also holds a copy of its element's key.
+ *
+ * With index_slot every probe that gets past the fingerprint reads the key column, which lives in a different array and so usually means a second cache miss. Here the key comparison happens on the slot itself: a lookup touches one line of the table, and the columns only once it has found the element. A miss never leaves the table at all.
+ *
+ * That costs a wider slot (16 bytes with a 64-bit Size rather than 8), so the table takes twice the memory. The fingerprint would only repeat the key, so there isn't one, and the element index gets the full width of Size.
+ */
+// a key followed by N bytes that are always zero, so a slot holding it has no padding left for stale memory to show through.
+template<class Key, size_t N>
+struct padded_key {
+    Key key{};
+    unsigned char padding[N] = {};
+
+    friend constexpr bool operator==(const padded_key&, const padded_key&) = default;
+};
+
+template<class Key>
+struct padded_key<Key, 0> {
+    Key key{};
+
+    friend constexpr bool operator==(const padded_key&, const padded_key&) = default;
+};
+
+template<class Size, class Key>
+class keyed_index_slot {
+    static_assert(alignof(Key) <= alignof(Size), "keyed_index_slot: the key must not need more alignment than the element index, or the padding wouldn't all be at the end.");
+
+    private:
+        static constexpr size_t padding_bytes = (sizeof(Size) + sizeof(Key) + alignof(Size) - 1) / alignof(Size) * alignof(Size) - sizeof(Size) - sizeof(Key);
+
+    public:
+        // probe() compares the slot's key itself, and a match is the answer.
+        using fingerprint_type = Key;
+        static constexpr bool exact_match = true;
+
+        static constexpr Size max_elements = std::numeric_limits<Size>::max() - 1;
+
+    private:
+        // element + 1, 0 for empty, as in index_slot. the key of an empty slot is never read.
+        Size _element = 0;
+        // the tail a narrow key leaves is spelled out, so discrete_map::save() writes zeros there rather than whatever was in memory.
+        padded_key<Key, padding_bytes> _key;
+
+    public:
+        constexpr keyed_index_slot() noexcept = default;
+
+        constexpr keyed_index_slot(std::nullopt_t) noexcept {}
+
+        constexpr keyed_index_slot(Size element, Key key) noexcept
+            : _element(element + 1),
+              _key{key}
+        {}
+
+        static constexpr Key fingerprint_of(const Key& k, size_t) noexcept {
+            return k;
+        }
+
+        constexpr bool has_value() const noexcept {
+            return _element != 0;
+        }
+
+        // unchecked, unlike std::optional::value(). callers test has_value() first.
+        constexpr Size value() const noexcept {
+            return _element - 1;
+        }
+
+        constexpr const Key& key() const noexcept {
+            return _key.key;
+        }
+
+        // where the key sits within the slot, for kernels that read slots as raw words (batch_probe.h).
+        static constexpr size_t key_offset() noexcept {
+            return offsetof(keyed_index_slot, _key);
+        }
+
+        // true means the slot holds k.
+        constexpr bool may_match(const Key& k) const noexcept {
+            return _key.key == k;
+        }
+
+        // points the slot at another element holding the same key, e.g. after the element moved within the columns.
+        constexpr void relink(Size element) noexcept {
+            _element = element + 1;
+        }
+
+        constexpr keyed_index_slot& operator=(std::nullopt_t) noexcept {
+            _element = 0;
+            _key = {};
+            return *this;
+        }
+
+        friend constexpr bool operator==(const keyed_index_slot&, const keyed_index_slot&) = default;
+};
+
+/**
+ * which slot the index table is made of; discrete_map's IndexSlots parameter. `slot<Size, Key, Pred>` names the slot type.
+ *
+ * plain_index_slots, the default, always uses index_slot: 8 bytes a slot with a 64-bit Size.
+ */
+struct plain_index_slots {
+    template<class Size, class Key, class Pred>
+    using slot = index_slot<Size>;
+};
+
+/**
+ * keyed_index_slot for keys that key_fits_in_slot, index_slot for the rest.
+ *
+ * Opt in where lookups dominate and the index can afford twice the memory: probes of integer keys then stay in the table, and find_many() can use its SIMD kernel (batch_probe.h).
+ */
+struct keyed_index_slots {
+    template<class Size, class Key, class Pred>
+    using slot = std::conditional_t<key_fits_in_slot<Key, Pred>, keyed_index_slot<Size, Key>, index_slot<Size>>;
+};
+
+/**
+ * default index storage: a std::vector of slots. Growing allocates and zero-fills a whole new table.
+ *
+ * Every storage provides the same few operations: size(), data(), operator[], begin()/end(), memory_bytes(), and assign_empty(n), which leaves n empty slots and nothing else. HashPolicy builds everything else on those.
+ */
+template<class Slot>
+class heap_index_storage {
+    private:
+        std::vector<Slot> _slots;
+
+    public:
+        using value_type = Slot;
+        using size_type = size_t;
+
+        heap_index_storage() = default;
+
+        explicit heap_index_storage(size_type n)
+            : _slots(n)
+        {}
+
+        size_type size() const noexcept {
+            return _slots.size();
+        }
+
+        Slot* data() noexcept {
+            return _slots.data();
+        }
+
+        const Slot* data() const noexcept {
+            return _slots.data();
+        }
+
+        Slot& operator[](size_type i) noexcept {
+            return _slots[i];
+        }
+
+        const Slot& operator[](size_type i) const noexcept {
+            return _slots[i];
+        }
+
+        Slot* begin() noexcept {
+            return _slots.data();
+        }
+
+        Slot* end() noexcept {
+            return _slots.data() + _slots.size();
+        }
+
+        const Slot* begin() const noexcept {
+            return _slots.data();
+        }
+
+        const Slot* end() const noexcept {
+            return _slots.data() + _slots.size();
+        }
+
+        size_type memory_bytes() const noexcept {
+            return _slots.capacity() * sizeof(Slot);
+        }
+
+        void assign_empty(size_type n) {
+            _slots.assign(n, Slot());
+        }
+};
+
+/**
+ * index storage that reserves a large range of address space up front (MAP_NORESERVE) and never moves.
+ *
+ * Growing the table is then just a bigger size() over the same range. The slots of the old table are handed back to the kernel (madvise) rather than cleared, and the pages read back as zero, which is an empty slot. Only pages a slot actually gets written to are ever committed, so a table that grows many times never copies, never zero-fills, and costs memory in proportion to where elements landed rather than to its capacity.
+ *
+ * The reservation is sized from the table it's made for: growth_headroom times its size, so a table re-reserves only once every six doublings, and never more than MaxReservationBytes (16GB by default, against the 128TB a 64-bit process has). A map constructed or reserve()d for its expected size therefore reserves about what it will need, and a thousand small maps don't hold 16GB of address space each. Growing past the reservation releases it and reserves again, which costs an mmap but no copy, since the old table is being thrown away anyway. If the system won't reserve that much (vm.overcommit_memory=2, a ulimit on address space), it falls back to reserving just what's needed.
+ *
+ * Only on POSIX systems; elsewhere this is heap_index_storage.
+ *
+ * @arg MaxReservationBytes cap on the address space one table reserves. Bind it with an alias to pass the storage to discrete_map.
+ */
+template<class Slot, size_t MaxReservationBytes = size_t(1) << 34>
+class reserved_index_storage
+#if !(defined(__unix__) || defined(__APPLE__))
+    : public heap_index_storage<Slot> {
+    public:
+        using heap_index_storage<Slot>::heap_index_storage;
+};
+#else
+{
+    static_assert(std::is_trivially_copyable_v<Slot>, "reserved_index_storage: slots are read straight out of zero pages.");
+
+    public:
+        using value_type = Slot;
+        using size_type = size_t;
+
+        static constexpr size_type max_reservation_bytes = MaxReservationBytes;
+        // a table reserves room for this many times its own size.
+        static constexpr size_type growth_headroom = 64;
+
+    private:
+        Slot* _slots = nullptr;
+        size_type _size = 0;
+        // in slots.
+        size_type _reserved = 0;
+
+        // madvise isn't worth a syscall for a table this small; clearing it is faster.
+        static constexpr size_type discard_threshold_bytes = 64 * 1024;
+
+        static size_type page_round(size_type bytes) noexcept {
+            static const size_type page = static_cast<size_type>(sysconf(_SC_PAGESIZE));
+            return (bytes + page - 1) / page * page;
+        }
+
+        static Slot* map_slots(size_type slots) noexcept {
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+            flags |= MAP_NORESERVE;
+#endif
+            void* p = mmap(nullptr, page_round(std::max<size_type>(slots, 1) * sizeof(Slot)), PROT_READ | PROT_WRITE, flags, -1, 0);
+            return p == MAP_FAILED ? nullptr : static_cast<Slot*>(p);
+        }
+
+        // reserves room for at least `slots`, preferring growth_headroom times that up to the cap.
+        void reserve(size_type slots) {
+            const size_type ceiling = std::max(slots, max_reservation_bytes / sizeof(Slot));
+            const size_type preferred = slots > ceiling / growth_headroom ? ceiling : std::max<size_type>(slots, 1) * growth_headroom;
+            _slots = map_slots(preferred);
+            _reserved = preferred;
+            if (!_slots) {
+                _slots = map_slots(slots);
+                _reserved = slots;
+            }
+            if (!_slots) {
+                _reserved = 0;
+                throw std::bad_alloc();
+            }
+        }
+
+        void release() noexcept {
+            if (_slots) {
+                munmap(static_cast<void*>(_slots), page_round(std::max<size_type>(_reserved, 1) * sizeof(Slot)));
+            }
+            _slots = nullptr;
+            _size = 0;
+            _reserved = 0;
+        }
+
+        // empties the first _size slots.
+        void discard() noexcept {
+            const size_type bytes = _size * sizeof(Slot);
+#if defined(__linux__) && defined(MADV_DONTNEED)
+            // on Linux, private anonymous pages read back as zero after MADV_DONTNEED. other systems don't promise that.
+            if (bytes >= discard_threshold_bytes) {
+                madvise(static_cast<void*>(_slots), page_round(bytes), MADV_DONTNEED);
+                return;
+            }
+#endif
+            std::memset(static_cast<void*>(_slots), 0, bytes);
+        }
+
+    public:
+        reserved_index_storage()
+            : reserved_index_storage(0)
+        {}
+
+        explicit reserved_index_storage(size_type n) {
+            reserve(n);
+            _size = n;
+        }
+
+        reserved_index_storage(const reserved_index_storage& other)
+            : reserved_index_storage(other._size)
+        {
+            std::memcpy(static_cast<void*>(_slots), static_cast<const void*>(other._slots), other._size * sizeof(Slot));
+        }
+
+        reserved_index_storage(reserved_index_storage&& other) noexcept
+            : _slots(std::exchange(other._slots, nullptr)),
+              _size(std::exchange(other._size, 0)),
+              _reserved(std::exchange(other._reserved, 0))
+        {}
+
+        reserved_index_storage& operator=(const reserved_index_storage& other) {
+            if (this != &other) {
+                reserved_index_storage copy(other);
+                *this = std::move(copy);
+            }
+            return *this;
+        }
+
+        reserved_index_storage& operator=(reserved_index_storage&& other) noexcept {
+            if (this != &other) {
+                release();
+                _slots = std::exchange(other._slots, nullptr);
+                _size = std::exchange(other._size, 0);
+                _reserved = std::exchange(other._reserved, 0);
+            }
+            return *this;
+        }
+
+        ~reserved_index_storage() {
+            release();
+        }
+
+        size_type size() const noexcept {
+            return _size;
+        }
+
+        Slot* data() noexcept {
+            return _slots;
+        }
+
+        const Slot* data() const noexcept {
+            return _slots;
+        }
+
+        Slot& operator[](size_type i) noexcept {
+            return _slots[i];
+        }
+
+        const Slot& operator[](size_type i) const noexcept {
+            return _slots[i];
+        }
+
+        Slot* begin() noexcept {
+            return _slots;
+        }
+
+        Slot* end() noexcept {
+            return _slots + _size;
+        }
+
+        const Slot* begin() const noexcept {
+            return _slots;
+        }
+
+        const Slot* end() const noexcept {
+            return _slots + _size;
+        }
+
+        // an upper bound: pages no slot was ever written to aren't actually resident.
+        size_type memory_bytes() const noexcept {
+            return _size * sizeof(Slot);
+        }
+
+        // address space held, resident or not.
+        size_type reserved_bytes() const noexcept {
+            return _slots ? page_round(std::max<size_type>(_reserved, 1) * sizeof(Slot)) : 0;
+        }
+
+        void assign_empty(size_type n) {
+            if (n > _reserved) {
+                // outgrew a fallback reservation. the contents are being thrown away anyway, so there's nothing to carry over.
+                release();
+                reserve(n);
+            }
+            else {
+                discard();
+            }
+            _size = n;
+        }
+};
+#endif
+
+#endif
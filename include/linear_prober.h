@@ -12,14 +12,15 @@ class linear_prober {
         using size_type = typename SizeTraits::size_type;
         using indices_type = typename SizeTraits::indices_type;
 
-        using indices_collection_type = std::vector<indices_type>;
+        using indices_collection_type = typename SizeTraits::indices_collection_type;
 
-        template<bool is_const>
+        // Collection is anything indexable with a size(); a std::span over a mapped snapshot works as well as the storage a HashPolicy owns.
+        template<bool is_const, class Collection = indices_collection_type>
         class iterator_impl {
             private:
                 using inds_cltn_constness_type = typename std::conditional<is_const,
-                    const indices_collection_type,
-                    indices_collection_type
+                    const Collection,
+                    Collection
                 >::type;
 
                 using inds_t_constness_type = typename std::conditional<is_const,
@@ -40,11 +41,11 @@ class linear_prober {
                         _current = 0;
                     }
                 }
-                iterator_impl<is_const> operator+(size_type n) const {
+                iterator_impl operator+(size_type n) const {
                     size_type i = _current + n;
                     return i > _indices->size()
-                        ? iterator_impl<is_const>(i - _indices->size(), *_indices)
-                        : iterator_impl<is_const>(i, *_indices);
+                        ? iterator_impl(i - _indices->size(), *_indices)
+                        : iterator_impl(i, *_indices);
                 }
                 inds_t_constness_type& operator*() const {
                     return (*_indices)[_current];
@@ -61,25 +62,33 @@ class linear_prober {
         using const_iterator = iterator_impl<true>;
         using iterator = iterator_impl<false>;
 
-        iterator begin(indices_collection_type& indices) noexcept {
-            return iterator(0, indices);
+        template<class Collection>
+        iterator_impl<false, Collection> begin(Collection& indices) noexcept {
+            return iterator_impl<false, Collection>(0, indices);
         }
 
-        iterator end(indices_collection_type& indices) noexcept {
-            return iterator(indices.size(), indices);
+        template<class Collection>
+        iterator_impl<false, Collection> end(Collection& indices) noexcept {
+            return iterator_impl<false, Collection>(indices.size(), indices);
         }
 
-        const_iterator cbegin(const indices_collection_type& indices) const noexcept {
-            return const_iterator(0, indices);
+        template<class Collection>
+        iterator_impl<true, Collection> cbegin(const Collection& indices) const noexcept {
+            return iterator_impl<true, Collection>(0, indices);
         }
 
-        const_iterator cend(const indices_collection_type& indices) const noexcept {
-            return const_iterator(indices.size(), indices);
+        template<class Collection>
+        iterator_impl<true, Collection> cend(const Collection& indices) const noexcept {
+            return iterator_impl<true, Collection>(indices.size(), indices);
         }
 
         constexpr float threshold() const noexcept {
             return 0.5f;
         }
+
+        constexpr const char* name() const noexcept {
+            return "linear_prober";
+        }
 };
 
 #endif
@@ -0,0 +1,66 @@
+#ifndef MALLOC_ALLOCATOR_H
+#define MALLOC_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+/**
+ * allocator on top of malloc/free that also offers reallocate(), so a column of trivially relocatable elements grows with realloc().
+ *
+ * realloc can often extend the block in place, and for large blocks glibc moves pages with mremap rather than copying them.
+ */
+template<class T>
+class malloc_allocator {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "malloc only guarantees alignof(std::max_align_t)");
+
+    public:
+        using value_type = T;
+        using size_type = size_t;
+        using is_always_equal = std::true_type;
+
+        malloc_allocator() noexcept = default;
+
+        template<class U>
+        malloc_allocator(const malloc_allocator<U>&) noexcept {}
+
+        T* allocate(size_type n) {
+            if (n > std::numeric_limits<size_type>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            void* p = std::malloc(n * sizeof(T));
+            if (!p && n > 0) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(p);
+        }
+
+        void deallocate(T* p, size_type) noexcept {
+            std::free(p);
+        }
+
+        /**
+         * only valid for element types that are trivially relocatable; column checks that before calling it.
+         *
+         * @throws std::bad_alloc, in which case p is untouched
+         */
+        T* reallocate(T* p, size_type, size_type new_n) {
+            if (new_n > std::numeric_limits<size_type>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            void* grown = std::realloc(static_cast<void*>(p), new_n * sizeof(T));
+            if (!grown && new_n > 0) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(grown);
+        }
+
+        template<class U>
+        bool operator==(const malloc_allocator<U>&) const noexcept {
+            return true;
+        }
+};
+
+#endif
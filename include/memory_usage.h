@@ -0,0 +1,73 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * bytes an object owns outside itself, e.g. a long std::string's buffer. Zero unless specialised.
+ *
+ * Specialise `heap_usage<T>` with a static `bytes(const T&)` for value types that own memory; set `is_trivial = false` so discrete_map::memory_usage() knows it has to walk the column.
+ */
+template<class T, class = void>
+struct heap_usage {
+    static constexpr bool is_trivial = true;
+
+    static constexpr size_t bytes(const T&) noexcept {
+        return 0;
+    }
+};
+
+template<class CharT, class Traits, class Alloc>
+struct heap_usage<std::basic_string<CharT, Traits, Alloc>> {
+    static constexpr bool is_trivial = false;
+
+    static size_t bytes(const std::basic_string<CharT, Traits, Alloc>& str) noexcept {
+        // short strings live in the object itself. there's no portable way to ask, so check where the data points.
+        const auto* data = reinterpret_cast<const unsigned char*>(str.data());
+        const auto* self = reinterpret_cast<const unsigned char*>(std::addressof(str));
+        if (data >= self && data < self + sizeof(str)) {
+            return 0;
+        }
+        return (str.capacity() + 1) * sizeof(CharT);
+    }
+};
+
+template<class T, class Alloc>
+struct heap_usage<std::vector<T, Alloc>> {
+    static constexpr bool is_trivial = false;
+
+    static size_t bytes(const std::vector<T, Alloc>& vec) noexcept {
+        size_t total = vec.capacity() * sizeof(T);
+        if constexpr (!heap_usage<T>::is_trivial) {
+            for (const T& element : vec) {
+                total += heap_usage<T>::bytes(element);
+            }
+        }
+        return total;
+    }
+};
+
+/**
+ * what discrete_map::memory_usage() reports, in bytes.
+ */
+struct memory_usage_report {
+    // key and value columns at their full capacity, reserved-but-unused elements included.
+    size_t keys = 0;
+    size_t values = 0;
+    // the probe table, every slot whether occupied or not.
+    size_t indices = 0;
+    // memory the keys and values own out of line (see heap_usage).
+    size_t key_heap = 0;
+    size_t value_heap = 0;
+    // the part of keys + values reserved but not holding an element.
+    size_t slack = 0;
+
+    size_t total() const noexcept {
+        return keys + values + indices + key_heap + value_heap;
+    }
+};
+
+#endif
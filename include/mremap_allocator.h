@@ -0,0 +1,147 @@
+#ifndef MREMAP_ALLOCATOR_H
+#define MREMAP_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/**
+ * allocator for very large columns: big blocks are anonymous mappings that grow with mremap(MREMAP_MAYMOVE).
+ *
+ * Growing a mapping moves page table entries rather than bytes, so a column of trivially relocatable elements goes from n to 2n without copying n elements or holding both buffers at once. Blocks smaller than mapping_threshold bytes come from malloc, where a page-granular mapping would waste more than it saves; a block crossing the threshold is copied once, on the way up.
+ *
+ * Only Linux has mremap. Elsewhere this behaves like malloc_allocator.
+ */
+template<class T>
+class mremap_allocator {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "malloc only guarantees alignof(std::max_align_t)");
+
+    public:
+        using value_type = T;
+        using size_type = size_t;
+        using is_always_equal = std::true_type;
+
+        // 1MB. below this a block is malloc'd; at or above, mapped.
+        static constexpr size_type mapping_threshold = size_type(1) << 20;
+
+    private:
+        static size_type bytes_for(size_type n) {
+            if (n > std::numeric_limits<size_type>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            return n * sizeof(T);
+        }
+
+#ifdef __linux__
+        static bool is_mapped(size_type bytes) noexcept {
+            return bytes >= mapping_threshold;
+        }
+
+        static size_type page_round(size_type bytes) noexcept {
+            static const size_type page = static_cast<size_type>(sysconf(_SC_PAGESIZE));
+            return (bytes + page - 1) / page * page;
+        }
+
+        static void* map(size_type bytes) {
+            void* p = mmap(nullptr, page_round(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            advise(p, bytes);
+            return p;
+        }
+
+        // big columns are scanned end to end; transparent huge pages cut the TLB misses that costs. purely a hint.
+        static void advise([[maybe_unused]] void* p, [[maybe_unused]] size_type bytes) noexcept {
+#ifdef MADV_HUGEPAGE
+            madvise(p, page_round(bytes), MADV_HUGEPAGE);
+#endif
+        }
+#endif
+
+        static void* checked_malloc(size_type bytes) {
+            void* p = std::malloc(bytes);
+            if (!p && bytes > 0) {
+                throw std::bad_alloc();
+            }
+            return p;
+        }
+
+    public:
+        mremap_allocator() noexcept = default;
+
+        template<class U>
+        mremap_allocator(const mremap_allocator<U>&) noexcept {}
+
+        T* allocate(size_type n) {
+            const size_type bytes = bytes_for(n);
+#ifdef __linux__
+            if (is_mapped(bytes)) {
+                return static_cast<T*>(map(bytes));
+            }
+#endif
+            return static_cast<T*>(checked_malloc(bytes));
+        }
+
+        void deallocate(T* p, size_type n) noexcept {
+#ifdef __linux__
+            const size_type bytes = n * sizeof(T);
+            if (is_mapped(bytes)) {
+                munmap(static_cast<void*>(p), page_round(bytes));
+                return;
+            }
+#else
+            (void)n;
+#endif
+            std::free(static_cast<void*>(p));
+        }
+
+        /**
+         * only valid for element types that are trivially relocatable; column checks that before calling it.
+         *
+         * @throws std::bad_alloc, in which case p is untouched
+         */
+        T* reallocate(T* p, size_type old_n, size_type new_n) {
+            const size_type new_bytes = bytes_for(new_n);
+#ifdef __linux__
+            const size_type old_bytes = old_n * sizeof(T);
+            if (is_mapped(old_bytes) && is_mapped(new_bytes)) {
+                void* moved = mremap(static_cast<void*>(p), page_round(old_bytes), page_round(new_bytes), MREMAP_MAYMOVE);
+                if (moved == MAP_FAILED) {
+                    throw std::bad_alloc();
+                }
+                advise(moved, new_bytes);
+                return static_cast<T*>(moved);
+            }
+            if (is_mapped(old_bytes) != is_mapped(new_bytes)) {
+                // crossing the threshold either way changes who owns the block, so this one time it's a copy.
+                T* fresh = allocate(new_n);
+                std::memcpy(static_cast<void*>(fresh), static_cast<const void*>(p), old_bytes < new_bytes ? old_bytes : new_bytes);
+                deallocate(p, old_n);
+                return fresh;
+            }
+#else
+            (void)old_n;
+#endif
+            void* grown = std::realloc(static_cast<void*>(p), new_bytes);
+            if (!grown && new_bytes > 0) {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(grown);
+        }
+
+        template<class U>
+        bool operator==(const mremap_allocator<U>&) const noexcept {
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,451 @@
+#ifndef OPTIMISTIC_DISCRETE_MAP_H
+#define OPTIMISTIC_DISCRETE_MAP_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "concurrent_discrete_map.h"
+#include "discrete_map.h"
+#include "index_storage.h"
+
+/**
+ * a T that is only ever read and written with relaxed atomics, a word at a time.
+ *
+ * Seqlock readers run concurrently with the writer they validate against, so everything both of them touch has to be atomic on both sides or it's a data race, however the version check turns out. Copying a cell is therefore a word-by-word atomic load and store: lock-free for any trivially copyable T, and on x86 the same plain moves as before. A reader can still see a mix of two writes, which is what the version check is for.
+ */
+template<class T>
+class seqlock_cell {
+    static_assert(std::is_trivially_copyable_v<T>, "seqlock_cell: T is copied word by word, so it must be trivially copyable.");
+
+    private:
+        using word_type =
+            std::conditional_t<sizeof(T) % sizeof(std::uint64_t) == 0, std::uint64_t,
+            std::conditional_t<sizeof(T) % sizeof(std::uint32_t) == 0, std::uint32_t,
+            std::conditional_t<sizeof(T) % sizeof(std::uint16_t) == 0, std::uint16_t, unsigned char>>>;
+        static constexpr size_t word_count = sizeof(T) / sizeof(word_type);
+        using words_type = std::array<word_type, word_count>;
+
+        static_assert(std::atomic_ref<word_type>::is_always_lock_free, "seqlock_cell: needs lock-free atomic words.");
+
+        // written only through store(), including by the constructors, so nothing ever stores to them non-atomically.
+        word_type _words[word_count];
+
+        void store(const T& value) noexcept {
+            const words_type words = std::bit_cast<words_type>(value);
+            for (size_t i = 0; i < word_count; ++i) {
+                std::atomic_ref<word_type>(_words[i]).store(words[i], std::memory_order_relaxed);
+            }
+        }
+
+    public:
+        seqlock_cell() noexcept
+            requires std::default_initializable<T>
+        {
+            store(T{});
+        }
+
+        seqlock_cell(const T& value) noexcept {
+            store(value);
+        }
+
+        seqlock_cell(const seqlock_cell& other) noexcept {
+            store(other.load());
+        }
+
+        seqlock_cell& operator=(const seqlock_cell& other) noexcept {
+            store(other.load());
+            return *this;
+        }
+
+        T load() const noexcept {
+            words_type words;
+            for (size_t i = 0; i < word_count; ++i) {
+                // only ever loads, so the const_cast never writes to a const object.
+                words[i] = std::atomic_ref<word_type>(const_cast<word_type&>(_words[i])).load(std::memory_order_relaxed);
+            }
+            return std::bit_cast<T>(words);
+        }
+};
+
+/**
+ * index_slot whose every read and write is a relaxed atomic on the one word it is.
+ *
+ * HashPolicy and discrete_map use it like any other slot, so a writer changing the table in place never stores to a slot a reader could be loading.
+ */
+template<class Size>
+class seqlock_index_slot {
+    public:
+        using slot_type = index_slot<Size>;
+        using fingerprint_type = typename slot_type::fingerprint_type;
+        static constexpr bool exact_match = false;
+        static constexpr Size max_elements = slot_type::max_elements;
+
+        static_assert(std::atomic_ref<slot_type>::is_always_lock_free, "seqlock_index_slot: needs a lock-free slot-sized atomic.");
+
+    private:
+        alignas(std::atomic_ref<slot_type>::required_alignment) slot_type _slot;
+
+        void store(slot_type slot) noexcept {
+            std::atomic_ref<slot_type>(_slot).store(slot, std::memory_order_relaxed);
+        }
+
+    public:
+        // fresh slots are only ever constructed in a table no reader can see yet.
+        seqlock_index_slot() noexcept = default;
+
+        seqlock_index_slot(std::nullopt_t) noexcept {}
+
+        seqlock_index_slot(Size element, Size fingerprint) noexcept
+            : _slot(element, fingerprint)
+        {}
+
+        seqlock_index_slot(const seqlock_index_slot& other) noexcept
+            : _slot(other.load())
+        {}
+
+        seqlock_index_slot& operator=(const seqlock_index_slot& other) noexcept {
+            store(other.load());
+            return *this;
+        }
+
+        seqlock_index_slot& operator=(std::nullopt_t) noexcept {
+            store(slot_type());
+            return *this;
+        }
+
+        // one load of the whole slot. callers that test several things should take it once and ask the copy.
+        slot_type load() const noexcept {
+            return std::atomic_ref<slot_type>(const_cast<slot_type&>(_slot)).load(std::memory_order_relaxed);
+        }
+
+        static constexpr Size fingerprint_of(size_t hash) noexcept {
+            return slot_type::fingerprint_of(hash);
+        }
+
+        template<class Key>
+        static constexpr Size fingerprint_of(const Key&, size_t hash) noexcept {
+            return slot_type::fingerprint_of(hash);
+        }
+
+        bool has_value() const noexcept {
+            return load().has_value();
+        }
+
+        Size value() const noexcept {
+            return load().value();
+        }
+
+        Size fingerprint() const noexcept {
+            return load().fingerprint();
+        }
+
+        bool may_match(Size fingerprint) const noexcept {
+            return load().may_match(fingerprint);
+        }
+
+        // only the writer holding the shard's lock relinks, so load-then-store can't lose an update.
+        void relink(Size element) noexcept {
+            slot_type slot = load();
+            slot.relink(element);
+            store(slot);
+        }
+};
+
+// IndexSlots for the tables of optimistic_discrete_map.
+struct seqlock_index_slots {
+    template<class Size, class Key, class Pred>
+    using slot = seqlock_index_slot<Size>;
+};
+
+/**
+ * sharded discrete_map whose lookups take no lock at all.
+ *
+ * Each shard is a seqlock: writers are serialised by a per-shard mutex and make the version odd while they change the table in place. Readers look the key up in whatever they see, then check the version didn't move; if it did they simply retry. A reader never writes shared memory, so read-mostly workloads don't bounce cache lines between cores.
+ *
+ * Keys, values and index slots are stored as seqlock_cell and seqlock_index_slot, so the writer's stores and the reader's loads are all relaxed atomics and the overlap is a benign race rather than undefined behaviour. A reader also never trusts what it loaded: it walks at most one table's worth of slots and ignores element indices past the columns, so a torn table can only make it retry.
+ *
+ * In-place writes are only safe while no column or index reallocates underneath a reader. Each table is therefore reserved ahead of time, and a write that would exceed the reservation copies the shard into a bigger table and swaps the pointer instead. The old table is retired rather than freed, since a reader may still be walking it, and retired tables are only freed with the map. Because reservations double, the retired tables of a shard never add up to more than its live one.
+ *
+ * Readers copy keys and values out of memory that may be mid-write, so both must be trivially copyable.
+ */
+template<class Key,
+         class T,
+         class Hash = std::hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class KeyAllocator = std::allocator<Key>,
+         class ValueAllocator = std::allocator<T>,
+         class Growth = BitwiseGrowthPolicy,
+         template<class> class Probe = linear_prober>
+class optimistic_discrete_map {
+    static_assert(std::is_trivially_copyable_v<Key>, "optimistic_discrete_map: readers copy keys while a writer may be changing them, so Key must be trivially copyable.");
+    static_assert(std::is_trivially_copyable_v<T>, "optimistic_discrete_map: readers copy values while a writer may be changing them, so T must be trivially copyable.");
+    static_assert(!layout_growth_policy<Growth>, "optimistic_discrete_map: a layout_growth_policy can rebuild the index at any insert, not just when the reservation runs out.");
+
+    public:
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<const Key, T>;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = size_t;
+
+    private:
+        using key_cell = seqlock_cell<Key>;
+        using value_cell = seqlock_cell<T>;
+
+        struct cell_hash {
+            size_t operator()(const key_cell& k) const {
+                return hasher()(k.load());
+            }
+        };
+
+        struct cell_equal {
+            bool operator()(const key_cell& a, const key_cell& b) const {
+                return key_equal()(a.load(), b.load());
+            }
+        };
+
+        using map_type = discrete_map<key_cell, value_cell, cell_hash, cell_equal,
+            typename std::allocator_traits<KeyAllocator>::template rebind_alloc<key_cell>,
+            typename std::allocator_traits<ValueAllocator>::template rebind_alloc<value_cell>,
+            Growth, Probe, NullStatsPolicy, heap_index_storage, seqlock_index_slots>;
+
+        using slot_type = typename map_type::index_slot_type;
+        using prober_type = Probe<typename map_type::size_traits>;
+
+        struct shard {
+            // everything a reader touches sits on this line, and writers only store to it twice per write.
+            alignas(64) std::atomic<std::uint64_t> version{0};
+            std::atomic<map_type*> table{nullptr};
+
+            // writer-only state lives on its own line so that taking the lock doesn't invalidate the readers' copy of the one above.
+            alignas(64) std::mutex writer;
+            std::unique_ptr<map_type> current;
+            size_type reserved = 0;
+            std::vector<std::unique_ptr<map_type>> retired;
+            // size() reads this rather than the table, whose element count a writer changes in place.
+            std::atomic<size_type> count{0};
+        };
+
+        std::unique_ptr<shard[]> _shards;
+        size_type _shard_count;
+        unsigned _shard_bits;
+
+        size_type shard_of(const key_type& k) const {
+            return shard_index(hasher()(k), _shard_bits);
+        }
+
+        static void begin_write(shard& sh) noexcept {
+            const std::uint64_t v = sh.version.load(std::memory_order_relaxed);
+            sh.version.store(v + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        static void end_write(shard& sh) noexcept {
+            const std::uint64_t v = sh.version.load(std::memory_order_relaxed);
+            sh.version.store(v + 1, std::memory_order_release);
+        }
+
+        // must hold sh.writer. makes sure the table can take one more element without reallocating.
+        static map_type& writable_table(shard& sh) {
+            if (sh.current->size() + 1 <= sh.reserved) {
+                return *sh.current;
+            }
+
+            const size_type next_reserved = std::max<size_type>(sh.reserved * 2, 8);
+
+            // readers never see the copy until it's complete, so none of this needs the version bumped.
+            auto bigger = std::make_unique<map_type>(*sh.current);
+            bigger->reserve(next_reserved);
+
+            sh.table.store(bigger.get(), std::memory_order_release);
+            sh.retired.push_back(std::move(sh.current));
+            sh.current = std::move(bigger);
+            sh.reserved = next_reserved;
+
+            return *sh.current;
+        }
+
+        /**
+         * seqlock read. `read(table)` runs against a possibly inconsistent table and its result is only returned once the version confirms no writer overlapped it.
+         */
+        template<class Callable>
+        auto optimistic_read(const shard& sh, Callable&& read) const {
+            while (true) {
+                const std::uint64_t before = sh.version.load(std::memory_order_acquire);
+                if (before & 1u) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const map_type* table = sh.table.load(std::memory_order_acquire);
+                auto result = read(*table);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sh.version.load(std::memory_order_relaxed) == before) {
+                    return result;
+                }
+            }
+        }
+
+        /**
+         * looks k up in a table a writer may be changing in place.
+         *
+         * The index and the columns never move while writes stay in place, so their addresses and capacities are safe to read; everything in them is loaded atomically. A slot pointing past the columns or a walk that finds no empty slot can only come from a torn read, and whatever this returns then is thrown away by the version check.
+         */
+        static std::optional<mapped_type> read_value(const map_type& table, const key_type& k, size_t hash) {
+            const std::span<const slot_type> slots(table._hash_pol.data(), table._hash_pol.size());
+            const size_type elements = std::min(table._keys.capacity(), table._values.capacity());
+            const auto fingerprint = slot_type::fingerprint_of(hash);
+
+            prober_type prober;
+            auto it = prober.cbegin(slots) + table._growth_pol.get_index(slots.size(), hash);
+            for (size_type step = 0; step < slots.size(); ++step, ++it) {
+                const auto slot = (*it).load();
+                if (!slot.has_value()) {
+                    return std::nullopt;
+                }
+                const size_type element = slot.value();
+                if (slot.may_match(fingerprint) && element < elements && key_equal()(table._keys[element].load(), k)) {
+                    return table._values[element].load();
+                }
+            }
+            return std::nullopt;
+        }
+
+    public:
+//construct/copy/destroy
+
+        /**
+         * @arg shard_count number of shards. Must be a non-zero power of two.
+         * @arg initial_reservation elements each shard can hold before its first copy-and-swap.
+         */
+        explicit optimistic_discrete_map(size_type shard_count = 64, size_type initial_reservation = 64)
+            : _shards(),
+              _shard_count(shard_count),
+              _shard_bits(0)
+        {
+            if (shard_count == 0 || (shard_count & (shard_count - 1)) != 0) {
+                throw std::invalid_argument("optimistic_discrete_map: shard count must be a non-zero power of two.");
+            }
+            while ((size_type{1} << _shard_bits) < shard_count) {
+                ++_shard_bits;
+            }
+
+            _shards.reset(new shard[shard_count]);
+            for (size_type s = 0; s < shard_count; ++s) {
+                _shards[s].current = std::make_unique<map_type>();
+                _shards[s].current->reserve(initial_reservation);
+                _shards[s].reserved = initial_reservation;
+                _shards[s].table.store(_shards[s].current.get(), std::memory_order_release);
+            }
+        }
+
+        optimistic_discrete_map(const optimistic_discrete_map&) = delete;
+        optimistic_discrete_map& operator=(const optimistic_discrete_map&) = delete;
+
+        // no reader can be in flight once the map itself is going away, so this is where retired tables are freed.
+        ~optimistic_discrete_map() = default;
+
+//capacity
+
+        size_type shard_count() const noexcept {
+            return _shard_count;
+        }
+
+        // not a snapshot across shards if writers are active.
+        size_type size() const noexcept {
+            size_type total = 0;
+            for (size_type s = 0; s < _shard_count; ++s) {
+                total += _shards[s].count.load(std::memory_order_relaxed);
+            }
+            return total;
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            return size() == 0;
+        }
+
+//modifiers
+
+        bool insert(const value_type& obj) {
+            shard& sh = _shards[shard_of(obj.first)];
+            std::lock_guard lock(sh.writer);
+
+            if (sh.current->contains(obj.first)) {
+                return false;
+            }
+
+            map_type& table = writable_table(sh);
+            begin_write(sh);
+            table.insert(obj);
+            end_write(sh);
+            sh.count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        /**
+         * @return true if the key was newly inserted, false if an existing value was overwritten.
+         */
+        bool insert_or_assign(const key_type& k, const mapped_type& obj) {
+            shard& sh = _shards[shard_of(k)];
+            std::lock_guard lock(sh.writer);
+
+            const bool inserted = !sh.current->contains(k);
+            map_type& table = inserted ? writable_table(sh) : *sh.current;
+
+            begin_write(sh);
+            table[k] = obj;
+            end_write(sh);
+            if (inserted) {
+                sh.count.fetch_add(1, std::memory_order_relaxed);
+            }
+            return inserted;
+        }
+
+        bool erase(const key_type& k) {
+            shard& sh = _shards[shard_of(k)];
+            std::lock_guard lock(sh.writer);
+
+            if (!sh.current->contains(k)) {
+                return false;
+            }
+
+            // erase only moves elements down within the existing allocation, so it can stay in place.
+            begin_write(sh);
+            sh.current->erase(k);
+            end_write(sh);
+            sh.count.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+//map operations
+
+        std::optional<mapped_type> find(const key_type& k) const {
+            const size_t hash = hasher()(k);
+            return optimistic_read(_shards[shard_index(hash, _shard_bits)], [&k, hash](const map_type& table) {
+                return read_value(table, k, hash);
+            });
+        }
+
+        bool contains(const key_type& k) const {
+            return find(k).has_value();
+        }
+};
+
+#endif
@@ -0,0 +1,602 @@
+#ifndef SMALL_DISCRETE_MAP_H
+#define SMALL_DISCRETE_MAP_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "BitwiseGrowthPolicy.h"
+#include "cpu_dispatch.h"
+#include "discrete_map.h"
+#include "linear_prober.h"
+
+// SSE2 is the x86-64 baseline, so the key scan needs no dispatch. see cpu_dispatch.h.
+#ifdef DISCRETE_MAP_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+/**
+ * up to N elements stored in place, densely, in insertion order until something is erased.
+ *
+ * Trivial types live in a zeroed array padded to a whole number of 16-byte vectors, so every slot can be read whether it's in use or not; that's what lets small_discrete_map compare keys a vector at a time without a bounds check. Anything else lives in raw storage and is constructed on demand.
+ */
+template<class T, size_t N>
+class inline_column {
+    public:
+        static constexpr bool trivial = std::is_trivial_v<T>;
+
+        // slots actually allocated: N, or for trivial T enough more to fill the last 16-byte vector.
+        static constexpr size_t padded_slots = trivial ? ((N * sizeof(T) + 15) / 16 * 16 + sizeof(T) - 1) / sizeof(T) : N;
+
+    private:
+        struct raw_storage {
+            alignas(T) std::byte bytes[N * sizeof(T)];
+        };
+
+        std::conditional_t<trivial, T[padded_slots], raw_storage> _storage;
+        size_t _size = 0;
+
+        T* slots() noexcept {
+            if constexpr (trivial) {
+                return _storage;
+            }
+            else {
+                return std::launder(reinterpret_cast<T*>(_storage.bytes));
+            }
+        }
+
+        const T* slots() const noexcept {
+            if constexpr (trivial) {
+                return _storage;
+            }
+            else {
+                return std::launder(reinterpret_cast<const T*>(_storage.bytes));
+            }
+        }
+
+    public:
+        inline_column() noexcept {
+            if constexpr (trivial) {
+                std::fill_n(_storage, padded_slots, T());
+            }
+        }
+
+        inline_column(const inline_column& other)
+            : inline_column()
+        {
+            for (const T& element : other.span()) {
+                push_back(element);
+            }
+        }
+
+        inline_column(inline_column&& other) noexcept(std::is_nothrow_move_constructible_v<T>)
+            : inline_column()
+        {
+            for (T& element : other.span()) {
+                push_back(std::move(element));
+            }
+            other.clear();
+        }
+
+        inline_column& operator=(const inline_column& other) {
+            if (this != &other) {
+                clear();
+                for (const T& element : other.span()) {
+                    push_back(element);
+                }
+            }
+            return *this;
+        }
+
+        inline_column& operator=(inline_column&& other) noexcept(std::is_nothrow_move_constructible_v<T>) {
+            if (this != &other) {
+                clear();
+                for (T& element : other.span()) {
+                    push_back(std::move(element));
+                }
+                other.clear();
+            }
+            return *this;
+        }
+
+        ~inline_column() {
+            clear();
+        }
+
+        size_t size() const noexcept {
+            return _size;
+        }
+
+        // all padded_slots slots, used or not. only for trivial T, where the unused ones are zero.
+        const T* all_slots() const noexcept
+            requires trivial
+        {
+            return _storage;
+        }
+
+        std::span<T> span() noexcept {
+            return {slots(), _size};
+        }
+
+        std::span<const T> span() const noexcept {
+            return {slots(), _size};
+        }
+
+        T& operator[](size_t i) noexcept {
+            return slots()[i];
+        }
+
+        const T& operator[](size_t i) const noexcept {
+            return slots()[i];
+        }
+
+        template<class... Args>
+        T& emplace_back(Args&&... args) {
+            T* slot = slots() + _size;
+            std::construct_at(slot, std::forward<Args>(args)...);
+            ++_size;
+            return *slot;
+        }
+
+        void push_back(const T& value) {
+            emplace_back(value);
+        }
+
+        void push_back(T&& value) {
+            emplace_back(std::move(value));
+        }
+
+        void pop_back() noexcept {
+            --_size;
+            if constexpr (trivial) {
+                // the scan reads every slot, so a freed one has to go back to zero.
+                slots()[_size] = T();
+            }
+            else {
+                std::destroy_at(slots() + _size);
+            }
+        }
+
+        // same as column::erase_by_swap(): the last element fills the hole.
+        void erase_by_swap(size_t i) {
+            if (i != _size - 1) {
+                slots()[i] = std::move(slots()[_size - 1]);
+            }
+            pop_back();
+        }
+
+        void clear() noexcept {
+            while (_size > 0) {
+                pop_back();
+            }
+        }
+};
+
+#ifdef DISCRETE_MAP_HAS_SSE2
+/**
+ * bit i set for each of slots[0, count) equal to k, compared 16 bytes at a time. count * sizeof(Key) must be a multiple of 16.
+ */
+template<class Key>
+std::uint64_t small_map_match_mask(const Key* slots, size_t count, Key k) noexcept {
+    static_assert(sizeof(Key) == 1 || sizeof(Key) == 2 || sizeof(Key) == 4 || sizeof(Key) == 8);
+    constexpr size_t lanes = 16 / sizeof(Key);
+
+    __m128i needle;
+    if constexpr (sizeof(Key) == 1) {
+        needle = _mm_set1_epi8(static_cast<char>(k));
+    }
+    else if constexpr (sizeof(Key) == 2) {
+        needle = _mm_set1_epi16(static_cast<short>(k));
+    }
+    else if constexpr (sizeof(Key) == 4) {
+        needle = _mm_set1_epi32(static_cast<int>(k));
+    }
+    else {
+        needle = _mm_set1_epi64x(static_cast<long long>(k));
+    }
+
+    std::uint64_t matches = 0;
+    for (size_t i = 0; i < count; i += lanes) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(slots + i));
+        std::uint64_t bits;
+        if constexpr (sizeof(Key) == 1) {
+            bits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+        }
+        else if constexpr (sizeof(Key) == 2) {
+            // narrow the 16-bit lane masks to bytes so movemask gives one bit per key.
+            bits = static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(v, needle), _mm_setzero_si128())));
+        }
+        else if constexpr (sizeof(Key) == 4) {
+            bits = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, needle))));
+        }
+        else {
+            // SSE2 has no 64-bit compare: both 32-bit halves have to match.
+            const __m128i halves = _mm_cmpeq_epi32(v, needle);
+            const __m128i both = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+            bits = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(both)));
+        }
+        matches |= bits << i;
+    }
+    return matches;
+}
+#endif
+
+/**
+ * discrete_map for maps that are usually tiny: the first N elements are kept inline and found by a linear scan, with no allocation and no hashing.
+ *
+ * Inserting element N + 1 moves everything into a discrete_map (built with room for 2N) and from then on every operation is that map's. It doesn't move back when elements are erased; clear() keeps the big map too, along with the capacity it has already paid for.
+ *
+ * On x86, integral keys compared with std::equal_to are scanned with SSE2, which is always there on x86-64: the key is compared against a whole vector of slots at once and the matches collected in a bitmask, so 16 int keys take four compares and no branches. N is at most 64 for that path. Everything else is an ordinary loop over the elements in use.
+ */
+template<class Key,
+         class T,
+         size_t N = 16,
+         class Hash = std::hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class KeyAllocator = std::allocator<Key>,
+         class ValueAllocator = std::allocator<T>,
+         class Growth = BitwiseGrowthPolicy,
+         template<class> class Probe = linear_prober>
+class small_discrete_map {
+    static_assert(N > 0, "small_discrete_map: N has to be at least 1.");
+
+    public:
+        // types
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<const Key, T>;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = size_t;
+
+        // what the map becomes past N elements.
+        using large_map_type = discrete_map<Key, T, Hash, Pred, KeyAllocator, ValueAllocator, Growth, Probe>;
+
+        static constexpr size_type inline_capacity = N;
+
+    private:
+#ifdef DISCRETE_MAP_HAS_SSE2
+        static constexpr bool mask_scan = std::is_integral_v<Key> && std::is_same_v<Pred, std::equal_to<Key>> && inline_column<Key, N>::padded_slots <= 64;
+#else
+        static constexpr bool mask_scan = false;
+#endif
+
+        inline_column<key_type, N> _small_keys;
+        inline_column<mapped_type, N> _small_values;
+
+        // engaged once the map outgrows N, and then for good.
+        std::optional<large_map_type> _large;
+
+        static constexpr size_type npos = static_cast<size_type>(-1);
+
+        // position of k among the inline elements, or npos.
+        size_type small_find(const key_type& k) const {
+            if constexpr (mask_scan) {
+                std::uint64_t matches = small_map_match_mask(_small_keys.all_slots(), inline_column<Key, N>::padded_slots, k);
+                // the unused slots are zero and would match a zero key.
+                const size_type used = _small_keys.size();
+                matches &= used == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << used) - 1;
+                return matches == 0 ? npos : static_cast<size_type>(std::countr_zero(matches));
+            }
+            else {
+                for (size_type i = 0; i < _small_keys.size(); ++i) {
+                    if (key_eq()(k, _small_keys[i])) {
+                        return i;
+                    }
+                }
+                return npos;
+            }
+        }
+
+        // position of k in the discrete_map's columns, or npos. iterators here are positions, which discrete_map's own iterators don't expose, but find_many() does.
+        size_type large_find(const key_type& k) const {
+            size_type found = npos;
+            _large->find_many(std::span<const key_type>(&k, 1), std::span<size_type>(&found, 1));
+            return found == large_map_type::npos ? npos : found;
+        }
+
+        // moves the inline elements into a discrete_map with room for at least `capacity`.
+        void spill(size_type capacity) {
+            large_map_type large(capacity);
+            for (size_type i = 0; i < _small_keys.size(); ++i) {
+                // the inline copies are cleared right after, so the values can be moved out; that's what lets T be move-only.
+                large.upsert(_small_keys[i], [this, i]() -> mapped_type&& { return std::move(_small_values[i]); }, [](mapped_type&) {});
+            }
+            _large.emplace(std::move(large));
+            _small_keys.clear();
+            _small_values.clear();
+        }
+
+        // appends to the inline columns, spilling first if they're full. returns the new element's value.
+        template<class MakeValue>
+        mapped_type& append(const key_type& k, MakeValue&& make_value) {
+            if (_small_keys.size() == N) {
+                spill(2 * N);
+                _large->upsert(k, std::forward<MakeValue>(make_value), [](mapped_type&) {});
+                // happens once in the map's life, so looking the element up again costs nothing worth saving.
+                return _large->at(k);
+            }
+            _small_keys.push_back(k);
+            try {
+                _small_values.emplace_back(std::forward<MakeValue>(make_value)());
+            }
+            catch (...) {
+                _small_keys.pop_back();
+                throw;
+            }
+            return _small_values[_small_values.size() - 1];
+        }
+
+        class const_iterator_impl {
+            private:
+                const small_discrete_map* _map = nullptr;
+                size_type _index = 0;
+
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = small_discrete_map::value_type;
+                using difference_type = std::ptrdiff_t;
+
+                const_iterator_impl() = default;
+
+                const_iterator_impl(const small_discrete_map& map, size_type i) noexcept
+                    : _map(&map),
+                      _index(i)
+                {}
+
+                // dereference
+                const value_type operator*() const {
+                    return {_map->keys()[_index], _map->values()[_index]};
+                }
+
+                const_iterator_impl& operator++() noexcept {
+                    ++_index;
+                    return *this;
+                }
+
+                const_iterator_impl operator++(int) noexcept {
+                    const_iterator_impl temp = *this;
+                    ++_index;
+                    return temp;
+                }
+
+                const_iterator_impl operator+(size_type n) const noexcept {
+                    return const_iterator_impl(*_map, _index + n);
+                }
+
+                bool operator==(const const_iterator_impl& other) const noexcept {
+                    return _index == other._index;
+                }
+        };
+
+    public:
+        using const_iterator = const_iterator_impl;
+        using iterator = const_iterator;
+
+//construct/copy/destroy
+
+        small_discrete_map() noexcept = default;
+
+        template<std::input_iterator InputIterator>
+        small_discrete_map(InputIterator first, InputIterator last) {
+            insert(first, last);
+        }
+
+        small_discrete_map(std::initializer_list<value_type> il)
+            : small_discrete_map(il.begin(), il.end())
+        {}
+
+//iterators
+
+        const_iterator begin() const noexcept {
+            return const_iterator(*this, 0);
+        }
+
+        const_iterator end() const noexcept {
+            return const_iterator(*this, size());
+        }
+
+        const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        const_iterator cend() const noexcept {
+            return end();
+        }
+
+//getters
+
+        // dense in both modes; in the same order as values().
+        std::span<const key_type> keys() const noexcept {
+            if (_large) {
+                return {_large->keys().data(), _large->size()};
+            }
+            return _small_keys.span();
+        }
+
+        std::span<const mapped_type> values() const noexcept {
+            if (_large) {
+                return {_large->values().data(), _large->size()};
+            }
+            return _small_values.span();
+        }
+
+        // true while the elements still live inside the object.
+        bool is_inline() const noexcept {
+            return !_large;
+        }
+
+//capacity
+
+        [[nodiscard]] bool empty() const noexcept {
+            return size() == 0;
+        }
+
+        size_type size() const noexcept {
+            return _large ? _large->size() : _small_keys.size();
+        }
+
+//modifiers
+
+        std::pair<iterator, bool> insert(const value_type& obj) {
+            if (_large) {
+                // a new element goes on the end; only a duplicate has to be looked up again to say where it is.
+                const bool inserted = _large->insert(obj).second;
+                return {begin() + (inserted ? size() - 1 : large_find(obj.first)), inserted};
+            }
+            const size_type found = small_find(obj.first);
+            if (found != npos) {
+                return {begin() + found, false};
+            }
+            append(obj.first, [&obj]() -> const mapped_type& { return obj.second; });
+            return {begin() + (size() - 1), true};
+        }
+
+        template<class P>
+            requires (std::constructible_from<value_type, P&&> && !std::same_as<std::remove_cvref_t<P>, value_type>)
+        std::pair<iterator, bool> insert(P&& obj) {
+            return insert(value_type(std::forward<P>(obj)));
+        }
+
+        template<std::input_iterator InputIterator>
+        void insert(InputIterator first, InputIterator last) {
+            for (auto it = first; it != last; ++it) {
+                insert(value_type(*it));
+            }
+        }
+
+        template<class... Args>
+        std::pair<iterator, bool> emplace(Args&&... args) {
+            return insert(value_type(std::forward<Args>(args)...));
+        }
+
+        bool erase(const key_type& k) {
+            if (_large) {
+                return _large->erase(k);
+            }
+            const size_type found = small_find(k);
+            if (found == npos) {
+                return false;
+            }
+            _small_keys.erase_by_swap(found);
+            _small_values.erase_by_swap(found);
+            return true;
+        }
+
+        void clear() noexcept {
+            if (_large) {
+                _large->clear();
+            }
+            _small_keys.clear();
+            _small_values.clear();
+        }
+
+//observers
+
+        key_equal key_eq() const {
+            return key_equal();
+        }
+
+        hasher hash_function() const {
+            return hasher();
+        }
+
+//map operations
+
+        const_iterator find(const key_type& k) const {
+            const size_type found = _large ? large_find(k) : small_find(k);
+            return found == npos ? end() : begin() + found;
+        }
+
+        bool contains(const key_type& k) const {
+            return _large ? _large->contains(k) : small_find(k) != npos;
+        }
+
+        size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+//element access
+
+        mapped_type& operator[](const key_type& k) {
+            if (_large) {
+                return (*_large)[k];
+            }
+            const size_type found = small_find(k);
+            if (found != npos) {
+                return _small_values[found];
+            }
+            return append(k, [] { return mapped_type{}; });
+        }
+
+        const mapped_type& at(const key_type& k) const {
+            if (_large) {
+                return _large->at(k);
+            }
+            const size_type found = small_find(k);
+            if (found == npos) {
+                throw std::out_of_range("small_discrete_map::at() const thrown exception: key out of range.");
+            }
+            return _small_values[found];
+        }
+
+        mapped_type& at(const key_type& k) {
+            return const_cast<mapped_type&>(std::as_const(*this).at(k));
+        }
+
+        // see discrete_map::visit().
+        template<class Callable>
+        bool visit(const key_type& k, Callable&& f) {
+            if (_large) {
+                return _large->visit(k, std::forward<Callable>(f));
+            }
+            const size_type found = small_find(k);
+            if (found == npos) {
+                return false;
+            }
+            std::forward<Callable>(f)(_small_values[found]);
+            return true;
+        }
+
+        // see discrete_map::upsert().
+        template<class MakeValue, class UpdateValue>
+        bool upsert(const key_type& k, MakeValue&& make_value, UpdateValue&& update_value) {
+            if (_large) {
+                return _large->upsert(k, std::forward<MakeValue>(make_value), std::forward<UpdateValue>(update_value));
+            }
+            const size_type found = small_find(k);
+            if (found != npos) {
+                std::forward<UpdateValue>(update_value)(_small_values[found]);
+                return false;
+            }
+            append(k, std::forward<MakeValue>(make_value));
+            return true;
+        }
+
+//hash policy
+
+        /**
+         * makes room for n elements. Past N that means moving to the discrete_map now rather than on the insert that needs it.
+         */
+        void reserve(size_type n) {
+            if (_large) {
+                _large->reserve(n);
+            }
+            else if (n > N) {
+                spill(n);
+            }
+        }
+};
+
+#endif
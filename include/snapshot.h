@@ -0,0 +1,341 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+// On-disk layout shared by discrete_map::save()/load() and anything that wants to read a snapshot in place.
+//
+//   snapshot_header
+//   key column     (raw: aligned to snapshot_alignment, element after element)
+//   value column   (same)
+//   index table    (always raw, aligned when everything before it was raw)
+//
+// A column whose type isn't trivially copyable is written element by element through snapshot_codec instead. Its length is then unknown up front, so every section after it has an offset of 0, meaning "follows immediately".
+
+inline constexpr char snapshot_magic[8] = {'D', 'M', 'A', 'P', 'S', 'N', 'A', 'P'};
+// 2: index slots are index_slot (element + 1, 0 for empty) rather than std::optional.
+// 3: 64-bit index slots carry a hash fingerprint in their top 16 bits.
+// 4: integer, enum and pointer keys are copied into their index slots (keyed_index_slot).
+// 5: growth_state, for growth policies whose mapping depends on the keys (DirectAddressGrowthPolicy).
+inline constexpr std::uint32_t snapshot_version = 5;
+inline constexpr std::uint32_t snapshot_byte_order = 0x01020304u;
+inline constexpr std::uint64_t snapshot_alignment = 64;
+
+enum snapshot_flags : std::uint32_t {
+    snapshot_raw_keys = 1u << 0,
+    snapshot_raw_values = 1u << 1,
+};
+
+struct snapshot_header {
+    char magic[8];
+    std::uint32_t version;
+    // snapshot_byte_order as the producer saw it. A mismatch means the file came from a machine of the other endianness.
+    std::uint32_t byte_order;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+
+    std::uint64_t key_size;
+    std::uint64_t value_size;
+    std::uint64_t slot_size;
+
+    std::uint64_t element_count;
+    std::uint64_t index_capacity;
+
+    std::uint64_t hash_seed;
+    // hash of the first key. catches a hasher that changed between producer and consumer even when it has no seed to compare.
+    std::uint64_t hash_check;
+    // a layout_growth_policy's state(); zero for any other policy.
+    std::uint64_t growth_state[2];
+
+    // byte offsets from the start of the snapshot. 0 means the section follows the previous one directly.
+    std::uint64_t keys_offset;
+    std::uint64_t values_offset;
+    std::uint64_t indices_offset;
+
+    char growth_policy[32];
+    char probe_policy[32];
+};
+
+static_assert(std::is_trivially_copyable_v<snapshot_header>);
+
+inline constexpr std::uint64_t snapshot_align(std::uint64_t position) noexcept {
+    return (position + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+}
+
+inline void snapshot_set_name(char (&field)[32], const char* name) noexcept {
+    std::memset(field, 0, sizeof(field));
+    std::strncpy(field, name, sizeof(field) - 1);
+}
+
+inline bool snapshot_name_equals(const char (&field)[32], const char* name) noexcept {
+    return std::strncmp(field, name, sizeof(field)) == 0;
+}
+
+/**
+ * customisation point for element types that can't be dumped as raw bytes.
+ *
+ * Specialise with `static void write(std::ostream&, const T&)` and `static T read(std::istream&)`. Trivially copyable types never go through here.
+ */
+template<class T>
+struct snapshot_codec;
+
+template<class CharT, class Traits, class Allocator>
+struct snapshot_codec<std::basic_string<CharT, Traits, Allocator>> {
+    using string_type = std::basic_string<CharT, Traits, Allocator>;
+
+    static void write(std::ostream& os, const string_type& str) {
+        const std::uint64_t length = str.size();
+        os.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        os.write(reinterpret_cast<const char*>(str.data()), static_cast<std::streamsize>(length * sizeof(CharT)));
+    }
+
+    static string_type read(std::istream& is) {
+        std::uint64_t length = 0;
+        is.read(reinterpret_cast<char*>(&length), sizeof(length));
+        string_type str(static_cast<size_t>(length), CharT());
+        is.read(reinterpret_cast<char*>(str.data()), static_cast<std::streamsize>(length * sizeof(CharT)));
+        return str;
+    }
+};
+
+/**
+ * sequential writer that keeps track of its position so raw sections can be aligned.
+ */
+class snapshot_writer {
+    private:
+        std::ostream* _os;
+        std::uint64_t _position = 0;
+        bool _position_known = true;
+
+    public:
+        explicit snapshot_writer(std::ostream& os)
+            : _os(&os)
+        {}
+
+        bool position_known() const noexcept {
+            return _position_known;
+        }
+
+        std::uint64_t position() const noexcept {
+            return _position;
+        }
+
+        void write_raw(const void* data, std::uint64_t n) {
+            _os->write(static_cast<const char*>(data), static_cast<std::streamsize>(n));
+            _position += n;
+        }
+
+        // zero-fills up to `offset`. an offset of 0 means the section isn't aligned.
+        void pad_to(std::uint64_t offset) {
+            static constexpr char zeros[snapshot_alignment] = {};
+            if (offset == 0 || !_position_known) {
+                return;
+            }
+            write_raw(zeros, offset - _position);
+        }
+
+        template<class T>
+        void write_element(const T& obj) {
+            snapshot_codec<T>::write(*_os, obj);
+            _position_known = false;
+        }
+
+        bool good() const {
+            return _os->good();
+        }
+};
+
+class snapshot_reader {
+    private:
+        std::istream* _is;
+        std::uint64_t _position = 0;
+        bool _position_known = true;
+
+    public:
+        explicit snapshot_reader(std::istream& is)
+            : _is(&is)
+        {}
+
+        void read_raw(void* data, std::uint64_t n) {
+            _is->read(static_cast<char*>(data), static_cast<std::streamsize>(n));
+            _position += n;
+        }
+
+        void skip(std::uint64_t n) {
+            char sink[4096];
+            while (n > 0 && _is->good()) {
+                const std::uint64_t chunk = std::min<std::uint64_t>(n, sizeof(sink));
+                read_raw(sink, chunk);
+                n -= chunk;
+            }
+        }
+
+        void skip_to(std::uint64_t offset) {
+            if (offset == 0 || !_position_known) {
+                return;
+            }
+            if (offset < _position) {
+                throw std::runtime_error("snapshot: section offset points backwards.");
+            }
+            skip(offset - _position);
+        }
+
+        template<class T>
+        T read_element() {
+            _position_known = false;
+            return snapshot_codec<T>::read(*_is);
+        }
+
+        bool good() const {
+            return _is->good();
+        }
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+
+/**
+ * streambuf over a POSIX file descriptor, so the fd overloads of save()/load() share the stream code path.
+ *
+ * Large reads and writes bypass the buffer and go straight to the syscall. The descriptor isn't closed on destruction.
+ */
+class fd_streambuf : public std::streambuf {
+    private:
+        int _fd;
+        int _error = 0;
+        std::unique_ptr<char[]> _buffer;
+        static constexpr std::streamsize buffer_size = 1 << 16;
+
+        bool write_all(const char* data, std::streamsize n) {
+            while (n > 0) {
+                const ssize_t written = ::write(_fd, data, static_cast<size_t>(n));
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    _error = errno;
+                    return false;
+                }
+                data += written;
+                n -= written;
+            }
+            return true;
+        }
+
+        bool flush_buffer() {
+            const std::streamsize pending = pptr() - pbase();
+            if (pending > 0 && !write_all(pbase(), pending)) {
+                return false;
+            }
+            setp(_buffer.get(), _buffer.get() + buffer_size);
+            return true;
+        }
+
+        std::streamsize read_some(char* data, std::streamsize n) {
+            while (true) {
+                const ssize_t got = ::read(_fd, data, static_cast<size_t>(n));
+                if (got < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    _error = errno;
+                    return 0;
+                }
+                return got;
+            }
+        }
+
+    protected:
+        int_type overflow(int_type ch) override {
+            if (!flush_buffer()) {
+                return traits_type::eof();
+            }
+            if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+                *pptr() = traits_type::to_char_type(ch);
+                pbump(1);
+            }
+            return traits_type::not_eof(ch);
+        }
+
+        std::streamsize xsputn(const char* data, std::streamsize n) override {
+            if (n < buffer_size / 4) {
+                return std::streambuf::xsputn(data, n);
+            }
+            if (!flush_buffer() || !write_all(data, n)) {
+                return 0;
+            }
+            return n;
+        }
+
+        int sync() override {
+            return flush_buffer() ? 0 : -1;
+        }
+
+        int_type underflow() override {
+            if (gptr() < egptr()) {
+                return traits_type::to_int_type(*gptr());
+            }
+            const std::streamsize got = read_some(_buffer.get(), buffer_size);
+            if (got <= 0) {
+                return traits_type::eof();
+            }
+            setg(_buffer.get(), _buffer.get(), _buffer.get() + got);
+            return traits_type::to_int_type(*gptr());
+        }
+
+        std::streamsize xsgetn(char* data, std::streamsize n) override {
+            // hand out what's already buffered, then read the rest directly.
+            std::streamsize done = std::min<std::streamsize>(n, egptr() - gptr());
+            std::memcpy(data, gptr(), static_cast<size_t>(done));
+            gbump(static_cast<int>(done));
+
+            if (n - done < buffer_size / 4) {
+                return done + std::streambuf::xsgetn(data + done, n - done);
+            }
+            while (done < n) {
+                const std::streamsize got = read_some(data + done, n - done);
+                if (got <= 0) {
+                    break;
+                }
+                done += got;
+            }
+            return done;
+        }
+
+    public:
+        // in and out share one buffer, so a given fd_streambuf is meant for one direction.
+        explicit fd_streambuf(int fd)
+            : _fd(fd),
+              _buffer(new char[buffer_size])
+        {
+            setp(_buffer.get(), _buffer.get() + buffer_size);
+            setg(_buffer.get(), _buffer.get(), _buffer.get());
+        }
+
+        ~fd_streambuf() override {
+            flush_buffer();
+        }
+
+        // errno of the last failed syscall, 0 if none failed.
+        int error() const noexcept {
+            return _error;
+        }
+};
+
+#endif
+
+#endif
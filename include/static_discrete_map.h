@@ -0,0 +1,265 @@
+#ifndef STATIC_DISCRETE_MAP_H
+#define STATIC_DISCRETE_MAP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "BitwiseGrowthPolicy.h"
+#include "GrowthPolicy.h"
+
+/**
+ * hash usable in constant expressions, which std::hash isn't.
+ *
+ * Integers and enums hash to themselves, like libstdc++'s std::hash. Strings use 64-bit FNV-1a. Specialise it for other key types.
+ */
+template<class Key, class = void>
+struct constexpr_hash;
+
+template<class Key>
+struct constexpr_hash<Key, std::enable_if_t<std::is_integral_v<Key> || std::is_enum_v<Key>>> {
+    constexpr size_t operator()(Key k) const noexcept {
+        if constexpr (std::is_enum_v<Key>) {
+            return static_cast<size_t>(static_cast<std::underlying_type_t<Key>>(k));
+        }
+        else {
+            return static_cast<size_t>(k);
+        }
+    }
+};
+
+template<class CharT, class Traits>
+struct constexpr_hash<std::basic_string_view<CharT, Traits>> {
+    constexpr size_t operator()(std::basic_string_view<CharT, Traits> str) const noexcept {
+        std::uint64_t h = 0xcbf29ce484222325ull;
+        for (const CharT c : str) {
+            h ^= static_cast<std::uint64_t>(static_cast<std::make_unsigned_t<CharT>>(c));
+            h *= 0x100000001b3ull;
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+/**
+ * fixed-size map whose index table is built at compile time.
+ *
+ * Keys and values live in std::array columns in the order they were given, and the probe table is a std::array of the narrowest unsigned type that can hold N + 1 (0 marks an empty slot). Its capacity is picked by Growth exactly as discrete_map would: start at min_capacity() and keep calling next_capacity() until the load stays under linear_prober's threshold.
+ *
+ * Declared constexpr, the whole thing is a constant; a lookup is a hash, a mask and a compare, plus more compares only on collision.
+ */
+template<class Key,
+         class T,
+         size_t N,
+         class Hash = constexpr_hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class Growth = BitwiseGrowthPolicy>
+class static_discrete_map {
+    public:
+        // types
+        using key_type = Key;
+        using mapped_type = T;
+        using value_type = std::pair<Key, T>;
+        using hasher = Hash;
+        using key_equal = Pred;
+        using size_type = size_t;
+
+        using key_collection_type = std::array<key_type, N>;
+        using value_collection_type = std::array<mapped_type, N>;
+
+    private:
+        // same load limit as linear_prober, which is also the probing scheme used below.
+        static constexpr float threshold = 0.5f;
+
+        static constexpr size_type compute_capacity() {
+            // the derived policy, not its CRTP base: the base's static_cast to Derived is only valid in a constant expression if the object really is one.
+            constexpr Growth growth{};
+            size_type capacity = growth.min_capacity();
+            while (static_cast<float>(N) / static_cast<float>(capacity) >= threshold) {
+                capacity = growth.next_capacity(capacity);
+            }
+            return capacity;
+        }
+
+    public:
+        static constexpr size_type capacity = compute_capacity();
+
+    private:
+        using indices_type = std::conditional_t<(N < std::numeric_limits<std::uint8_t>::max()), std::uint8_t,
+                             std::conditional_t<(N < std::numeric_limits<std::uint16_t>::max()), std::uint16_t,
+                             std::conditional_t<(N < std::numeric_limits<std::uint32_t>::max()), std::uint32_t,
+                             std::uint64_t>>>;
+
+        key_collection_type _keys{};
+        value_collection_type _values{};
+        std::array<indices_type, capacity> _indices{};
+
+        [[no_unique_address]] Growth _growth_pol{};
+
+        static constexpr size_type next_slot(size_type slot) noexcept {
+            return slot + 1 == capacity ? 0 : slot + 1;
+        }
+
+        // position of k in the columns, or N if absent.
+        constexpr size_type probe_find(const key_type& k) const {
+            for (size_type slot = _growth_pol.get_index(capacity, hasher()(k)); _indices[slot] != 0; slot = next_slot(slot)) {
+                const size_type i = static_cast<size_type>(_indices[slot] - 1);
+                if (key_eq()(k, _keys[i])) {
+                    return i;
+                }
+            }
+            return N;
+        }
+
+        class const_iterator {
+            private:
+                size_type _index;
+                const static_discrete_map* _map;
+
+            public:
+                constexpr const_iterator(size_type i, const static_discrete_map& map)
+                    : _index(i),
+                      _map(&map)
+                {}
+                constexpr std::pair<const key_type&, const mapped_type&> operator*() const {
+                    return {_map->_keys[_index], _map->_values[_index]};
+                }
+                constexpr const_iterator& operator++() {
+                    _index++;
+                    return *this;
+                }
+                constexpr const_iterator operator++(int) {
+                    const_iterator temp = *this;
+                    ++(*this);
+                    return temp;
+                }
+                constexpr const_iterator operator+(size_type n) const {
+                    return const_iterator(_index + n, *_map);
+                }
+                constexpr bool operator==(const const_iterator& other) const {
+                    return _index == other._index;
+                }
+                constexpr bool operator!=(const const_iterator& other) const {
+                    return !(*this == other);
+                }
+        };
+
+    public:
+        using iterator = const_iterator;
+
+//construct/copy/destroy
+
+        /**
+         * @throws std::invalid_argument on a duplicate key, which in a constant expression is a compile error.
+         */
+        constexpr explicit static_discrete_map(const std::array<value_type, N>& pairs) {
+            for (size_type i = 0; i < N; ++i) {
+                _keys[i] = pairs[i].first;
+                _values[i] = pairs[i].second;
+
+                size_type slot = _growth_pol.get_index(capacity, hasher()(_keys[i]));
+                for (; _indices[slot] != 0; slot = next_slot(slot)) {
+                    if (key_eq()(_keys[i], _keys[_indices[slot] - 1])) {
+                        throw std::invalid_argument("static_discrete_map thrown exception: duplicate key.");
+                    }
+                }
+                _indices[slot] = static_cast<indices_type>(i + 1);
+            }
+        }
+
+//iterators
+
+        constexpr const_iterator begin() const noexcept {
+            return const_iterator(0, *this);
+        }
+
+        constexpr const_iterator end() const noexcept {
+            return const_iterator(N, *this);
+        }
+
+        constexpr const_iterator cbegin() const noexcept {
+            return begin();
+        }
+
+        constexpr const_iterator cend() const noexcept {
+            return end();
+        }
+
+//getters
+
+        constexpr const key_collection_type& keys() const noexcept {
+            return _keys;
+        }
+
+        constexpr const value_collection_type& values() const noexcept {
+            return _values;
+        }
+
+//capacity
+
+        [[nodiscard]] constexpr bool empty() const noexcept {
+            return N == 0;
+        }
+
+        constexpr size_type size() const noexcept {
+            return N;
+        }
+
+//observers
+
+        constexpr key_equal key_eq() const {
+            return Pred();
+        }
+
+        constexpr hasher hash_function() const {
+            return hasher();
+        }
+
+//map operations
+
+        constexpr const_iterator find(const key_type& k) const {
+            return begin() + probe_find(k);
+        }
+
+        constexpr bool contains(const key_type& k) const {
+            return probe_find(k) != N;
+        }
+
+        constexpr size_type count(const key_type& k) const {
+            return contains(k) ? 1 : 0;
+        }
+
+//element access
+
+        constexpr const mapped_type& at(const key_type& k) const {
+            const size_type i = probe_find(k);
+            if (i == N) {
+                throw std::out_of_range("static_discrete_map::at() const thrown exception: key out of range.");
+            }
+            return _values[i];
+        }
+};
+
+/**
+ * deduces N from a braced list, e.g. `constexpr auto codes = make_static_discrete_map<std::string_view, int>({{"GET", 1}, {"PUT", 2}});`
+ */
+template<class Key,
+         class T,
+         class Hash = constexpr_hash<Key>,
+         class Pred = std::equal_to<Key>,
+         class Growth = BitwiseGrowthPolicy,
+         size_t N>
+constexpr static_discrete_map<Key, T, N, Hash, Pred, Growth> make_static_discrete_map(const std::pair<Key, T> (&pairs)[N]) {
+    std::array<std::pair<Key, T>, N> collected{};
+    for (size_t i = 0; i < N; ++i) {
+        collected[i] = pairs[i];
+    }
+    return static_discrete_map<Key, T, N, Hash, Pred, Growth>(collected);
+}
+
+#endif
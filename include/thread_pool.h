@@ -0,0 +1,161 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <latch>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Minimal fixed-size pool used by the bulk operations of discrete_map.
+ *
+ * Anything exposing `execute(Callable)` can stand in for it as an executor. If it also exposes `concurrency()`, that is used to decide how many chunks to cut a column into.
+ */
+class thread_pool {
+    private:
+        using size_type = size_t;
+
+        std::deque<std::function<void()>> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _ready;
+        bool _stopping = false;
+
+        // declared last so the workers are joined before the queue they read from is destroyed.
+        std::vector<std::jthread> _workers;
+
+        void work() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock lock(_mutex);
+                    _ready.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+
+                    // drain whatever is queued before honouring a stop.
+                    if (_tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(_tasks.front());
+                    _tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+    public:
+        explicit thread_pool(size_type n = std::max(1u, std::thread::hardware_concurrency())) {
+            _workers.reserve(n);
+            for (size_type i = 0; i < n; ++i) {
+                _workers.emplace_back([this] { work(); });
+            }
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        ~thread_pool() {
+            {
+                std::lock_guard lock(_mutex);
+                _stopping = true;
+            }
+            _ready.notify_all();
+            //jthread joins on destruction
+        }
+
+        template<class Callable>
+        void execute(Callable&& task) {
+            {
+                std::lock_guard lock(_mutex);
+                _tasks.emplace_back(std::forward<Callable>(task));
+            }
+            _ready.notify_one();
+        }
+
+        size_type concurrency() const noexcept {
+            return _workers.size();
+        }
+};
+
+inline thread_pool& default_thread_pool() {
+    static thread_pool pool;
+    return pool;
+}
+
+/**
+ * splits [0, n) into contiguous chunks and runs `body(first, last)` for each of them on `executor`, blocking until all are done.
+ *
+ * The calling thread runs the last chunk itself. The first exception thrown by any chunk is rethrown here once every chunk has finished. If the executor itself throws, the chunks it hadn't accepted yet are skipped, the ones it had are waited for, and its exception is rethrown.
+ * Don't call this from a task already running on the same pool; the wait can starve it.
+ *
+ * @arg executor anything with `execute(Callable)`
+ * @arg n number of elements
+ * @arg body callable taking (first, last)
+ * @arg min_chunk smallest range worth shipping to another thread
+ */
+template<class Executor, class Callable>
+void parallel_chunks(Executor& executor, size_t n, Callable&& body, size_t min_chunk = 4096) {
+
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    if constexpr (requires { executor.concurrency(); }) {
+        workers = std::max<size_t>(1, executor.concurrency());
+    }
+
+    const size_t chunks = std::min(workers, (n + min_chunk - 1) / std::max<size_t>(1, min_chunk));
+
+    // not worth a context switch.
+    if (chunks <= 1) {
+        body(size_t{0}, n);
+        return;
+    }
+
+    const size_t step = (n + chunks - 1) / chunks;
+
+    std::latch done(static_cast<std::ptrdiff_t>(chunks - 1));
+    std::exception_ptr failure;
+    std::mutex failure_mutex;
+
+    const auto run = [&](size_t first, size_t last) {
+        try {
+            body(first, last);
+        }
+        catch (...) {
+            std::lock_guard lock(failure_mutex);
+            if (!failure) {
+                failure = std::current_exception();
+            }
+        }
+    };
+
+    size_t submitted = 0;
+    try {
+        for (; submitted + 1 < chunks; ++submitted) {
+            const size_t first = std::min(n, submitted * step);
+            const size_t last = std::min(n, first + step);
+            executor.execute([&run, &done, first, last] {
+                run(first, last);
+                done.count_down();
+            });
+        }
+    }
+    catch (...) {
+        // the chunks already queued refer to run and done on this frame, so they have to finish before it unwinds.
+        done.count_down(static_cast<std::ptrdiff_t>(chunks - 1 - submitted));
+        done.wait();
+        throw;
+    }
+
+    run(std::min(n, (chunks - 1) * step), n);
+    done.wait();
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+#endif
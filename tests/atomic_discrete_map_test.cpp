@@ -0,0 +1,112 @@
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "atomic_discrete_map.h"
+#include "differential.h"
+#include "discrete_map.h"
+
+namespace {
+
+std::unordered_map<std::int64_t, std::int64_t> load_all(const atomic_discrete_map<std::int64_t, std::int64_t>& map) {
+    std::unordered_map<std::int64_t, std::int64_t> values;
+    map.for_each([&values](std::int64_t k, std::int64_t v) {
+        values.emplace(k, v);
+    });
+    return values;
+}
+
+}
+
+TEST(atomic_discrete_map, freezes_the_source) {
+    discrete_map<std::int64_t, std::int64_t> source;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(5000);
+    for (int step = 0; step < 5000; ++step) {
+        const std::int64_t k = stream.key();
+        if (stream.op() < 70) {
+            source[k] = step;
+            reference[k] = step;
+        }
+        else {
+            source.erase(k);
+            reference.erase(k);
+        }
+    }
+
+    const atomic_discrete_map<std::int64_t, std::int64_t> copied(source);
+    const atomic_discrete_map<std::int64_t, std::int64_t> moved(std::move(source));
+    for (const auto* map : {&copied, &moved}) {
+        ASSERT_EQ(map->size(), reference.size());
+        EXPECT_EQ(load_all(*map), reference);
+        for (const auto& [k, v] : reference) {
+            EXPECT_EQ(map->load(k), v);
+        }
+        EXPECT_FALSE(map->contains(-1));
+        EXPECT_EQ(map->count(-1), 0u);
+        EXPECT_THROW(map->load(-1), std::out_of_range);
+    }
+}
+
+TEST(atomic_discrete_map, single_threaded_operations) {
+    atomic_discrete_map<std::string, std::int64_t> map{{"a", 1}, {"b", 2}, {"a", 100}};
+    // later duplicates are ignored, as with insert().
+    ASSERT_EQ(map.size(), 2u);
+    EXPECT_EQ(map.load("a"), 1);
+
+    map.store("a", 10);
+    EXPECT_EQ(map.exchange("a", 20), 10);
+    EXPECT_EQ(map.fetch_add("a", 5), 20);
+    EXPECT_EQ(map.fetch_sub("a", 1), 25);
+    EXPECT_EQ(map.load("a"), 24);
+
+    std::int64_t expected = 0;
+    EXPECT_FALSE(map.compare_exchange_strong("b", expected, 7));
+    EXPECT_EQ(expected, 2);
+    EXPECT_TRUE(map.compare_exchange_strong("b", expected, 7));
+    EXPECT_EQ(map.ref("b").load(), 7);
+
+    EXPECT_THROW(map.store("c", 1), std::out_of_range);
+    EXPECT_THROW(map.fetch_add("c", 1), std::out_of_range);
+    EXPECT_THROW(map.ref("c"), std::out_of_range);
+}
+
+TEST(atomic_discrete_map, concurrent_counters_add_up) {
+    std::vector<std::pair<std::int64_t, std::int64_t>> zeros;
+    for (std::int64_t k = 0; k < 64; ++k) {
+        zeros.emplace_back(k * 7919, 0);
+    }
+    atomic_discrete_map<std::int64_t, std::int64_t> map(zeros.begin(), zeros.end());
+
+    constexpr int threads = 8;
+    constexpr int rounds = 2000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, t] {
+            for (int round = 0; round < rounds; ++round) {
+                for (std::int64_t k = 0; k < 64; ++k) {
+                    map.fetch_add(k * 7919, 1, std::memory_order_relaxed);
+                }
+                // and a compare-exchange loop on one of the keys, which the counters above race with.
+                const std::int64_t own = static_cast<std::int64_t>(t) * 7919;
+                std::int64_t seen = map.load(own, std::memory_order_relaxed);
+                while (!map.compare_exchange_weak(own, seen, seen + 1000000)) {}
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    for (std::int64_t k = 0; k < 64; ++k) {
+        const std::int64_t bumps = k < threads ? std::int64_t{rounds} * 1000000 : 0;
+        EXPECT_EQ(map.load(k * 7919), std::int64_t{threads} * rounds + bumps) << "key " << k;
+    }
+}
@@ -0,0 +1,121 @@
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bench_harness.h"
+#include "perf_counters.h"
+
+namespace {
+
+std::uint64_t busy_work(std::uint64_t n) {
+    std::uint64_t x = 0;
+    for (std::uint64_t i = 0; i < n; ++i) {
+        x = bench_mix(x + i);
+        do_not_optimize(x);
+    }
+    return x;
+}
+
+}
+
+// whichever counters the kernel lets this process open, each must read like a count; the rest read as missing.
+TEST(perf_counters, counts_only_between_start_and_stop) {
+    const perf_counters counters;
+    const size_t instructions = static_cast<size_t>(perf_event_kind::instructions);
+
+    counters.reset();
+    perf_sample idle = counters.read();
+    for (size_t i = 0; i < perf_event_count; ++i) {
+        if (idle[i]) {
+            EXPECT_EQ(*idle[i], 0.0) << perf_event_names[i];
+        }
+    }
+
+    counters.start();
+    do_not_optimize(busy_work(100000));
+    counters.stop();
+    const perf_sample once = counters.read();
+    do_not_optimize(busy_work(100000));
+    // nothing was counted while stopped.
+    EXPECT_EQ(counters.read(), once);
+
+    for (size_t i = 0; i < perf_event_count; ++i) {
+        EXPECT_EQ(once[i].has_value(), idle[i].has_value()) << perf_event_names[i];
+        if (once[i]) {
+            EXPECT_GE(*once[i], 0.0) << perf_event_names[i];
+        }
+    }
+    if (once[instructions]) {
+        EXPECT_GT(*once[instructions], 100000.0);
+    }
+
+    // counts accumulate across start()/stop() pairs until reset().
+    counters.start();
+    do_not_optimize(busy_work(100000));
+    counters.stop();
+    const perf_sample twice = counters.read();
+    if (once[instructions] && twice[instructions]) {
+        EXPECT_GT(*twice[instructions], *once[instructions]);
+    }
+
+    counters.reset();
+    const perf_sample after_reset = counters.read();
+    if (after_reset[instructions]) {
+        EXPECT_EQ(*after_reset[instructions], 0.0);
+    }
+
+    bool any = false;
+    for (const std::optional<double>& c : once) {
+        any = any || c.has_value();
+    }
+    EXPECT_EQ(counters.any_available(), any);
+}
+
+TEST(bench_timer, scales_counters_per_operation) {
+    bench_timer untimed;
+    untimed.start();
+    do_not_optimize(busy_work(1000));
+    untimed.stop();
+    EXPECT_GT(untimed.ns(), 0.0);
+    // without counters every column is missing, never a made-up zero.
+    for (const std::optional<double>& c : untimed.counters_per_op(1000)) {
+        EXPECT_FALSE(c);
+    }
+
+    const perf_counters counters;
+    bench_timer timer(&counters);
+    timer.start();
+    do_not_optimize(busy_work(100000));
+    timer.stop();
+    const perf_sample total = counters.read();
+    const perf_sample per_op = timer.counters_per_op(1000);
+    for (size_t i = 0; i < perf_event_count; ++i) {
+        ASSERT_EQ(per_op[i].has_value(), total[i].has_value());
+        if (total[i]) {
+            EXPECT_DOUBLE_EQ(*per_op[i], *total[i] / 1000.0);
+        }
+    }
+}
+
+TEST(bench_harness, sizes_and_keys) {
+    bench_config config;
+    config.min_size = 100;
+    config.max_size = 100000;
+    EXPECT_EQ(bench_sizes(config), (std::vector<size_t>{100, 1000, 10000, 100000}));
+    config.max_size = 50000;
+    EXPECT_EQ(bench_sizes(config), (std::vector<size_t>{100, 1000, 10000}));
+
+    config.target_ops = 1000;
+    EXPECT_EQ(bench_repetitions(config, 10), 100u);
+    EXPECT_EQ(bench_repetitions(config, 1000000), 1u);
+
+    // distinct indices give distinct keys.
+    std::unordered_set<std::uint64_t> keys;
+    for (std::uint64_t i = 0; i < 100000; ++i) {
+        EXPECT_TRUE(keys.insert(bench_type_traits<std::uint64_t>::make(i)).second);
+    }
+}
@@ -0,0 +1,129 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "column.h"
+#include "differential.h"
+#include "discrete_map.h"
+#include "malloc_allocator.h"
+#include "mremap_allocator.h"
+
+template<class Key, class T, template<class> class Alloc>
+using allocated_map = discrete_map<Key, T, std::hash<Key>, std::equal_to<Key>, Alloc<Key>, Alloc<T>>;
+
+namespace {
+
+// grows and shrinks one block across sizes on both sides of the mapping threshold, checking its contents survive each step.
+template<class Alloc>
+void reallocate_keeps_contents() {
+    using value_type = typename Alloc::value_type;
+    Alloc alloc;
+    size_t n = 16;
+    value_type* p = alloc.allocate(n);
+    for (size_t i = 0; i < n; ++i) {
+        p[i] = static_cast<value_type>(i);
+    }
+
+    // up past 1MB a few times, then back down under it.
+    for (const size_t next : {1000u, 200000u, 1000000u, 300000u, 50u}) {
+        p = alloc.reallocate(p, n, next);
+        for (size_t i = n; i < next; ++i) {
+            p[i] = static_cast<value_type>(i);
+        }
+        n = next;
+        for (size_t i = 0; i < n; ++i) {
+            ASSERT_EQ(p[i], static_cast<value_type>(i)) << "element " << i << " of " << n;
+        }
+    }
+    alloc.deallocate(p, n);
+}
+
+template<template<class> class Alloc>
+void map_matches_unordered_map() {
+    allocated_map<std::int64_t, std::int64_t, Alloc> map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(400000);
+    // enough elements that the columns pass the mapping threshold.
+    for (int step = 0; step < 400000; ++step) {
+        const std::int64_t k = stream.key();
+        if (stream.op() < 80) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else {
+            ASSERT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+    }
+    expect_same_contents(map, reference);
+    ASSERT_GT(map.memory_usage().keys, mremap_allocator<std::int64_t>::mapping_threshold);
+
+    const allocated_map<std::int64_t, std::int64_t, Alloc> copy(map);
+    expect_same_contents(copy, reference);
+
+    // erasing leaves the mapped columns in place; a copy of what's left fits under the threshold.
+    std::erase_if(reference, [](const auto& kv) { return kv.first % 100 != 0; });
+    for (std::int64_t k = 0; k < 400000; ++k) {
+        if (k % 100 != 0) {
+            map.erase(k);
+        }
+    }
+    expect_same_contents(map, reference);
+    const allocated_map<std::int64_t, std::int64_t, Alloc> small(map);
+    EXPECT_LT(small.memory_usage().keys, mremap_allocator<std::int64_t>::mapping_threshold);
+    expect_same_contents(small, reference);
+}
+
+}
+
+TEST(malloc_allocator, reallocate_keeps_contents) {
+    reallocate_keeps_contents<malloc_allocator<std::int64_t>>();
+    reallocate_keeps_contents<malloc_allocator<std::uint8_t>>();
+}
+
+TEST(mremap_allocator, reallocate_keeps_contents) {
+    reallocate_keeps_contents<mremap_allocator<std::int64_t>>();
+    reallocate_keeps_contents<mremap_allocator<std::uint8_t>>();
+}
+
+TEST(mremap_allocator, large_allocations_are_usable) {
+    mremap_allocator<char> alloc;
+    // exactly at, just under and well over the threshold, none a whole number of pages.
+    for (const size_t n : {mremap_allocator<char>::mapping_threshold - 1, mremap_allocator<char>::mapping_threshold, size_t(5'000'001)}) {
+        char* p = alloc.allocate(n);
+        p[0] = 'a';
+        p[n - 1] = 'z';
+        EXPECT_EQ(p[0] + p[n - 1], 'a' + 'z');
+        alloc.deallocate(p, n);
+    }
+    // a byte count that doesn't fit is refused before anything is mapped.
+    EXPECT_THROW(mremap_allocator<std::int64_t>().allocate(~size_t(0)), std::bad_array_new_length);
+}
+
+TEST(malloc_allocator, map_matches_unordered_map) {
+    map_matches_unordered_map<malloc_allocator>();
+}
+
+TEST(mremap_allocator, map_matches_unordered_map) {
+    map_matches_unordered_map<mremap_allocator>();
+}
+
+TEST(mremap_allocator, owning_values) {
+    // unique_ptr columns relocate through reallocate(); strings, which don't, go the usual way.
+    allocated_map<std::string, std::unique_ptr<std::string>, mremap_allocator> map;
+    for (int i = 0; i < 100000; ++i) {
+        map[std::to_string(i)] = std::make_unique<std::string>("value " + std::to_string(i));
+    }
+    for (int i = 0; i < 100000; i += 2) {
+        map.erase(std::to_string(i));
+    }
+    ASSERT_EQ(map.size(), 50000u);
+    for (int i = 1; i < 100000; i += 2) {
+        ASSERT_EQ(*map.at(std::to_string(i)), "value " + std::to_string(i));
+    }
+}
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "column.h"
+#include "differential.h"
+
+namespace {
+
+// counts live objects and move constructions, so a test can see which path a column took.
+struct tracked {
+    static inline int live = 0;
+    static inline int moves = 0;
+
+    std::int64_t value = 0;
+
+    tracked() {
+        ++live;
+    }
+    explicit tracked(std::int64_t v)
+        : value(v)
+    {
+        ++live;
+    }
+    tracked(const tracked& other)
+        : value(other.value)
+    {
+        ++live;
+    }
+    tracked(tracked&& other) noexcept
+        : value(other.value)
+    {
+        ++live;
+        ++moves;
+    }
+    tracked& operator=(const tracked&) = default;
+    tracked& operator=(tracked&&) noexcept = default;
+    ~tracked() {
+        --live;
+    }
+
+    bool operator==(const tracked& other) const {
+        return value == other.value;
+    }
+};
+
+// the same, but declared safe to memcpy.
+struct relocatable_tracked : tracked {
+    using tracked::tracked;
+};
+
+// copyable but not nothrow-movable, and its copies can be made to fail.
+struct fragile {
+    static inline int copies_left = 1 << 30;
+
+    std::int64_t value = 0;
+
+    explicit fragile(std::int64_t v)
+        : value(v)
+    {}
+    fragile(const fragile& other)
+        : value(other.value)
+    {
+        if (--copies_left < 0) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+    fragile(fragile&& other) noexcept(false)
+        : value(other.value)
+    {}
+    fragile& operator=(const fragile&) = default;
+};
+
+// std::allocator plus a reallocate() that just counts its calls.
+template<class T>
+struct reallocating_allocator : std::allocator<T> {
+    static inline int reallocations = 0;
+
+    using value_type = T;
+
+    reallocating_allocator() = default;
+    template<class U>
+    reallocating_allocator(const reallocating_allocator<U>&) noexcept {}
+
+    template<class U>
+    struct rebind {
+        using other = reallocating_allocator<U>;
+    };
+
+    T* reallocate(T* p, size_t old_n, size_t new_n) {
+        ++reallocations;
+        T* fresh = this->allocate(new_n);
+        std::memcpy(static_cast<void*>(fresh), static_cast<const void*>(p), std::min(old_n, new_n) * sizeof(T));
+        this->deallocate(p, old_n);
+        return fresh;
+    }
+};
+
+// random pushes, erases, swaps-erases and resizes, mirrored on a std::vector.
+template<class T>
+void matches_vector() {
+    column<T> col;
+    std::vector<std::int64_t> reference;
+    key_stream stream(1000);
+
+    for (int step = 0; step < 5000; ++step) {
+        const int op = stream.op();
+        if (op < 50 || reference.empty()) {
+            col.emplace_back(step);
+            reference.push_back(step);
+        }
+        else if (op < 65) {
+            const size_t i = static_cast<size_t>(stream.key()) % reference.size();
+            col.erase(col.begin() + i);
+            reference.erase(reference.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        else if (op < 80) {
+            const size_t i = static_cast<size_t>(stream.key()) % reference.size();
+            col.erase_by_swap(i);
+            reference[i] = reference.back();
+            reference.pop_back();
+        }
+        else if (op < 85) {
+            const size_t first = static_cast<size_t>(stream.key()) % reference.size();
+            const size_t last = first + (reference.size() - first) / 2;
+            col.erase(col.begin() + first, col.begin() + last);
+            reference.erase(reference.begin() + static_cast<std::ptrdiff_t>(first), reference.begin() + static_cast<std::ptrdiff_t>(last));
+        }
+        else if (op < 90) {
+            col.pop_back();
+            reference.pop_back();
+        }
+        else if (op < 95) {
+            col.shrink_to_fit();
+            EXPECT_EQ(col.capacity(), col.size());
+        }
+        else {
+            const size_t n = reference.size() + 3;
+            col.resize(n);
+            reference.resize(n);
+        }
+
+        ASSERT_EQ(col.size(), reference.size());
+        ASSERT_GE(col.capacity(), col.size());
+    }
+    for (size_t i = 0; i < reference.size(); ++i) {
+        ASSERT_EQ(col[i].value, reference[i]) << "element " << i;
+    }
+
+    const column<T> copy(col);
+    EXPECT_TRUE(copy == col);
+    column<T> moved(std::move(col));
+    EXPECT_TRUE(moved == copy);
+    EXPECT_TRUE(col.empty());
+}
+
+}
+
+template<>
+struct is_trivially_relocatable<relocatable_tracked> : std::true_type {};
+
+static_assert(is_trivially_relocatable_v<int>);
+static_assert(is_trivially_relocatable_v<std::unique_ptr<int>>);
+static_assert(is_trivially_relocatable_v<std::shared_ptr<int>>);
+static_assert(!is_trivially_relocatable_v<tracked>);
+
+TEST(column, matches_vector) {
+    matches_vector<tracked>();
+    EXPECT_EQ(tracked::live, 0);
+    matches_vector<relocatable_tracked>();
+    EXPECT_EQ(tracked::live, 0);
+}
+
+TEST(column, relocation_skips_the_move_constructor) {
+    {
+        column<tracked> col;
+        tracked::moves = 0;
+        for (int i = 0; i < 1000; ++i) {
+            col.emplace_back(i);
+        }
+        // every growth moved each element across.
+        EXPECT_GT(tracked::moves, 1000);
+
+        tracked::moves = 0;
+        col.erase(col.begin());
+        col.erase_by_swap(10);
+        EXPECT_EQ(tracked::moves, 0);
+    }
+    {
+        column<relocatable_tracked> col;
+        tracked::moves = 0;
+        for (int i = 0; i < 1000; ++i) {
+            col.emplace_back(i);
+        }
+        // only the new element is moved on each of the 11 growths, having been built aside in case the arguments pointed into the column.
+        EXPECT_EQ(tracked::moves, 11);
+
+        tracked::moves = 0;
+        col.erase(col.begin(), col.begin() + 100);
+        col.erase_by_swap(10);
+        col.shrink_to_fit();
+        EXPECT_EQ(tracked::moves, 0);
+        EXPECT_EQ(col.size(), 899u);
+        EXPECT_EQ(col[0].value, 100);
+        EXPECT_EQ(col[10].value, 999);
+        EXPECT_EQ(tracked::live, 899);
+    }
+    EXPECT_EQ(tracked::live, 0);
+}
+
+TEST(column, owning_elements_survive_relocation) {
+    column<std::unique_ptr<std::string>> col;
+    for (int i = 0; i < 500; ++i) {
+        col.emplace_back(std::make_unique<std::string>(std::to_string(i)));
+    }
+    col.erase(col.begin() + 10, col.begin() + 20);
+    col.erase_by_swap(0);
+    ASSERT_EQ(col.size(), 489u);
+    EXPECT_EQ(*col[0], "499");
+    EXPECT_EQ(*col[10], "20");
+    EXPECT_EQ(*col.back(), "498");
+}
+
+TEST(column, grows_through_the_allocators_reallocate) {
+    reallocating_allocator<std::int64_t>::reallocations = 0;
+    column<std::int64_t, reallocating_allocator<std::int64_t>> col;
+    for (std::int64_t i = 0; i < 1000; ++i) {
+        col.push_back(i);
+    }
+    // the first buffer is allocated; every growth after that is a reallocate.
+    EXPECT_GT(reallocating_allocator<std::int64_t>::reallocations, 5);
+    for (std::int64_t i = 0; i < 1000; ++i) {
+        ASSERT_EQ(col[static_cast<size_t>(i)], i);
+    }
+
+    // not for types that aren't relocatable.
+    reallocating_allocator<tracked>::reallocations = 0;
+    {
+        column<tracked, reallocating_allocator<tracked>> tracked_col;
+        for (int i = 0; i < 100; ++i) {
+            tracked_col.emplace_back(i);
+        }
+    }
+    EXPECT_EQ(reallocating_allocator<tracked>::reallocations, 0);
+    EXPECT_EQ(tracked::live, 0);
+}
+
+TEST(column, failed_growth_leaves_it_untouched) {
+    column<fragile> col;
+    col.reserve(4);
+    for (int i = 0; i < 4; ++i) {
+        col.emplace_back(i);
+    }
+    // a move that might throw isn't used, so growth copies, and the copy fails halfway.
+    fragile::copies_left = 2;
+    EXPECT_THROW(col.emplace_back(4), std::runtime_error);
+    fragile::copies_left = 1 << 30;
+
+    ASSERT_EQ(col.size(), 4u);
+    EXPECT_EQ(col.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(col[static_cast<size_t>(i)].value, i);
+    }
+    EXPECT_THROW(col.at(4), std::out_of_range);
+}
@@ -0,0 +1,187 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "columns.h"
+#include "differential.h"
+#include "discrete_map.h"
+#include "thread_pool.h"
+
+namespace {
+
+using row_value = columns<std::int64_t, std::string, double>;
+using row_map = discrete_map<std::int64_t, row_value>;
+using reference_map = std::unordered_map<std::int64_t, std::tuple<std::int64_t, std::string, double>>;
+
+row_value make_row(int step) {
+    return row_value(step, "value " + std::to_string(step), step * 0.5);
+}
+
+void expect_same_rows(const row_map& map, const reference_map& reference) {
+    expect_same_contents(map, reference, [](const row_map& m, std::int64_t key) {
+        return m.contains(key) ? std::make_unique<std::tuple<std::int64_t, std::string, double>>(m.at(key).copy_out()) : nullptr;
+    });
+    // every field column stays the same length as the keys, in the same order.
+    const auto numbers = map.value_column<0>();
+    const auto names = map.value_column<1>();
+    ASSERT_EQ(numbers.size(), map.size());
+    ASSERT_EQ(names.size(), map.size());
+    for (size_t i = 0; i < map.size(); ++i) {
+        EXPECT_EQ(std::get<1>(reference.at(map.keys()[i])), names[i]);
+    }
+}
+
+// a field whose copies start failing once a countdown runs out.
+struct fragile_field {
+    static inline int copies_left = 1 << 30;
+
+    int value = 0;
+
+    fragile_field() = default;
+    explicit fragile_field(int v)
+        : value(v)
+    {}
+    fragile_field(const fragile_field& other)
+        : value(other.value)
+    {
+        if (--copies_left < 0) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+    fragile_field& operator=(const fragile_field&) = default;
+};
+
+}
+
+TEST(columns, random_operations_match_unordered_map) {
+    row_map map;
+    reference_map reference;
+    key_stream stream(2000);
+
+    for (int step = 0; step < 20000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 35) {
+            map.insert({k, make_row(step)});
+            reference.emplace(k, make_row(step));
+        }
+        else if (op < 50) {
+            // a row assigned from a whole value writes every field through.
+            map[k] = make_row(step);
+            reference[k] = make_row(step);
+        }
+        else if (op < 65) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else if (op < 80) {
+            const bool found = map.visit(k, [](auto row) {
+                get<0>(row) += 1;
+                get<1>(row) += "!";
+            });
+            EXPECT_EQ(found, reference.contains(k));
+            if (found) {
+                std::get<0>(reference[k]) += 1;
+                std::get<1>(reference[k]) += "!";
+            }
+        }
+        else {
+            const bool inserted = map.upsert(k, [step] { return make_row(step); }, [](auto row) { get<2>(row) *= 2; });
+            EXPECT_EQ(inserted, !reference.contains(k));
+            if (inserted) {
+                reference.emplace(k, make_row(step));
+            }
+            else {
+                std::get<2>(reference[k]) *= 2;
+            }
+        }
+    }
+    expect_same_rows(map, reference);
+
+    const row_map copy(map);
+    expect_same_rows(copy, reference);
+}
+
+TEST(columns, rows_read_and_write_through) {
+    row_map map;
+    map.insert({1, make_row(1)});
+    map.insert({2, make_row(2)});
+
+    const auto [number, name, weight] = map.at(1);
+    EXPECT_EQ(number, 1);
+    EXPECT_EQ(name, "value 1");
+    EXPECT_EQ(weight, 0.5);
+
+    // one row assigned to another copies fields, it doesn't rebind.
+    map.at(1) = map.at(2);
+    get<1>(map.at(2)) = "changed";
+    EXPECT_EQ(get<1>(map.at(1)), "value 2");
+
+    const row_value whole = map.at(2);
+    EXPECT_EQ(std::get<1>(whole), "changed");
+
+    const auto pair = *map.find(2);
+    EXPECT_EQ(pair.first, 2);
+    EXPECT_EQ(std::get<0>(row_value(pair.second)), 2);
+}
+
+TEST(columns, bulk_operations_and_field_spans) {
+    row_map map;
+    for (int i = 0; i < 1000; ++i) {
+        map.insert({i, make_row(i)});
+    }
+
+    // a scan over one field.
+    auto numbers = map.value_column<0>();
+    EXPECT_EQ(std::accumulate(numbers.begin(), numbers.end(), std::int64_t{0}), 999 * 1000 / 2);
+    for (std::int64_t& n : numbers) {
+        n *= 2;
+    }
+    EXPECT_EQ(get<0>(map.at(10)), 20);
+
+    thread_pool pool(4);
+    map.for_each(pool, [](std::int64_t k, auto row) { get<2>(row) = static_cast<double>(k); });
+    map.transform_values(pool, [](std::int64_t k, auto row) {
+        return row_value(get<0>(row) + 1, std::to_string(k), get<2>(row));
+    });
+    EXPECT_EQ(map.erase_if(pool, [](std::int64_t k, auto) { return k % 2 == 0; }), 500u);
+
+    ASSERT_EQ(map.size(), 500u);
+    for (int i = 1; i < 1000; i += 2) {
+        const auto [number, name, weight] = map.at(i);
+        EXPECT_EQ(number, 2 * i + 1);
+        EXPECT_EQ(name, std::to_string(i));
+        EXPECT_EQ(weight, static_cast<double>(i));
+    }
+
+    // the summed field sizes, no padding between them.
+    const memory_usage_report report = map.memory_usage();
+    EXPECT_EQ(report.values, map.values().capacity() * (sizeof(std::int64_t) + sizeof(std::string) + sizeof(double)));
+}
+
+TEST(columns, a_throwing_field_appends_nothing) {
+    discrete_map<int, columns<std::string, fragile_field, int>> map;
+    for (int i = 0; i < 10; ++i) {
+        map.insert({i, {std::string(100, 'x'), fragile_field(i), i}});
+    }
+
+    // the field's one copy on the way out of make_value succeeds; the one into its column, after the string has gone in, doesn't.
+    columns<std::string, fragile_field, int> value(std::string(100, 'y'), fragile_field(99), 99);
+    fragile_field::copies_left = 1;
+    EXPECT_THROW(map.upsert(99, [&value] { return std::move(value); }, [](auto) {}), std::runtime_error);
+    EXPECT_LT(fragile_field::copies_left, 0);
+    fragile_field::copies_left = 1 << 30;
+
+    EXPECT_EQ(map.size(), 10u);
+    EXPECT_FALSE(map.contains(99));
+    EXPECT_EQ(map.values().field<0>().size(), 10u);
+    EXPECT_EQ(map.values().field<1>().size(), 10u);
+    EXPECT_EQ(map.values().field<2>().size(), 10u);
+    EXPECT_EQ(get<1>(map.at(9)).value, 9);
+}
@@ -0,0 +1,163 @@
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "concurrent_discrete_map.h"
+#include "differential.h"
+
+using concurrent_map = concurrent_discrete_map<std::int64_t, std::int64_t>;
+
+namespace {
+
+const auto concurrent_lookup = [](const concurrent_map& map, std::int64_t key) {
+    return map.find(key);
+};
+
+}
+
+TEST(shard_index, uses_the_high_bits_of_a_mixed_hash) {
+    EXPECT_EQ(shard_index(12345, 0), 0u);
+    // identity hashes of consecutive keys still spread over all the shards.
+    std::vector<int> hits(16, 0);
+    for (size_t k = 0; k < 1600; ++k) {
+        ++hits[shard_index(k, 4)];
+    }
+    for (int h : hits) {
+        EXPECT_GT(h, 50);
+    }
+}
+
+TEST(concurrent_discrete_map, rejects_bad_shard_counts) {
+    EXPECT_THROW(concurrent_map(0), std::invalid_argument);
+    EXPECT_THROW(concurrent_map(6), std::invalid_argument);
+}
+
+TEST(concurrent_discrete_map, random_operations_match_unordered_map) {
+    concurrent_map map(8);
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(2000);
+
+    for (int step = 0; step < 40000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 35) {
+            EXPECT_EQ(map.insert({k, step}), reference.emplace(k, step).second);
+        }
+        else if (op < 50) {
+            EXPECT_EQ(map.insert_or_assign(k, step), !reference.contains(k));
+            reference[k] = step;
+        }
+        else if (op < 60) {
+            const bool inserted = map.upsert(k, [] { return std::int64_t{1}; }, [](std::int64_t& v) { ++v; });
+            EXPECT_EQ(inserted, !reference.contains(k));
+            ++reference[k];
+        }
+        else if (op < 80) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference, concurrent_lookup);
+}
+
+TEST(concurrent_discrete_map, range_operations_group_by_shard) {
+    concurrent_map map(4);
+    std::vector<std::pair<std::int64_t, std::int64_t>> pairs;
+    for (std::int64_t k = 0; k < 1000; ++k) {
+        pairs.emplace_back(k % 700, k);
+    }
+    // later duplicates are ignored, as with insert().
+    EXPECT_EQ(map.insert(pairs.begin(), pairs.end()), 700u);
+    EXPECT_EQ(map.find(5), std::optional<std::int64_t>(5));
+
+    std::vector<std::int64_t> keys = {1, 2, 900, 3};
+    std::vector<std::optional<std::int64_t>> found;
+    map.find(keys.begin(), keys.end(), std::back_inserter(found));
+    ASSERT_EQ(found.size(), 4u);
+    EXPECT_EQ(found[0], 1);
+    EXPECT_EQ(found[2], std::nullopt);
+    EXPECT_EQ(found[3], 3);
+
+    EXPECT_EQ(map.erase(keys.begin(), keys.end()), 3u);
+    EXPECT_EQ(map.size(), 697u);
+
+    std::int64_t sum = 0;
+    map.for_each([&sum](const std::int64_t&, const std::int64_t& v) { sum += v; });
+    EXPECT_GT(sum, 0);
+}
+
+TEST(concurrent_discrete_map, concurrent_counters_add_up) {
+    concurrent_map map;
+    constexpr int threads = 8;
+    constexpr std::int64_t keys = 500;
+    constexpr int rounds = 2000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&map, t] {
+            for (int r = 0; r < rounds; ++r) {
+                const std::int64_t k = (r * 31 + t) % keys;
+                map.upsert(k, [] { return std::int64_t{1}; }, [](std::int64_t& v) { ++v; });
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+
+    std::int64_t total = 0;
+    map.for_each([&total](const std::int64_t&, const std::int64_t& v) { total += v; });
+    EXPECT_EQ(total, static_cast<std::int64_t>(threads) * rounds);
+}
+
+TEST(concurrent_discrete_map, readers_and_writers_agree_at_the_end) {
+    concurrent_map map(16);
+    constexpr int writers = 4;
+    constexpr std::int64_t per_writer = 3000;
+    std::atomic<bool> stop{false};
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&map, w] {
+            const std::int64_t base = w * per_writer;
+            for (std::int64_t k = base; k < base + per_writer; ++k) {
+                map.insert({k, k * 2});
+            }
+            for (std::int64_t k = base; k < base + per_writer; k += 2) {
+                map.erase(k);
+            }
+        });
+    }
+    threads.emplace_back([&map, &stop] {
+        key_stream stream(writers * per_writer, 99);
+        while (!stop.load(std::memory_order_relaxed)) {
+            const std::int64_t k = stream.key();
+            if (const auto found = map.find(k)) {
+                EXPECT_EQ(*found, k * 2);
+            }
+            map.visit(k, [k](const std::int64_t& v) { EXPECT_EQ(v, k * 2); });
+        }
+    });
+
+    for (int w = 0; w < writers; ++w) {
+        threads[w].join();
+    }
+    stop.store(true);
+    threads.back().join();
+
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 1; k < writers * per_writer; k += 2) {
+        reference.emplace(k, k * 2);
+    }
+    expect_same_contents(map, reference, concurrent_lookup);
+}
@@ -0,0 +1,48 @@
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include <gtest/gtest.h>
+
+#include "batch_probe.h"
+#include "cpu_dispatch.h"
+#include "index_storage.h"
+
+static_assert(std::string_view(simd_level_name(simd_level::scalar)) == "scalar");
+static_assert(std::string_view(simd_level_name(simd_level::sse2)) == "sse2");
+static_assert(std::string_view(simd_level_name(simd_level::avx2)) == "avx2");
+static_assert(std::string_view(simd_level_name(simd_level::avx512)) == "avx512");
+static_assert(simd_level::scalar < simd_level::sse2 && simd_level::sse2 < simd_level::avx2 && simd_level::avx2 < simd_level::avx512);
+
+TEST(cpu_dispatch, active_level_is_capped_detection) {
+    const simd_level detected = detect_simd_level();
+    const simd_level active = active_simd_level();
+    EXPECT_LE(active, detected);
+    EXPECT_LE(active, static_cast<simd_level>(DISCRETE_MAP_SIMD_LEVEL));
+    EXPECT_TRUE(active == detected || active == static_cast<simd_level>(DISCRETE_MAP_SIMD_LEVEL));
+    // decided once.
+    EXPECT_EQ(active_simd_level(), active);
+}
+
+TEST(cpu_dispatch, detection_agrees_with_the_compiler) {
+    const simd_level detected = detect_simd_level();
+#if defined(__x86_64__) || defined(_M_X64)
+    EXPECT_GE(detected, simd_level::sse2);
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    EXPECT_EQ(detected >= simd_level::avx2, __builtin_cpu_supports("avx2") != 0);
+    EXPECT_EQ(detected >= simd_level::avx512, __builtin_cpu_supports("avx512f") != 0);
+#endif
+#else
+    EXPECT_EQ(detected, simd_level::scalar);
+#endif
+}
+
+TEST(cpu_dispatch, batch_probe_kernel_follows_the_active_level) {
+    const auto kernel = batch_probe_select<keyed_index_slot<size_t, std::int64_t>, std::int64_t>();
+#ifdef DISCRETE_MAP_DISPATCH_X86
+    EXPECT_EQ(kernel != nullptr, active_simd_level() >= simd_level::avx2);
+#else
+    EXPECT_EQ(kernel, nullptr);
+#endif
+}
@@ -0,0 +1,61 @@
+#ifndef DISCRETE_MAP_TESTS_DIFFERENTIAL_H
+#define DISCRETE_MAP_TESTS_DIFFERENTIAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+/**
+ * checks that `map` holds exactly what `reference` (a std::unordered_map) does: same size, every reference key found with its value, and nothing else.
+ *
+ * `lookup(map, key)` returns a pointer to the value stored for key, or nullptr. That keeps this usable for the maps whose lookups return copies or optionals.
+ */
+template<class Map, class Reference, class Lookup>
+void expect_same_contents(const Map& map, const Reference& reference, Lookup&& lookup) {
+    ASSERT_EQ(map.size(), reference.size());
+    for (const auto& [key, value] : reference) {
+        const auto found = lookup(map, key);
+        ASSERT_TRUE(found) << "key " << key << " is missing";
+        EXPECT_EQ(*found, value) << "key " << key << " has the wrong value";
+    }
+}
+
+// the usual case: a map with contains() and at().
+template<class Map, class Reference>
+void expect_same_contents(const Map& map, const Reference& reference) {
+    expect_same_contents(map, reference, [](const Map& m, const auto& key) {
+        return m.contains(key) ? &m.at(key) : nullptr;
+    });
+}
+
+/**
+ * a seeded stream of keys drawn from [0, range), so that inserts, hits, misses and erases all mix.
+ */
+class key_stream {
+    private:
+        std::mt19937_64 _engine;
+        std::uniform_int_distribution<std::int64_t> _keys;
+        std::uniform_int_distribution<int> _ops;
+
+    public:
+        explicit key_stream(std::int64_t range, std::uint64_t seed = 0x5eed)
+            : _engine(seed),
+              _keys(0, range - 1),
+              _ops(0, 99)
+        {}
+
+        std::int64_t key() {
+            return _keys(_engine);
+        }
+
+        // 0..99, for picking which operation to run next.
+        int op() {
+            return _ops(_engine);
+        }
+};
+
+#endif
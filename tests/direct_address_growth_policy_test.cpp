@@ -0,0 +1,122 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "DirectAddressGrowthPolicy.h"
+#include "discrete_map.h"
+#include "discrete_map_view.h"
+#include "differential.h"
+
+using direct_map = discrete_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, std::equal_to<std::int64_t>, std::allocator<std::int64_t>, std::allocator<std::int64_t>, DirectAddressGrowthPolicy>;
+using direct_view = discrete_map_view<std::int64_t, std::int64_t, std::hash<std::int64_t>, std::equal_to<std::int64_t>, DirectAddressGrowthPolicy>;
+
+TEST(DirectAddressGrowthPolicy, picks_direct_mode_for_dense_distinct_hashes) {
+    DirectAddressGrowthPolicy policy;
+
+    const size_t capacity = policy.relayout(1000, 1099, 100, true, 8);
+    EXPECT_TRUE(policy.is_direct());
+    ASSERT_GE(capacity, 101u);
+    // every hash in the range has a slot of its own, and anything else shares the last one.
+    for (size_t h = 1000; h < 1100; ++h) {
+        EXPECT_LT(policy.get_index(capacity, h), capacity - 1);
+    }
+    for (size_t h = 1000; h + 1 < 1100; ++h) {
+        EXPECT_EQ(policy.get_index(capacity, h) + 1, policy.get_index(capacity, h + 1));
+    }
+    EXPECT_EQ(policy.get_index(capacity, 5), capacity - 1);
+
+    // too sparse, or two elements on one hash: hashed mode.
+    policy.relayout(0, 1000000, 100, true, 128);
+    EXPECT_FALSE(policy.is_direct());
+    policy.relayout(0, 99, 100, false, 128);
+    EXPECT_FALSE(policy.is_direct());
+}
+
+TEST(DirectAddressGrowthPolicy, random_operations_match_unordered_map) {
+    // dense keys first, then a stretch of far-away ones that forces the fallback, then dense again.
+    direct_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(4000);
+
+    for (int step = 0; step < 60000; ++step) {
+        std::int64_t k = stream.key();
+        if (step > 20000 && step < 30000 && k % 5 == 0) {
+            k = k * 1000003;
+        }
+        const int op = stream.op();
+        if (op < 50) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else if (op < 65) {
+            EXPECT_EQ(map.insert({k, step}).second, reference.emplace(k, step).second);
+        }
+        else if (op < 85) {
+            EXPECT_EQ(map.erase(k), reference.erase(k));
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+TEST(DirectAddressGrowthPolicy, negative_and_offset_ranges) {
+    direct_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = -500; k < 500; k += 1 + (k & 1)) {
+        map[k] = -k;
+        reference[k] = -k;
+    }
+    expect_same_contents(map, reference);
+    EXPECT_FALSE(map.contains(-501));
+    EXPECT_FALSE(map.contains(500));
+    EXPECT_FALSE(map.contains(-2));
+}
+
+TEST(DirectAddressGrowthPolicy, snapshots_keep_the_layout) {
+    direct_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 1000; k < 2000; ++k) {
+        map[k] = k * 3;
+        reference[k] = k * 3;
+    }
+
+    std::ostringstream os;
+    map.save(os);
+    const std::string bytes = os.str();
+
+    direct_map loaded;
+    std::istringstream is(bytes);
+    loaded.load(is);
+    expect_same_contents(loaded, reference);
+
+    // a view moved out of keeps the base its snapshot was laid out around.
+    struct deleter {
+        void operator()(unsigned char* p) const {
+            ::operator delete(p, std::align_val_t{snapshot_alignment});
+        }
+    };
+    std::unique_ptr<unsigned char, deleter> memory(static_cast<unsigned char*>(::operator new(bytes.size(), std::align_val_t{snapshot_alignment})));
+    std::memcpy(memory.get(), bytes.data(), bytes.size());
+
+    direct_view original(memory.get(), bytes.size());
+    direct_view moved(std::move(original));
+    expect_same_contents(moved, reference);
+    EXPECT_FALSE(moved.contains(999));
+
+    direct_view assigned(memory.get(), bytes.size());
+    direct_view target(std::move(assigned));
+    assigned = std::move(target);
+    expect_same_contents(assigned, reference);
+    EXPECT_FALSE(assigned.contains(2000));
+}
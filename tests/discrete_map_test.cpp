@@ -0,0 +1,265 @@
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "differential.h"
+#include "thread_pool.h"
+
+using int_map = discrete_map<std::int64_t, std::int64_t>;
+
+namespace {
+
+// the columns have to stay dense and agree with the index, not just answer lookups.
+template<class Map, class Reference>
+void expect_consistent(const Map& map, const Reference& reference) {
+    expect_same_contents(map, reference);
+    ASSERT_EQ(map.keys().size(), map.values().size());
+    for (std::size_t i = 0; i < map.size(); ++i) {
+        const auto it = reference.find(map.keys()[i]);
+        ASSERT_NE(it, reference.end());
+        EXPECT_EQ(map.values()[i], it->second);
+    }
+}
+
+}
+
+TEST(discrete_map, starts_empty) {
+    const int_map map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.size(), 0u);
+    EXPECT_FALSE(map.contains(1));
+    EXPECT_EQ(map.find(1), map.end());
+    EXPECT_THROW(map.at(1), std::out_of_range);
+}
+
+TEST(discrete_map, insert_keeps_the_first_value) {
+    int_map map;
+    EXPECT_TRUE(map.insert({1, 10}).second);
+    const auto [it, inserted] = map.insert({1, 20});
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ((*it).second, 10);
+    EXPECT_EQ(map.at(1), 10);
+}
+
+TEST(discrete_map, insert_converts_other_pairs) {
+    int_map map;
+    EXPECT_TRUE(map.insert(std::make_pair(1, 10)).second);
+    EXPECT_TRUE(map.emplace(2, 20).second);
+    EXPECT_EQ(map.at(1), 10);
+    EXPECT_EQ(map.at(2), 20);
+}
+
+TEST(discrete_map, subscript_inserts_and_grows) {
+    int_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 0; k < 1000; ++k) {
+        map[k * 7] = k;
+        reference[k * 7] = k;
+    }
+    map[7] += 5;
+    reference[7] += 5;
+    expect_consistent(map, reference);
+    EXPECT_LT(map.load_factor(), 1.0f);
+}
+
+TEST(discrete_map, keeps_finding_through_many_rehashes) {
+    int_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    // keys that share their low bits collide at every table size.
+    for (std::int64_t k = 0; k < 5000; ++k) {
+        map.insert({k << 12, k});
+        reference.emplace(k << 12, k);
+    }
+    expect_consistent(map, reference);
+}
+
+TEST(discrete_map, reserve_makes_room_up_front) {
+    int_map map(1000);
+    EXPECT_TRUE(map.empty());
+    for (std::int64_t k = 0; k < 1000; ++k) {
+        map.insert({k, k});
+    }
+    EXPECT_EQ(map.size(), 1000u);
+}
+
+TEST(discrete_map, erase_keeps_clusters_reachable) {
+    int_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 0; k < 64; ++k) {
+        map.insert({k * 64, k});
+        reference.emplace(k * 64, k);
+    }
+    for (std::int64_t k = 0; k < 64; k += 3) {
+        EXPECT_TRUE(map.erase(k * 64));
+        reference.erase(k * 64);
+    }
+    EXPECT_FALSE(map.erase(12345));
+    expect_consistent(map, reference);
+}
+
+TEST(discrete_map, erase_range_shifts_the_columns) {
+    int_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        map.insert({k, k});
+    }
+    map.erase(map.cbegin() + 10, map.cbegin() + 40);
+    for (std::size_t i = 0; i < map.size(); ++i) {
+        reference.emplace(map.keys()[i], map.values()[i]);
+    }
+    EXPECT_EQ(map.size(), 70u);
+    expect_consistent(map, reference);
+}
+
+TEST(discrete_map, random_operations_match_unordered_map) {
+    int_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(2000);
+
+    for (int step = 0; step < 50000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 40) {
+            EXPECT_EQ(map.insert({k, step}).second, reference.emplace(k, step).second);
+        }
+        else if (op < 55) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else if (op < 75) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_consistent(map, reference);
+}
+
+TEST(discrete_map, string_keys_match_unordered_map) {
+    discrete_map<std::string, int> map;
+    std::unordered_map<std::string, int> reference;
+    key_stream stream(500);
+
+    for (int step = 0; step < 5000; ++step) {
+        const std::string k = "key-" + std::to_string(stream.key());
+        if (stream.op() < 70) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+    }
+    expect_consistent(map, reference);
+}
+
+TEST(discrete_map, copies_and_moves_are_independent) {
+    int_map map;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        map.insert({k, k});
+    }
+    int_map copy(map);
+    copy.erase(5);
+    EXPECT_TRUE(map.contains(5));
+    EXPECT_FALSE(copy.contains(5));
+
+    const int_map moved(std::move(copy));
+    EXPECT_EQ(moved.size(), 99u);
+    EXPECT_TRUE(moved.contains(6));
+}
+
+TEST(discrete_map, move_only_values) {
+    discrete_map<int, std::unique_ptr<int>> map;
+    for (int k = 0; k < 100; ++k) {
+        map[k] = std::make_unique<int>(k);
+    }
+    map.erase(10);
+    for (int k = 0; k < 100; ++k) {
+        if (k == 10) {
+            EXPECT_FALSE(map.contains(k));
+            continue;
+        }
+        ASSERT_TRUE(map.contains(k));
+        EXPECT_EQ(*map.at(k), k);
+    }
+}
+
+TEST(discrete_map, clear_keeps_it_usable) {
+    int_map map;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        map.insert({k, k});
+    }
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.contains(1));
+    map.insert({1, 2});
+    EXPECT_EQ(map.at(1), 2);
+}
+
+//bulk operations
+
+TEST(discrete_map_bulk, for_each_visits_every_element_once) {
+    thread_pool pool(4);
+    int_map map;
+    // enough elements that parallel_chunks actually splits them.
+    for (std::int64_t k = 0; k < 50000; ++k) {
+        map.insert({k, 0});
+    }
+    map.for_each(pool, [](const std::int64_t& key, std::int64_t& value) {
+        value += key + 1;
+    });
+    for (std::int64_t k = 0; k < 50000; ++k) {
+        ASSERT_EQ(map.at(k), k + 1);
+    }
+}
+
+TEST(discrete_map_bulk, transform_values_replaces_every_value) {
+    thread_pool pool(4);
+    int_map map;
+    for (std::int64_t k = 0; k < 50000; ++k) {
+        map.insert({k, k});
+    }
+    map.transform_values(pool, [](const std::int64_t&, const std::int64_t& value) {
+        return value * 2;
+    });
+    for (std::int64_t k = 0; k < 50000; ++k) {
+        ASSERT_EQ(map.at(k), 2 * k);
+    }
+}
+
+TEST(discrete_map_bulk, erase_if_matches_unordered_map) {
+    thread_pool pool(4);
+    int_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 0; k < 50000; ++k) {
+        map.insert({k * 3, k});
+        reference.emplace(k * 3, k);
+    }
+    const auto doomed = [](const std::int64_t& key, const std::int64_t& value) {
+        return key % 2 == 0 || value % 7 == 0;
+    };
+    const std::size_t erased = map.erase_if(pool, doomed);
+    EXPECT_EQ(erased, std::erase_if(reference, [&](const auto& kv) { return doomed(kv.first, kv.second); }));
+    expect_consistent(map, reference);
+}
+
+TEST(discrete_map_bulk, exceptions_reach_the_caller) {
+    thread_pool pool(4);
+    int_map map;
+    for (std::int64_t k = 0; k < 50000; ++k) {
+        map.insert({k, k});
+    }
+    EXPECT_THROW(map.for_each(pool, [](const std::int64_t& key, std::int64_t&) {
+        if (key == 40000) {
+            throw std::runtime_error("boom");
+        }
+    }), std::runtime_error);
+}
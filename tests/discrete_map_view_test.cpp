@@ -0,0 +1,195 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "discrete_map_view.h"
+#include "differential.h"
+
+using int_map = discrete_map<std::int64_t, std::int64_t>;
+using int_view = discrete_map_view<std::int64_t, std::int64_t>;
+
+namespace {
+
+// a copy of a snapshot in memory aligned the way a mapping would be.
+class aligned_snapshot {
+    private:
+        struct deleter {
+            void operator()(unsigned char* p) const {
+                ::operator delete(p, std::align_val_t{snapshot_alignment});
+            }
+        };
+
+        std::unique_ptr<unsigned char, deleter> _bytes;
+        size_t _size;
+
+    public:
+        explicit aligned_snapshot(const std::string& bytes)
+            : _bytes(static_cast<unsigned char*>(::operator new(bytes.size() + snapshot_alignment, std::align_val_t{snapshot_alignment}))),
+              _size(bytes.size())
+        {
+            std::memcpy(_bytes.get(), bytes.data(), bytes.size());
+        }
+
+        unsigned char* data() const {
+            return _bytes.get();
+        }
+
+        size_t size() const {
+            return _size;
+        }
+
+        snapshot_header header() const {
+            snapshot_header header;
+            std::memcpy(&header, data(), sizeof(header));
+            return header;
+        }
+
+        void set_header(const snapshot_header& header) {
+            std::memcpy(data(), &header, sizeof(header));
+        }
+};
+
+template<class Map>
+std::string save_to_string(const Map& map) {
+    std::ostringstream os;
+    map.save(os);
+    return os.str();
+}
+
+std::unordered_map<std::int64_t, std::int64_t> fill(int_map& map, std::int64_t n) {
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 0; k < n; ++k) {
+        map[k * 7 - 300] = k * k;
+        reference[k * 7 - 300] = k * k;
+    }
+    return reference;
+}
+
+}
+
+TEST(discrete_map_view, matches_the_map_it_was_saved_from) {
+    int_map map;
+    const auto reference = fill(map, 2000);
+    const aligned_snapshot snapshot(save_to_string(map));
+
+    const int_view view(snapshot.data(), snapshot.size());
+    expect_same_contents(view, reference);
+    EXPECT_FALSE(view.contains(2));
+    EXPECT_EQ(view.find(2), view.end());
+    EXPECT_THROW(view.at(2), std::out_of_range);
+
+    size_t visited = 0;
+    for (const auto [key, value] : view) {
+        EXPECT_EQ(reference.at(key), value);
+        ++visited;
+    }
+    EXPECT_EQ(visited, reference.size());
+}
+
+TEST(discrete_map_view, maps_a_file) {
+    int_map map;
+    const auto reference = fill(map, 300);
+    const std::string path = ::testing::TempDir() + "discrete_map_view_test.snapshot";
+    {
+        std::ofstream out(path, std::ios::binary);
+        map.save(out);
+    }
+
+    const int_view view(path);
+    expect_same_contents(view, reference);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(int_view("/nonexistent/discrete_map_view_test.snapshot"), std::system_error);
+}
+
+TEST(discrete_map_view, rejects_unaligned_memory) {
+    int_map map;
+    fill(map, 10);
+    const std::string bytes = save_to_string(map);
+    const aligned_snapshot snapshot(bytes + std::string(8, '\0'));
+
+    // the same bytes one word further on.
+    std::memmove(snapshot.data() + 8, snapshot.data(), bytes.size());
+    EXPECT_THROW(int_view(snapshot.data() + 8, bytes.size()), std::runtime_error);
+}
+
+TEST(discrete_map_view, rejects_sections_past_the_end) {
+    int_map map;
+    fill(map, 100);
+    aligned_snapshot snapshot(save_to_string(map));
+    const snapshot_header good = snapshot.header();
+
+    // a count this large wraps offset + count * sizeof round to something small.
+    snapshot_header header = good;
+    header.element_count = std::numeric_limits<std::uint64_t>::max() / sizeof(std::int64_t) + 2;
+    snapshot.set_header(header);
+    EXPECT_THROW(int_view(snapshot.data(), snapshot.size()), std::runtime_error);
+
+    header = good;
+    header.indices_offset = std::numeric_limits<std::uint64_t>::max() - snapshot_alignment + 1;
+    snapshot.set_header(header);
+    EXPECT_THROW(int_view(snapshot.data(), snapshot.size()), std::runtime_error);
+
+    header = good;
+    header.index_capacity = good.index_capacity + 1;
+    snapshot.set_header(header);
+    EXPECT_THROW(int_view(snapshot.data(), snapshot.size()), std::runtime_error);
+}
+
+TEST(discrete_map_view, rejects_slots_past_the_columns) {
+    int_map map;
+    fill(map, 100);
+    aligned_snapshot snapshot(save_to_string(map));
+    const snapshot_header header = snapshot.header();
+
+    const auto* keys = reinterpret_cast<const std::int64_t*>(snapshot.data() + header.keys_offset);
+    auto* slots = reinterpret_cast<int_map::index_slot_type*>(snapshot.data() + header.indices_offset);
+    std::int64_t damaged_key = 0;
+    for (std::uint64_t i = 0; i < header.index_capacity; ++i) {
+        if (slots[i].has_value()) {
+            damaged_key = keys[slots[i].value()];
+            slots[i] = int_map::index_slot_type(header.element_count, slots[i].fingerprint());
+            break;
+        }
+    }
+
+    // the table isn't scanned when the view opens, only when a lookup reaches the bad slot.
+    const int_view view(snapshot.data(), snapshot.size());
+    EXPECT_THROW(view.contains(damaged_key), std::runtime_error);
+}
+
+TEST(discrete_map_view, lookups_stop_on_a_table_without_empty_slots) {
+    int_map map;
+    fill(map, 50);
+    aligned_snapshot snapshot(save_to_string(map));
+    const snapshot_header header = snapshot.header();
+
+    auto* slots = reinterpret_cast<int_map::index_slot_type*>(snapshot.data() + header.indices_offset);
+    int_map::index_slot_type engaged;
+    for (std::uint64_t i = 0; i < header.index_capacity; ++i) {
+        if (slots[i].has_value()) {
+            engaged = slots[i];
+        }
+    }
+    for (std::uint64_t i = 0; i < header.index_capacity; ++i) {
+        if (!slots[i].has_value()) {
+            slots[i] = engaged;
+        }
+    }
+
+    const int_view view(snapshot.data(), snapshot.size());
+    EXPECT_FALSE(view.contains(123456789));
+}
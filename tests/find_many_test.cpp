@@ -0,0 +1,107 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "differential.h"
+#include "index_storage.h"
+
+template<class Key, class T>
+using keyed_map = discrete_map<Key, T, std::hash<Key>, std::equal_to<Key>, std::allocator<Key>, std::allocator<T>, BitwiseGrowthPolicy, linear_prober, NullStatsPolicy, heap_index_storage, keyed_index_slots>;
+
+namespace {
+
+// find_many() must agree with find() key by key, whichever path it takes.
+template<class Map>
+void expect_find_many_matches_find(const Map& map, const std::vector<typename Map::key_type>& keys) {
+    std::vector<size_t> positions(keys.size(), 12345);
+    const size_t found = map.find_many(keys, positions);
+
+    size_t expected_found = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const auto it = map.find(keys[i]);
+        if (it == map.end()) {
+            EXPECT_EQ(positions[i], Map::npos) << "key " << i;
+        }
+        else {
+            ++expected_found;
+            ASSERT_LT(positions[i], map.size()) << "key " << i;
+            EXPECT_EQ(map.keys()[positions[i]], keys[i]);
+        }
+    }
+    EXPECT_EQ(found, expected_found);
+}
+
+template<class Map>
+void random_batches(std::int64_t range) {
+    Map map;
+    key_stream stream(range);
+    for (int i = 0; i < 3000; ++i) {
+        const auto k = static_cast<typename Map::key_type>(stream.key());
+        if (stream.op() < 70) {
+            map[k] = i;
+        }
+        else {
+            map.erase(k);
+        }
+    }
+
+    // odd lengths leave a tail the four-wide kernel can't take.
+    for (size_t length : {0u, 1u, 3u, 4u, 63u, 64u, 65u, 1001u}) {
+        std::vector<typename Map::key_type> keys;
+        for (size_t i = 0; i < length; ++i) {
+            keys.push_back(static_cast<typename Map::key_type>(stream.key()));
+        }
+        expect_find_many_matches_find(map, keys);
+    }
+}
+
+}
+
+TEST(find_many, matches_find) {
+    random_batches<discrete_map<std::int64_t, int>>(5000);
+    random_batches<keyed_map<std::int64_t, int>>(5000);
+    random_batches<keyed_map<std::int32_t, int>>(5000);
+    random_batches<keyed_map<std::uint32_t, int>>(5000);
+}
+
+TEST(find_many, negative_and_colliding_keys) {
+    keyed_map<std::int64_t, int> map;
+    std::vector<std::int64_t> keys;
+    // multiples of a power of two share a home slot until the table outgrows them.
+    for (std::int64_t i = -300; i < 300; ++i) {
+        map[i * 1024] = static_cast<int>(i);
+        keys.push_back(i * 1024);
+        keys.push_back(i * 1024 + 1);
+    }
+    expect_find_many_matches_find(map, keys);
+}
+
+TEST(find_many, string_keys) {
+    discrete_map<std::string, int> map;
+    std::vector<std::string> keys;
+    for (int i = 0; i < 500; ++i) {
+        if (i % 2 == 0) {
+            map[std::to_string(i)] = i;
+        }
+        keys.push_back(std::to_string(i));
+    }
+    expect_find_many_matches_find(map, keys);
+}
+
+TEST(find_many, rejects_short_positions) {
+    keyed_map<std::int64_t, int> map;
+    map[1] = 1;
+    const std::vector<std::int64_t> keys = {1, 2, 3};
+    std::vector<size_t> positions(2);
+    EXPECT_THROW(map.find_many(keys, positions), std::length_error);
+
+    positions.resize(4);
+    EXPECT_EQ(map.find_many(keys, positions), 1u);
+}
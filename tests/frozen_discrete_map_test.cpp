@@ -0,0 +1,70 @@
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "discrete_map.h"
+#include "frozen_discrete_map.h"
+
+TEST(frozen_discrete_map, matches_the_map_it_froze) {
+    for (const std::int64_t n : {0, 1, 2, 5, 100, 10000}) {
+        discrete_map<std::int64_t, std::int64_t> source;
+        std::unordered_map<std::int64_t, std::int64_t> reference;
+        key_stream stream(n * 10 + 1, static_cast<std::uint64_t>(n));
+        while (static_cast<std::int64_t>(reference.size()) < n) {
+            const std::int64_t k = stream.key();
+            source[k] = k * 2;
+            reference[k] = k * 2;
+        }
+
+        const frozen_discrete_map<std::int64_t, std::int64_t> frozen(source);
+        expect_same_contents(frozen, reference);
+        // keys outside the set still land on some position, and must be told apart there.
+        for (std::int64_t k = -100; k < 0; ++k) {
+            EXPECT_FALSE(frozen.contains(k));
+            EXPECT_EQ(frozen.find(k), frozen.end());
+        }
+        EXPECT_THROW(frozen.at(-1), std::out_of_range);
+        // the source is left alone.
+        EXPECT_EQ(source.size(), reference.size());
+    }
+}
+
+TEST(frozen_discrete_map, index_is_a_few_bits_per_key) {
+    discrete_map<std::int64_t, int> source;
+    for (std::int64_t k = 0; k < 100000; ++k) {
+        source[k * 7919] = static_cast<int>(k);
+    }
+    const frozen_discrete_map<std::int64_t, int> frozen(source);
+    ASSERT_EQ(frozen.size(), 100000u);
+    // under a byte a key, where discrete_map spends a whole slot.
+    EXPECT_LT(frozen.index_bytes(), frozen.size());
+}
+
+TEST(frozen_discrete_map, string_keys_and_ranges) {
+    std::vector<std::pair<std::string, int>> pairs;
+    std::unordered_map<std::string, int> reference;
+    for (int i = 0; i < 2000; ++i) {
+        pairs.emplace_back("key" + std::to_string(i), i);
+        reference.emplace("key" + std::to_string(i), i);
+    }
+    const frozen_discrete_map<std::string, int> frozen(pairs.begin(), pairs.end());
+    expect_same_contents(frozen, reference);
+    EXPECT_FALSE(frozen.contains("key2000"));
+
+    size_t visited = 0;
+    for (const auto [key, value] : frozen) {
+        EXPECT_EQ(reference.at(key), value);
+        ++visited;
+    }
+    EXPECT_EQ(visited, reference.size());
+
+    const frozen_discrete_map<int, char> small{{1, 'a'}, {2, 'b'}};
+    EXPECT_EQ(small.at(2), 'b');
+}
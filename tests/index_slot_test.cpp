@@ -0,0 +1,117 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "discrete_map.h"
+#include "index_storage.h"
+#include "StatsPolicy.h"
+
+namespace {
+
+// every key gets the same hash, so every slot carries the same fingerprint.
+struct constant_hash {
+    size_t operator()(const std::string&) const noexcept {
+        return 42;
+    }
+};
+
+}
+
+template<class Hash>
+using string_counting_map = discrete_map<std::string, int, Hash, std::equal_to<std::string>, std::allocator<std::string>, std::allocator<int>, BitwiseGrowthPolicy, linear_prober, CountingStatsPolicy>;
+
+using wide_slot = index_slot<std::uint64_t>;
+using narrow_slot = index_slot<std::uint32_t>;
+
+static_assert(wide_slot::fingerprint_bits == 16);
+static_assert(wide_slot::max_elements == (std::uint64_t(1) << 48) - 2);
+// too narrow to spare any bits.
+static_assert(narrow_slot::fingerprint_bits == 0);
+static_assert(narrow_slot::max_elements == 0xFFFFFFFEu);
+static_assert(narrow_slot::fingerprint_of(12345) == 0);
+
+TEST(index_slot, packs_element_and_fingerprint) {
+    const wide_slot empty;
+    EXPECT_FALSE(empty.has_value());
+    EXPECT_EQ(empty, wide_slot(std::nullopt));
+
+    for (const size_t hash : {size_t(0), size_t(1), size_t(0xDEADBEEF), ~size_t(0)}) {
+        const std::uint64_t fingerprint = wide_slot::fingerprint_of(hash);
+        // only the top bits, whatever the hash.
+        EXPECT_EQ(fingerprint & ((std::uint64_t(1) << 48) - 1), 0u);
+
+        for (const std::uint64_t element : {std::uint64_t(0), std::uint64_t(7), wide_slot::max_elements}) {
+            wide_slot slot(element, fingerprint);
+            ASSERT_TRUE(slot.has_value());
+            EXPECT_EQ(slot.value(), element);
+            EXPECT_EQ(slot.fingerprint(), fingerprint);
+            EXPECT_TRUE(slot.may_match(fingerprint));
+
+            slot.relink(3);
+            EXPECT_EQ(slot.value(), 3u);
+            EXPECT_EQ(slot.fingerprint(), fingerprint);
+
+            slot = std::nullopt;
+            EXPECT_FALSE(slot.has_value());
+        }
+    }
+
+    // small integers hash to themselves, and still get fingerprints apart.
+    EXPECT_NE(wide_slot::fingerprint_of(1), wide_slot::fingerprint_of(2));
+    EXPECT_FALSE(wide_slot(0, wide_slot::fingerprint_of(1)).may_match(wide_slot::fingerprint_of(2)));
+
+    const narrow_slot narrow(5, 0);
+    EXPECT_EQ(narrow.value(), 5u);
+    EXPECT_TRUE(narrow.may_match(narrow_slot::fingerprint_of(99)));
+}
+
+TEST(index_slot, misses_rarely_reach_the_key_column) {
+    string_counting_map<std::hash<std::string>> map;
+    for (int i = 0; i < 20000; ++i) {
+        map["key" + std::to_string(i)] = i;
+    }
+    map.reset_stats();
+
+    for (int i = 0; i < 20000; ++i) {
+        ASSERT_FALSE(map.contains("miss" + std::to_string(i)));
+    }
+    // a 16-bit fingerprint lets roughly one in 65536 foreign slots through.
+    EXPECT_GT(map.stats().probes, 20000u);
+    EXPECT_LT(map.stats().key_comparisons, 20u);
+
+    map.reset_stats();
+    for (int i = 0; i < 20000; ++i) {
+        ASSERT_TRUE(map.contains("key" + std::to_string(i)));
+    }
+    EXPECT_GE(map.stats().key_comparisons, 20000u);
+    EXPECT_LT(map.stats().key_comparisons, 20020u);
+}
+
+TEST(index_slot, equal_fingerprints_fall_back_to_the_keys) {
+    // nothing for the fingerprints to tell apart, so every occupied slot is a comparison, and erases that move elements must relink their slots.
+    string_counting_map<constant_hash> map;
+    std::unordered_map<std::string, int> reference;
+    key_stream stream(300);
+    for (int step = 0; step < 3000; ++step) {
+        const std::string k = std::to_string(stream.key());
+        if (stream.op() < 60) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+    }
+    expect_same_contents(map, reference);
+
+    map.reset_stats();
+    EXPECT_FALSE(map.contains("absent"));
+    EXPECT_EQ(map.stats().key_comparisons, reference.size());
+}
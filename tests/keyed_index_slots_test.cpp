@@ -0,0 +1,70 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "differential.h"
+#include "index_storage.h"
+
+template<class Key, class T>
+using keyed_map = discrete_map<Key, T, std::hash<Key>, std::equal_to<Key>, std::allocator<Key>, std::allocator<T>, BitwiseGrowthPolicy, linear_prober, NullStatsPolicy, heap_index_storage, keyed_index_slots>;
+
+enum class colour : std::uint8_t { red, green, blue };
+
+TEST(keyed_index_slots, are_opt_in) {
+    // the default keeps integer keys out of the index, so its table stays at 8 bytes a slot.
+    EXPECT_EQ(sizeof(discrete_map<std::int64_t, int>::index_slot_type), 8u);
+    EXPECT_EQ(sizeof(discrete_map<int, int>::index_slot_type), 8u);
+
+    EXPECT_TRUE((std::is_same_v<keyed_map<std::int64_t, int>::index_slot_type, keyed_index_slot<size_t, std::int64_t>>));
+    EXPECT_TRUE((std::is_same_v<keyed_map<colour, int>::index_slot_type, keyed_index_slot<size_t, colour>>));
+    // keys that don't fit fall back to index_slot even when asked.
+    EXPECT_TRUE((std::is_same_v<keyed_map<std::string, int>::index_slot_type, index_slot<size_t>>));
+}
+
+TEST(keyed_index_slots, random_operations_match_unordered_map) {
+    keyed_map<std::int64_t, std::int64_t> map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(3000);
+
+    for (int step = 0; step < 50000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 45) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else if (op < 70) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+TEST(keyed_index_slots, small_and_pointer_keys) {
+    keyed_map<colour, int> colours;
+    colours[colour::red] = 1;
+    colours[colour::blue] = 3;
+    EXPECT_EQ(colours.at(colour::red), 1);
+    EXPECT_FALSE(colours.contains(colour::green));
+
+    std::vector<int> storage(100);
+    keyed_map<const int*, std::size_t> pointers;
+    for (std::size_t i = 0; i < storage.size(); ++i) {
+        pointers[&storage[i]] = i;
+    }
+    for (std::size_t i = 0; i < storage.size(); ++i) {
+        ASSERT_EQ(pointers.at(&storage[i]), i);
+    }
+    EXPECT_FALSE(pointers.contains(nullptr));
+}
@@ -0,0 +1,133 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "differential.h"
+#include "LatencyStatsPolicy.h"
+
+using latency_map = discrete_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, std::equal_to<std::int64_t>, std::allocator<std::int64_t>, std::allocator<std::int64_t>, BitwiseGrowthPolicy, linear_prober, LatencyStatsPolicy>;
+
+TEST(latency_histogram, buckets_round_trip) {
+    for (std::uint64_t ns : {0ull, 1ull, 31ull, 32ull, 33ull, 1000ull, 123456789ull}) {
+        const size_t bucket = latency_histogram::bucket_of(ns);
+        EXPECT_GE(latency_histogram::bucket_upper_bound(bucket), ns);
+        // within the ~3% the layout promises.
+        EXPECT_LE(latency_histogram::bucket_upper_bound(bucket), ns + ns / 32 + 1);
+    }
+    EXPECT_EQ(latency_histogram::bucket_of(~std::uint64_t(0)), latency_histogram::bucket_count - 1);
+
+    latency_histogram h;
+    for (std::uint64_t ns = 1; ns <= 100; ++ns) {
+        ++h.counts[latency_histogram::bucket_of(ns)];
+        h.max = ns;
+    }
+    EXPECT_EQ(h.count(), 100u);
+    EXPECT_EQ(h.percentile(50), 50u);
+    EXPECT_EQ(h.percentile(100), 100u);
+}
+
+TEST(LatencyStatsPolicy, random_operations_match_unordered_map) {
+    latency_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(2000);
+
+    for (int step = 0; step < 20000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 40) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else if (op < 60) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+TEST(LatencyStatsPolicy, times_every_entry_point) {
+    latency_map map;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        map[k] = k;
+    }
+    map.insert({1000, 1});
+    for (std::int64_t k = 0; k < 10; ++k) {
+        EXPECT_TRUE(map.contains(k));
+    }
+    map.erase(5);
+
+    std::vector<std::int64_t> keys(50);
+    std::vector<size_t> positions(50);
+    for (std::int64_t i = 0; i < 50; ++i) {
+        keys[i] = i * 3;
+    }
+    map.find_many(keys, positions);
+    map.find_many(keys, positions);
+
+    const latency_stats stats = map.latency();
+    EXPECT_EQ(stats[stats_op::insert].count(), 101u);
+    EXPECT_EQ(stats[stats_op::find].count(), 10u);
+    EXPECT_EQ(stats[stats_op::erase].count(), 1u);
+    // one sample per batch.
+    EXPECT_EQ(stats[stats_op::find_many].count(), 2u);
+    EXPECT_GT(stats[stats_op::rehash].count(), 0u);
+
+    map.reset_stats();
+    EXPECT_EQ(map.latency()[stats_op::insert].count(), 0u);
+}
+
+TEST(LatencyStatsPolicy, threads_record_into_their_own_buffers) {
+    LatencyStatsPolicy policy;
+    constexpr int threads = 4;
+    constexpr int records = 1000;
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&policy] {
+            for (int i = 0; i < records; ++i) {
+                policy.record(stats_op::find, 100);
+            }
+        });
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+    EXPECT_EQ(policy.latency()[stats_op::find].count(), static_cast<std::uint64_t>(threads) * records);
+
+    const LatencyStatsPolicy copy(policy);
+    EXPECT_EQ(copy.latency()[stats_op::find].count(), static_cast<std::uint64_t>(threads) * records);
+}
+
+TEST(LatencyStatsPolicy, short_lived_policies_keep_to_themselves) {
+    // policies come and go at the same few addresses; each one must only ever see its own samples, however many the thread has used.
+    for (int round = 0; round < 2000; ++round) {
+        auto policy = std::make_unique<LatencyStatsPolicy>();
+        policy->record(stats_op::insert, 10);
+        policy->record(stats_op::insert, 20);
+        ASSERT_EQ(policy->latency()[stats_op::insert].count(), 2u);
+    }
+
+    // more live policies than the thread's cache holds, used in turn.
+    std::vector<std::unique_ptr<LatencyStatsPolicy>> policies;
+    for (int i = 0; i < 10; ++i) {
+        policies.push_back(std::make_unique<LatencyStatsPolicy>());
+    }
+    for (int round = 0; round < 5; ++round) {
+        for (auto& policy : policies) {
+            policy->record(stats_op::erase, 1);
+        }
+    }
+    for (const auto& policy : policies) {
+        EXPECT_EQ(policy->latency()[stats_op::erase].count(), 5u);
+    }
+}
@@ -0,0 +1,105 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "counting_allocator.h"
+#include "differential.h"
+#include "discrete_map.h"
+#include "memory_usage.h"
+
+using counted_map = discrete_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, std::equal_to<std::int64_t>, counting_allocator<std::int64_t>, counting_allocator<std::int64_t>>;
+
+TEST(memory_usage, columns_match_what_was_allocated) {
+    auto key_counters = std::make_shared<allocation_counters>();
+    auto value_counters = std::make_shared<allocation_counters>();
+    {
+        counted_map map(0, counting_allocator<std::int64_t>(key_counters), counting_allocator<std::int64_t>(value_counters));
+        std::unordered_map<std::int64_t, std::int64_t> reference;
+        key_stream stream(5000);
+        for (int step = 0; step < 20000; ++step) {
+            const std::int64_t k = stream.key();
+            if (stream.op() < 70) {
+                map[k] = step;
+                reference[k] = step;
+            }
+            else {
+                EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+            }
+        }
+        expect_same_contents(map, reference);
+
+        // the columns are the only thing these allocators hand out.
+        const memory_usage_report report = map.memory_usage();
+        EXPECT_EQ(report.keys, key_counters->live_bytes.load());
+        EXPECT_EQ(report.values, value_counters->live_bytes.load());
+        EXPECT_GE(report.keys, map.size() * sizeof(std::int64_t));
+        EXPECT_EQ(report.slack, report.keys + report.values - 2 * map.size() * sizeof(std::int64_t));
+        EXPECT_GT(report.indices, 0u);
+        EXPECT_EQ(report.key_heap, 0u);
+        EXPECT_EQ(report.value_heap, 0u);
+        EXPECT_EQ(report.total(), report.keys + report.values + report.indices);
+
+        EXPECT_EQ(map.get_key_allocator().counters(), key_counters);
+        EXPECT_EQ(map.get_value_allocator().counters(), value_counters);
+        EXPECT_GE(key_counters->peak_bytes.load(), key_counters->live_bytes.load());
+    }
+    // every allocation was handed back.
+    EXPECT_EQ(key_counters->live_bytes.load(), 0u);
+    EXPECT_EQ(value_counters->live_bytes.load(), 0u);
+    EXPECT_EQ(key_counters->allocations.load(), key_counters->deallocations.load());
+    EXPECT_GT(key_counters->allocations.load(), 0u);
+}
+
+TEST(memory_usage, counters_are_shared_by_copies) {
+    auto counters = std::make_shared<allocation_counters>();
+    counted_map map(0, counting_allocator<std::int64_t>(counters), counting_allocator<std::int64_t>(counters));
+    for (std::int64_t k = 0; k < 100; ++k) {
+        map[k] = k;
+    }
+    const size_t one_map = counters->live_bytes.load();
+    {
+        const counted_map copy(map);
+        EXPECT_EQ(copy.at(50), 50);
+        EXPECT_GT(counters->live_bytes.load(), one_map);
+    }
+    EXPECT_EQ(counters->live_bytes.load(), one_map);
+
+    // a sized constructor reserves, it doesn't fill.
+    const counted_map sized(1000, counting_allocator<std::int64_t>(counters), counting_allocator<std::int64_t>(counters));
+    EXPECT_TRUE(sized.empty());
+    EXPECT_GE(sized.memory_usage().keys, 1000 * sizeof(std::int64_t));
+}
+
+TEST(memory_usage, counts_what_strings_own) {
+    discrete_map<std::string, std::string> map;
+    map["a"] = "b";
+    // short strings stay inside the object.
+    EXPECT_EQ(map.memory_usage().key_heap, 0u);
+    EXPECT_EQ(map.memory_usage().value_heap, 0u);
+
+    const std::string long_key(1000, 'k');
+    const std::string long_value(3000, 'v');
+    map[long_key] = long_value;
+    const memory_usage_report report = map.memory_usage();
+    EXPECT_GE(report.key_heap, 1001u);
+    EXPECT_GE(report.value_heap, 3001u);
+    EXPECT_EQ(report.total(), report.keys + report.values + report.indices + report.key_heap + report.value_heap);
+
+    map.erase(long_key);
+    EXPECT_EQ(map.memory_usage().key_heap, 0u);
+}
+
+TEST(heap_usage, vectors_count_their_elements) {
+    std::vector<std::string> strings(3, std::string(500, 's'));
+    strings.reserve(10);
+    EXPECT_GE(heap_usage<std::vector<std::string>>::bytes(strings), 10 * sizeof(std::string) + 3 * 501);
+    EXPECT_EQ(heap_usage<int>::bytes(5), 0u);
+    static_assert(heap_usage<int>::is_trivial);
+    static_assert(!heap_usage<std::string>::is_trivial);
+}
@@ -0,0 +1,143 @@
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "optimistic_discrete_map.h"
+
+using optimistic_map = optimistic_discrete_map<std::int64_t, std::int64_t>;
+
+namespace {
+
+const auto optimistic_lookup = [](const optimistic_map& map, std::int64_t key) {
+    return map.find(key);
+};
+
+// every value written for key k is a multiple of k's tag, so a reader can tell a torn value from a real one.
+std::int64_t value_for(std::int64_t key, std::int64_t round) {
+    return key * 1000003 + round * 7;
+}
+
+bool plausible(std::int64_t key, std::int64_t value) {
+    return (value - key * 1000003) % 7 == 0;
+}
+
+}
+
+TEST(optimistic_discrete_map, rejects_bad_shard_counts) {
+    EXPECT_THROW(optimistic_map(0), std::invalid_argument);
+    EXPECT_THROW(optimistic_map(3), std::invalid_argument);
+}
+
+TEST(optimistic_discrete_map, random_operations_match_unordered_map) {
+    // a tiny reservation, so shards keep outgrowing their tables.
+    optimistic_map map(4, 2);
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(3000);
+
+    for (int step = 0; step < 40000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 35) {
+            EXPECT_EQ(map.insert({k, step}), reference.emplace(k, step).second);
+        }
+        else if (op < 55) {
+            EXPECT_EQ(map.insert_or_assign(k, step), !reference.contains(k));
+            reference[k] = step;
+        }
+        else if (op < 75) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference, optimistic_lookup);
+}
+
+TEST(optimistic_discrete_map, readers_only_see_written_values) {
+    optimistic_map map(8, 8);
+    constexpr std::int64_t keys = 4000;
+    constexpr int writers = 2;
+    constexpr int readers = 4;
+
+    std::atomic<bool> stop{false};
+    std::atomic<std::int64_t> lookups{0};
+    std::vector<std::thread> threads;
+
+    // each writer owns the keys congruent to its id, so the final state is known.
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&map, w] {
+            for (std::int64_t round = 0; round < 6; ++round) {
+                for (std::int64_t k = w; k < keys; k += writers) {
+                    map.insert_or_assign(k, value_for(k, round));
+                }
+                for (std::int64_t k = w; k < keys; k += 3 * writers) {
+                    map.erase(k);
+                }
+            }
+            for (std::int64_t k = w; k < keys; k += writers) {
+                map.insert_or_assign(k, value_for(k, 100));
+            }
+        });
+    }
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&map, &stop, &lookups, r] {
+            key_stream stream(keys, r + 1);
+            while (!stop.load(std::memory_order_relaxed)) {
+                const std::int64_t k = stream.key();
+                const auto found = map.find(k);
+                if (found) {
+                    EXPECT_TRUE(plausible(k, *found)) << "key " << k << " read " << *found;
+                }
+                lookups.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    for (int w = 0; w < writers; ++w) {
+        threads[w].join();
+    }
+    stop.store(true);
+    for (int r = 0; r < readers; ++r) {
+        threads[writers + r].join();
+    }
+
+    EXPECT_GT(lookups.load(), 0);
+    ASSERT_EQ(map.size(), static_cast<std::size_t>(keys));
+    for (std::int64_t k = 0; k < keys; ++k) {
+        const auto found = map.find(k);
+        ASSERT_TRUE(found);
+        EXPECT_EQ(*found, value_for(k, 100));
+    }
+}
+
+TEST(optimistic_discrete_map, readers_survive_table_growth) {
+    // one shard and a small reservation: the table is copied and swapped many times while readers walk it.
+    optimistic_map map(1, 4);
+    std::atomic<bool> done{false};
+
+    std::thread reader([&map, &done] {
+        std::int64_t k = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+            const auto found = map.find(k);
+            if (found) {
+                EXPECT_EQ(*found, value_for(k, 0));
+            }
+            k = (k + 1) % 20000;
+        }
+    });
+
+    for (std::int64_t k = 0; k < 20000; ++k) {
+        map.insert({k, value_for(k, 0)});
+    }
+    done.store(true);
+    reader.join();
+
+    EXPECT_EQ(map.size(), 20000u);
+}
@@ -0,0 +1,107 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "discrete_map.h"
+
+namespace {
+
+// std::hash that counts its calls, so a test can tell how often the map hashed.
+struct counting_hash {
+    static inline size_t calls = 0;
+
+    size_t operator()(std::int64_t k) const noexcept {
+        ++calls;
+        return std::hash<std::int64_t>()(k);
+    }
+};
+
+}
+
+using counted_hash_map = discrete_map<std::int64_t, std::int64_t, counting_hash>;
+
+TEST(prefetch, changes_nothing) {
+    discrete_map<std::int64_t, std::int64_t> map;
+    // nothing to prefetch yet, which must still be safe.
+    map.prefetch(1);
+    map.prefetch_hash(0);
+    EXPECT_TRUE(map.empty());
+
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(10000);
+    for (int step = 0; step < 20000; ++step) {
+        const std::int64_t k = stream.key();
+        map.prefetch(k);
+        map.prefetch_hash(~static_cast<size_t>(step));
+        if (stream.op() < 60) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+TEST(precomputed_hash, find_and_insert_match_the_plain_overloads) {
+    discrete_map<std::int64_t, std::int64_t> map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    const auto hf = map.hash_function();
+    key_stream stream(5000);
+
+    // enough inserts through the hashed overload to rehash several times on the way.
+    for (int step = 0; step < 20000; ++step) {
+        const std::int64_t k = stream.key();
+        const size_t hash = hf(k);
+        const auto it = map.find(k, hash);
+        ASSERT_EQ(it == map.end(), map.find(k) == map.end());
+        if (it == map.end()) {
+            const auto [inserted, fresh] = map.insert({k, step}, hash);
+            EXPECT_TRUE(fresh);
+            EXPECT_EQ((*inserted).second, step);
+            reference.emplace(k, step);
+        }
+        else {
+            // a second insert of the same key is refused, whichever overload finds it.
+            EXPECT_FALSE(map.insert({k, step}, hash).second);
+        }
+    }
+    expect_same_contents(map, reference);
+
+    const auto& const_map = map;
+    for (std::int64_t k = -10; k < 5010; ++k) {
+        EXPECT_EQ(const_map.find(k, hf(k)) == const_map.end(), !reference.contains(k)) << "key " << k;
+    }
+}
+
+TEST(precomputed_hash, hashes_each_key_once) {
+    counted_hash_map map;
+    map.reserve(1000);
+    const counting_hash hf;
+
+    counting_hash::calls = 0;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        const size_t hash = hf(k);
+        map.prefetch_hash(hash);
+        if (map.find(k, hash) == map.end()) {
+            map.insert({k, k}, hash);
+        }
+    }
+    // only the caller's own calls.
+    EXPECT_EQ(counting_hash::calls, 100u);
+
+    counting_hash::calls = 0;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        if (map.find(k) == map.end()) {
+            map.insert({k, k});
+        }
+    }
+    EXPECT_EQ(counting_hash::calls, 100u);
+}
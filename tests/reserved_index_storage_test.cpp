@@ -0,0 +1,90 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "differential.h"
+#include "index_storage.h"
+
+template<class Key, class T>
+using reserved_map = discrete_map<Key, T, std::hash<Key>, std::equal_to<Key>, std::allocator<Key>, std::allocator<T>, BitwiseGrowthPolicy, linear_prober, NullStatsPolicy, reserved_index_storage>;
+
+TEST(reserved_index_storage, random_operations_match_unordered_map) {
+    reserved_map<std::int64_t, std::int64_t> map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(50000);
+
+    for (int step = 0; step < 100000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 55) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else if (op < 75) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference);
+
+    const reserved_map<std::int64_t, std::int64_t> copy(map);
+    expect_same_contents(copy, reference);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+
+using slot_type = index_slot<size_t>;
+
+TEST(reserved_index_storage, reservation_follows_the_table_size) {
+    using storage = reserved_index_storage<slot_type>;
+
+    // a small table reserves room to grow, not 16GB.
+    const storage small(8);
+    EXPECT_GE(small.reserved_bytes(), 8 * storage::growth_headroom * sizeof(slot_type));
+    EXPECT_LT(small.reserved_bytes(), size_t(1) << 20);
+
+    const storage large(size_t(1) << 20);
+    EXPECT_GE(large.reserved_bytes(), (size_t(1) << 20) * storage::growth_headroom * sizeof(slot_type));
+
+    // never past the cap, unless the table itself is bigger.
+    const storage huge(size_t(1) << 30);
+    EXPECT_EQ(huge.reserved_bytes(), storage::max_reservation_bytes);
+
+    // copies size their own reservation from the table they copy.
+    const storage copy(small);
+    EXPECT_EQ(copy.reserved_bytes(), small.reserved_bytes());
+}
+
+template<class Slot>
+using capped_storage = reserved_index_storage<Slot, size_t(1) << 16>;
+
+TEST(reserved_index_storage, cap_is_a_template_parameter) {
+    capped_storage<slot_type> storage(256);
+    EXPECT_EQ(storage.reserved_bytes(), size_t(1) << 16);
+
+    // outgrowing the reservation reserves again, and the new table reads back empty.
+    storage.assign_empty(size_t(1) << 14);
+    EXPECT_EQ(storage.size(), size_t(1) << 14);
+    EXPECT_GE(storage.reserved_bytes(), (size_t(1) << 14) * sizeof(slot_type));
+    for (const slot_type& slot : storage) {
+        ASSERT_FALSE(slot.has_value());
+    }
+
+    discrete_map<int, int, std::hash<int>, std::equal_to<int>, std::allocator<int>, std::allocator<int>, BitwiseGrowthPolicy, linear_prober, NullStatsPolicy, capped_storage> map;
+    for (int k = 0; k < 100000; ++k) {
+        map[k] = k;
+    }
+    for (int k = 0; k < 100000; ++k) {
+        ASSERT_EQ(map.at(k), k);
+    }
+}
+
+#endif
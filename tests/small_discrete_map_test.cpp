@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "small_discrete_map.h"
+
+namespace {
+
+template<class Map>
+void random_operations_match_unordered_map(std::int64_t range) {
+    Map map;
+    std::unordered_map<typename Map::key_type, typename Map::mapped_type> reference;
+    key_stream stream(range);
+
+    for (int step = 0; step < 20000; ++step) {
+        const auto k = static_cast<typename Map::key_type>(stream.key());
+        const auto v = static_cast<typename Map::mapped_type>(step);
+        const int op = stream.op();
+        if (op < 30) {
+            map[k] = v;
+            reference[k] = v;
+        }
+        else if (op < 50) {
+            const auto [it, inserted] = map.insert({k, v});
+            EXPECT_EQ(inserted, reference.emplace(k, v).second);
+            EXPECT_EQ((*it).first, k);
+            EXPECT_EQ((*it).second, reference.at(k));
+        }
+        else if (op < 70) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            const auto it = map.find(k);
+            ASSERT_EQ(it != map.end(), reference.contains(k));
+            if (it != map.end()) {
+                EXPECT_EQ((*it).second, reference.at(k));
+            }
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+}
+
+TEST(small_discrete_map, stays_inline_up_to_n) {
+    small_discrete_map<int, int, 4> map;
+    for (int k = 0; k < 4; ++k) {
+        map[k * 10] = k;
+    }
+    EXPECT_TRUE(map.is_inline());
+    EXPECT_EQ(map.at(30), 3);
+    EXPECT_THROW(map.at(5), std::out_of_range);
+
+    map[40] = 4;
+    EXPECT_FALSE(map.is_inline());
+    for (int k = 0; k < 5; ++k) {
+        EXPECT_EQ(map.at(k * 10), k);
+        EXPECT_EQ((*map.find(k * 10)).second, k);
+    }
+
+    // clear() keeps the large map.
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.is_inline());
+}
+
+TEST(small_discrete_map, random_operations_match_unordered_map) {
+    // small ranges keep the map hovering around N, so both modes get exercised.
+    random_operations_match_unordered_map<small_discrete_map<std::int64_t, std::int64_t, 8>>(12);
+    random_operations_match_unordered_map<small_discrete_map<std::int64_t, std::int64_t, 8>>(200);
+    random_operations_match_unordered_map<small_discrete_map<std::uint8_t, int, 16>>(64);
+    random_operations_match_unordered_map<small_discrete_map<std::int16_t, int, 24>>(30);
+    random_operations_match_unordered_map<small_discrete_map<int, double, 64>>(80);
+}
+
+TEST(small_discrete_map, zero_keys_are_not_matched_by_empty_slots) {
+    small_discrete_map<int, int, 16> map;
+    EXPECT_FALSE(map.contains(0));
+    map[5] = 1;
+    EXPECT_FALSE(map.contains(0));
+    map[0] = 2;
+    EXPECT_EQ(map.at(0), 2);
+    map.erase(0);
+    EXPECT_FALSE(map.contains(0));
+}
+
+TEST(small_discrete_map, non_trivial_keys) {
+    small_discrete_map<std::string, std::string, 4> map;
+    std::unordered_map<std::string, std::string> reference;
+    for (int i = 0; i < 10; ++i) {
+        map[std::to_string(i)] = std::string(i, 'v');
+        reference[std::to_string(i)] = std::string(i, 'v');
+        if (i % 3 == 0) {
+            map.erase(std::to_string(i / 2));
+            reference.erase(std::to_string(i / 2));
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+TEST(small_discrete_map, move_only_values_survive_the_spill) {
+    small_discrete_map<int, std::unique_ptr<int>, 4> map;
+    for (int k = 0; k < 10; ++k) {
+        map.upsert(k, [k] { return std::make_unique<int>(k * 2); }, [](std::unique_ptr<int>&) {});
+    }
+    map[20] = std::make_unique<int>(40);
+
+    EXPECT_FALSE(map.is_inline());
+    for (int k = 0; k < 10; ++k) {
+        ASSERT_NE(map.at(k), nullptr);
+        EXPECT_EQ(*map.at(k), k * 2);
+    }
+    EXPECT_EQ(*map.at(20), 40);
+}
+
+TEST(small_discrete_map, reserve_spills_early) {
+    small_discrete_map<int, int, 4> map{{1, 1}, {2, 2}};
+    map.reserve(3);
+    EXPECT_TRUE(map.is_inline());
+    map.reserve(100);
+    EXPECT_FALSE(map.is_inline());
+    EXPECT_EQ(map.size(), 2u);
+    EXPECT_EQ(map.at(2), 2);
+}
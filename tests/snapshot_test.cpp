@@ -0,0 +1,219 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "discrete_map.h"
+#include "differential.h"
+#include "index_storage.h"
+
+using int_map = discrete_map<std::int64_t, std::int64_t>;
+
+namespace {
+
+enum class colour : std::uint8_t { red, green, blue };
+
+std::string save_to_string(const auto& map) {
+    std::ostringstream os;
+    map.save(os);
+    return os.str();
+}
+
+template<class Map>
+Map load_from_string(const std::string& bytes) {
+    std::istringstream is(bytes);
+    Map map;
+    map.load(is);
+    return map;
+}
+
+snapshot_header header_of(const std::string& bytes) {
+    snapshot_header header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    return header;
+}
+
+// the index section of a snapshot of int_map, as slots.
+std::vector<int_map::index_slot_type> slots_of(const std::string& bytes) {
+    const snapshot_header header = header_of(bytes);
+    std::vector<int_map::index_slot_type> slots(header.index_capacity);
+    std::memcpy(slots.data(), bytes.data() + header.indices_offset, slots.size() * sizeof(slots[0]));
+    return slots;
+}
+
+void replace_slots(std::string& bytes, const std::vector<int_map::index_slot_type>& slots) {
+    std::memcpy(bytes.data() + header_of(bytes).indices_offset, slots.data(), slots.size() * sizeof(slots[0]));
+}
+
+std::unordered_map<std::int64_t, std::int64_t> fill(int_map& map, std::int64_t n) {
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (std::int64_t k = 0; k < n; ++k) {
+        map[k * 13] = k;
+        reference[k * 13] = k;
+    }
+    return reference;
+}
+
+}
+
+TEST(snapshot, round_trips_raw_and_codec_columns) {
+    int_map map;
+    const auto reference = fill(map, 1000);
+    const int_map loaded = load_from_string<int_map>(save_to_string(map));
+    expect_same_contents(loaded, reference);
+    EXPECT_FALSE(loaded.contains(1));
+
+    discrete_map<std::string, std::string> strings;
+    std::unordered_map<std::string, std::string> string_reference;
+    for (int i = 0; i < 200; ++i) {
+        strings[std::to_string(i)] = std::string(i % 17, 'x');
+        string_reference[std::to_string(i)] = std::string(i % 17, 'x');
+    }
+    expect_same_contents(load_from_string<discrete_map<std::string, std::string>>(save_to_string(strings)), string_reference);
+}
+
+TEST(snapshot, rejects_other_streams) {
+    std::istringstream garbage("definitely not a snapshot, but long enough to fill a header........................................................................................................................................................................................................");
+    int_map map;
+    EXPECT_THROW(map.load(garbage), std::runtime_error);
+
+    int_map full;
+    fill(full, 100);
+    std::string bytes = save_to_string(full);
+    bytes.resize(bytes.size() / 2);
+    EXPECT_THROW(load_from_string<int_map>(bytes), std::runtime_error);
+}
+
+TEST(snapshot, index_pointing_past_the_columns_is_rebuilt) {
+    int_map map;
+    const auto reference = fill(map, 500);
+    std::string bytes = save_to_string(map);
+
+    auto slots = slots_of(bytes);
+    for (auto& slot : slots) {
+        if (slot.has_value()) {
+            slot = int_map::index_slot_type(100000, slot.fingerprint());
+            break;
+        }
+    }
+    replace_slots(bytes, slots);
+
+    const int_map loaded = load_from_string<int_map>(bytes);
+    expect_same_contents(loaded, reference);
+}
+
+TEST(snapshot, index_with_repeated_elements_is_rebuilt) {
+    int_map map;
+    const auto reference = fill(map, 500);
+    std::string bytes = save_to_string(map);
+
+    // points one slot at the element of another, so one element goes missing from the index.
+    auto slots = slots_of(bytes);
+    const int_map::index_slot_type* first = nullptr;
+    for (auto& slot : slots) {
+        if (!slot.has_value()) {
+            continue;
+        }
+        if (first == nullptr) {
+            first = &slot;
+        }
+        else {
+            slot = *first;
+            break;
+        }
+    }
+    replace_slots(bytes, slots);
+
+    const int_map loaded = load_from_string<int_map>(bytes);
+    expect_same_contents(loaded, reference);
+}
+
+TEST(snapshot, index_without_empty_slots_is_rebuilt) {
+    int_map map;
+    const auto reference = fill(map, 100);
+    std::string bytes = save_to_string(map);
+
+    // a full table would make every miss walk round it forever.
+    auto slots = slots_of(bytes);
+    int_map::index_slot_type engaged;
+    for (const auto& slot : slots) {
+        if (slot.has_value()) {
+            engaged = slot;
+        }
+    }
+    for (auto& slot : slots) {
+        if (!slot.has_value()) {
+            slot = engaged;
+        }
+    }
+    replace_slots(bytes, slots);
+
+    const int_map loaded = load_from_string<int_map>(bytes);
+    expect_same_contents(loaded, reference);
+    EXPECT_FALSE(loaded.contains(-1));
+}
+
+TEST(snapshot, index_with_a_capacity_the_policy_wont_use_is_rebuilt) {
+    int_map map;
+    const auto reference = fill(map, 2);
+    std::string bytes = save_to_string(map);
+
+    // BitwiseGrowthPolicy masks with capacity - 1, so a 12-slot table only ever reaches slots 0-3 and 8-11. both elements sit where no lookup goes, yet every element is in exactly one slot and some are empty.
+    snapshot_header header = header_of(bytes);
+    const auto* keys = reinterpret_cast<const std::int64_t*>(bytes.data() + header.keys_offset);
+    std::vector<int_map::index_slot_type> slots(12);
+    for (std::size_t i = 0; i < 2; ++i) {
+        slots[4 + i] = int_map::index_slot_type(i, int_map::index_slot_type::fingerprint_of(keys[i], std::hash<std::int64_t>()(keys[i])));
+    }
+    header.index_capacity = slots.size();
+    bytes.resize(header.indices_offset);
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    bytes.append(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(slots[0]));
+
+    const int_map loaded = load_from_string<int_map>(bytes);
+    expect_same_contents(loaded, reference);
+}
+
+TEST(snapshot, keyed_slots_have_no_padding_bytes) {
+    using slot = keyed_index_slot<size_t, colour>;
+    EXPECT_EQ(sizeof(slot), 16u);
+    EXPECT_TRUE(std::has_unique_object_representations_v<slot>);
+    EXPECT_TRUE((std::has_unique_object_representations_v<keyed_index_slot<size_t, std::int32_t>>));
+    EXPECT_TRUE((std::has_unique_object_representations_v<keyed_index_slot<size_t, std::int64_t>>));
+
+    // built over dirty memory, the tail of the slot still comes out zero.
+    alignas(slot) unsigned char storage[sizeof(slot)];
+    std::memset(storage, 0xAB, sizeof(storage));
+    const slot* s = ::new (storage) slot(3, colour::blue);
+    unsigned char bytes[sizeof(slot)];
+    std::memcpy(bytes, s, sizeof(slot));
+    for (size_t i = sizeof(size_t) + sizeof(colour); i < sizeof(slot); ++i) {
+        EXPECT_EQ(bytes[i], 0u) << "byte " << i;
+    }
+}
+
+TEST(snapshot, keyed_slots_round_trip) {
+    using keyed_map = discrete_map<colour, int, std::hash<colour>, std::equal_to<colour>, std::allocator<colour>, std::allocator<int>, BitwiseGrowthPolicy, linear_prober, NullStatsPolicy, heap_index_storage, keyed_index_slots>;
+    keyed_map map;
+    map[colour::red] = 1;
+    map[colour::blue] = 3;
+
+    // the same map saved twice gives the same bytes: nothing uninitialised goes out.
+    const std::string bytes = save_to_string(map);
+    EXPECT_EQ(bytes, save_to_string(map));
+
+    const keyed_map loaded = load_from_string<keyed_map>(bytes);
+    EXPECT_EQ(loaded.at(colour::red), 1);
+    EXPECT_EQ(loaded.at(colour::blue), 3);
+    EXPECT_FALSE(loaded.contains(colour::green));
+}
@@ -0,0 +1,81 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "static_discrete_map.h"
+
+namespace {
+
+enum class method : std::uint8_t { get, put, post, del };
+
+constexpr auto methods = make_static_discrete_map<std::string_view, method>({
+    {"GET", method::get},
+    {"PUT", method::put},
+    {"POST", method::post},
+    {"DELETE", method::del},
+});
+
+// built, and looked up, entirely at compile time.
+static_assert(methods.size() == 4);
+static_assert(methods.at("POST") == method::post);
+static_assert(methods.contains("DELETE"));
+static_assert(!methods.contains("PATCH"));
+static_assert(methods.find("PATCH") == methods.end());
+
+constexpr auto names = make_static_discrete_map<method, std::string_view>({
+    {method::get, "GET"},
+    {method::del, "DELETE"},
+});
+static_assert(names.at(method::del) == "DELETE");
+static_assert(!names.contains(method::put));
+
+// N keys with every home slot crowded into the low end of the table.
+template<size_t N>
+constexpr std::array<std::pair<std::int64_t, std::int64_t>, N> strided_pairs() {
+    std::array<std::pair<std::int64_t, std::int64_t>, N> pairs{};
+    for (size_t i = 0; i < N; ++i) {
+        pairs[i] = {static_cast<std::int64_t>(i) * 1024 - 5000, static_cast<std::int64_t>(i * i)};
+    }
+    return pairs;
+}
+
+}
+
+TEST(static_discrete_map, matches_unordered_map) {
+    // past 255 elements, so the index needs 16-bit slots.
+    static constexpr static_discrete_map<std::int64_t, std::int64_t, 300> map(strided_pairs<300>());
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    for (const auto& [k, v] : strided_pairs<300>()) {
+        reference.emplace(k, v);
+    }
+    expect_same_contents(map, reference);
+    for (std::int64_t k = -5000; k < 300 * 1024; k += 517) {
+        EXPECT_EQ(map.contains(k), reference.contains(k)) << "key " << k;
+    }
+    EXPECT_THROW(map.at(1), std::out_of_range);
+
+    size_t visited = 0;
+    for (const auto [key, value] : map) {
+        EXPECT_EQ(reference.at(key), value);
+        ++visited;
+    }
+    EXPECT_EQ(visited, reference.size());
+}
+
+TEST(static_discrete_map, rejects_duplicate_keys) {
+    const std::array<std::pair<int, int>, 3> pairs = {{{1, 1}, {2, 2}, {1, 3}}};
+    EXPECT_THROW((static_discrete_map<int, int, 3>(pairs)), std::invalid_argument);
+}
+
+TEST(static_discrete_map, empty) {
+    constexpr static_discrete_map<int, int, 0> map(std::array<std::pair<int, int>, 0>{});
+    EXPECT_TRUE(map.empty());
+    EXPECT_FALSE(map.contains(0));
+}
@@ -0,0 +1,86 @@
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "discrete_map.h"
+#include "StatsPolicy.h"
+
+using counting_map = discrete_map<std::int64_t, std::int64_t, std::hash<std::int64_t>, std::equal_to<std::int64_t>, std::allocator<std::int64_t>, std::allocator<std::int64_t>, BitwiseGrowthPolicy, linear_prober, CountingStatsPolicy>;
+
+namespace {
+
+std::uint64_t histogram_total(const probe_stats& s) {
+    return std::accumulate(s.probe_distance_histogram.begin(), s.probe_distance_histogram.end(), std::uint64_t{0});
+}
+
+}
+
+TEST(CountingStatsPolicy, random_operations_match_unordered_map) {
+    counting_map map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(3000);
+
+    for (int step = 0; step < 30000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 45) {
+            map[k] = step;
+            reference[k] = step;
+        }
+        else if (op < 65) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            EXPECT_EQ(map.contains(k), reference.contains(k));
+        }
+    }
+    expect_same_contents(map, reference);
+
+    const probe_stats s = map.stats();
+    EXPECT_GT(s.lookups, 0u);
+    EXPECT_GE(s.probes, s.lookups);
+    EXPECT_EQ(histogram_total(s), s.lookups);
+    EXPECT_GT(s.rehashes, 0u);
+    EXPECT_GE(s.mean_probes(), 1.0);
+}
+
+TEST(CountingStatsPolicy, collisions_show_up_as_probe_distance) {
+    counting_map map;
+    map.reserve(1000);
+    // every key shares a home slot, so each new one probes past all the others.
+    for (std::int64_t i = 0; i < 20; ++i) {
+        map[i << 40] = i;
+    }
+    map.reset_stats();
+
+    EXPECT_TRUE(map.contains(std::int64_t{19} << 40));
+    const probe_stats s = map.stats();
+    EXPECT_EQ(s.lookups, 1u);
+    EXPECT_EQ(s.max_probe_distance, 19u);
+    EXPECT_EQ(s.probes, 20u);
+    // the slots' fingerprints rule the other 19 out without reading the key column.
+    EXPECT_EQ(s.key_comparisons, 1u);
+    EXPECT_EQ(s.rehashes, 0u);
+
+    // copies carry the counts over.
+    const counting_map copy(map);
+    EXPECT_EQ(copy.stats().lookups, 1u);
+}
+
+TEST(NullStatsPolicy, reports_nothing) {
+    discrete_map<std::int64_t, std::int64_t> map;
+    for (std::int64_t k = 0; k < 1000; ++k) {
+        map[k] = k;
+        EXPECT_TRUE(map.contains(k));
+    }
+    const probe_stats s = map.stats();
+    EXPECT_EQ(s.lookups, 0u);
+    EXPECT_EQ(s.rehashes, 0u);
+    EXPECT_EQ(s.mean_probes(), 0.0);
+}
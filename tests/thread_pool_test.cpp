@@ -0,0 +1,107 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "thread_pool.h"
+
+namespace {
+
+// accepts `accept` tasks, runs them on pool, then throws for the next one.
+class failing_executor {
+    private:
+        thread_pool& _pool;
+        std::size_t _accept;
+
+    public:
+        failing_executor(thread_pool& pool, std::size_t accept)
+            : _pool(pool),
+              _accept(accept)
+        {}
+
+        template<class Callable>
+        void execute(Callable&& task) {
+            if (_accept == 0) {
+                throw std::runtime_error("executor is full");
+            }
+            --_accept;
+            _pool.execute(std::forward<Callable>(task));
+        }
+
+        std::size_t concurrency() const noexcept {
+            return 8;
+        }
+};
+
+}
+
+TEST(thread_pool, runs_every_task) {
+    std::atomic<int> ran{0};
+    {
+        thread_pool pool(3);
+        for (int i = 0; i < 100; ++i) {
+            pool.execute([&ran] { ran.fetch_add(1); });
+        }
+    }
+    // the destructor drains the queue before joining.
+    EXPECT_EQ(ran.load(), 100);
+}
+
+TEST(parallel_chunks, covers_the_range_exactly_once) {
+    thread_pool pool(4);
+    std::vector<std::atomic<int>> hits(100000);
+    parallel_chunks(pool, hits.size(), [&hits](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i) {
+            hits[i].fetch_add(1);
+        }
+    });
+    for (const auto& hit : hits) {
+        ASSERT_EQ(hit.load(), 1);
+    }
+}
+
+TEST(parallel_chunks, small_ranges_stay_on_the_caller) {
+    thread_pool pool(4);
+    int calls = 0;
+    parallel_chunks(pool, 10, [&calls](std::size_t first, std::size_t last) {
+        ++calls;
+        EXPECT_EQ(first, 0u);
+        EXPECT_EQ(last, 10u);
+    });
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(parallel_chunks, rethrows_a_chunk_failure_after_the_rest_finish) {
+    thread_pool pool(4);
+    std::atomic<int> finished{0};
+    EXPECT_THROW(parallel_chunks(pool, 100000, [&finished](std::size_t first, std::size_t) {
+        if (first == 0) {
+            throw std::runtime_error("boom");
+        }
+        finished.fetch_add(1);
+    }), std::runtime_error);
+    EXPECT_GT(finished.load(), 0);
+}
+
+TEST(parallel_chunks, waits_for_queued_chunks_when_the_executor_throws) {
+    thread_pool pool(2);
+    failing_executor executor(pool, 3);
+    std::atomic<int> running{0};
+    std::atomic<int> finished{0};
+
+    EXPECT_THROW(parallel_chunks(executor, 100000, [&](std::size_t, std::size_t) {
+        running.fetch_add(1);
+        // slow enough that the chunks are still queued when the executor gives up.
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        finished.fetch_add(1);
+    }), std::runtime_error);
+
+    // whatever was handed over finished before parallel_chunks() returned; nothing ran on the caller.
+    EXPECT_EQ(finished.load(), 3);
+    EXPECT_EQ(running.load(), 3);
+}
@@ -0,0 +1,100 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "differential.h"
+#include "discrete_map.h"
+
+TEST(upsert, counts_like_unordered_map) {
+    discrete_map<std::int64_t, std::int64_t> map;
+    std::unordered_map<std::int64_t, std::int64_t> reference;
+    key_stream stream(3000);
+
+    for (int step = 0; step < 30000; ++step) {
+        const std::int64_t k = stream.key();
+        const int op = stream.op();
+        if (op < 60) {
+            const bool inserted = map.upsert(k, [] { return std::int64_t{1}; }, [](std::int64_t& n) { ++n; });
+            EXPECT_EQ(inserted, !reference.contains(k));
+            ++reference[k];
+        }
+        else if (op < 75) {
+            EXPECT_EQ(map.erase(k), reference.erase(k) == 1);
+        }
+        else {
+            const bool found = map.visit(k, [&](std::int64_t& n) { n += 10; });
+            EXPECT_EQ(found, reference.contains(k));
+            if (found) {
+                reference[k] += 10;
+            }
+        }
+    }
+    expect_same_contents(map, reference);
+}
+
+TEST(visit, only_calls_back_for_present_keys) {
+    discrete_map<std::string, std::string> map;
+    map["a"] = "x";
+
+    int calls = 0;
+    EXPECT_FALSE(map.visit("b", [&](std::string&) { ++calls; }));
+    EXPECT_EQ(calls, 0);
+
+    EXPECT_TRUE(map.visit("a", [&](std::string& v) {
+        ++calls;
+        v += "y";
+    }));
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(map.at("a"), "xy");
+
+    const auto& const_map = map;
+    std::string seen;
+    EXPECT_TRUE(const_map.visit("a", [&](const std::string& v) { seen = v; }));
+    EXPECT_EQ(seen, "xy");
+    EXPECT_FALSE(const_map.visit("z", [&](const std::string&) { ++calls; }));
+    EXPECT_EQ(calls, 1);
+}
+
+TEST(upsert, calls_exactly_one_of_its_callbacks) {
+    discrete_map<std::string, std::unique_ptr<int>> map;
+    int makes = 0;
+    int updates = 0;
+    const auto make = [&] {
+        ++makes;
+        return std::make_unique<int>(1);
+    };
+    const auto update = [&](std::unique_ptr<int>& p) {
+        ++updates;
+        ++*p;
+    };
+
+    EXPECT_TRUE(map.upsert("k", make, update));
+    EXPECT_FALSE(map.upsert("k", make, update));
+    EXPECT_FALSE(map.upsert("k", make, update));
+    EXPECT_EQ(makes, 1);
+    EXPECT_EQ(updates, 2);
+    EXPECT_EQ(*map.at("k"), 3);
+}
+
+TEST(upsert, a_throwing_make_value_inserts_nothing) {
+    discrete_map<std::int64_t, std::int64_t> map;
+    for (std::int64_t k = 0; k < 100; ++k) {
+        map[k] = k;
+    }
+    // at the edge of a rehash as well as away from it.
+    for (std::int64_t k = 100; k < 300; ++k) {
+        EXPECT_THROW(map.upsert(k, []() -> std::int64_t { throw std::runtime_error("no value"); }, [](std::int64_t&) {}), std::runtime_error);
+        ASSERT_EQ(map.size(), static_cast<size_t>(k));
+        EXPECT_FALSE(map.contains(k));
+        map[k] = k;
+    }
+    for (std::int64_t k = 0; k < 300; ++k) {
+        EXPECT_EQ(map.at(k), k);
+    }
+}